@@ -0,0 +1,152 @@
+/* Aho-Corasick automaton for finding many literal patterns in one pass. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "ahocorasick.h"
+
+
+/*
+* The trie is turned into a complete DFA: next[] holds a transition for
+* every state and byte class, so scanning never follows failure links.
+* Bytes that appear in no pattern share class 0.
+*/
+struct acAutomaton {
+    unsigned char byteClass[256];
+    int classes;
+
+    int states;
+    int capacity;
+    int *next;      // states * classes
+    int *fail;
+    int *output;    // pattern ending at this state, -1 if none
+    int *dict;      // nearest suffix state with an output, 0 if none
+
+    int *patternLen;
+    int patterns;
+};
+
+
+static int acNewState(struct acAutomaton *ac) {
+    if (ac->states == ac->capacity) {
+        ac->capacity = ac->capacity ? ac->capacity * 2 : 64;
+        ac->next = realloc(ac->next, sizeof(int) * ac->classes * ac->capacity);
+        ac->fail = realloc(ac->fail, sizeof(int) * ac->capacity);
+        ac->output = realloc(ac->output, sizeof(int) * ac->capacity);
+        ac->dict = realloc(ac->dict, sizeof(int) * ac->capacity);
+        if (!ac->next || !ac->fail || !ac->output || !ac->dict) { die("realloc"); }
+    }
+
+    int s = ac->states++;
+    for (int c = 0; c < ac->classes; c++) { ac->next[s * ac->classes + c] = -1; }
+    ac->fail[s] = 0;
+    ac->output[s] = -1;
+    ac->dict[s] = 0;
+    return s;
+}
+
+
+struct acAutomaton *acBuild(char **patterns, int count) {
+    struct acAutomaton *ac = calloc(1, sizeof(struct acAutomaton));
+    if (ac == NULL) { die("calloc"); }
+
+    ac->classes = 1;
+    for (int p = 0; p < count; p++) {
+        for (unsigned char *c = (unsigned char *) patterns[p]; *c; c++) {
+            if (ac->byteClass[*c] == 0) { ac->byteClass[*c] = ac->classes++; }
+        }
+    }
+
+    ac->patterns = count;
+    ac->patternLen = malloc(sizeof(int) * (count ? count : 1));
+    if (ac->patternLen == NULL) { die("malloc"); }
+
+    acNewState(ac);
+    for (int p = 0; p < count; p++) {
+        int s = 0;
+        ac->patternLen[p] = strlen(patterns[p]);
+        if (ac->patternLen[p] == 0) { continue; }
+
+        for (unsigned char *c = (unsigned char *) patterns[p]; *c; c++) {
+            int cls = ac->byteClass[*c];
+            if (ac->next[s * ac->classes + cls] == -1) {
+                int t = acNewState(ac);
+                ac->next[s * ac->classes + cls] = t;
+            }
+            s = ac->next[s * ac->classes + cls];
+        }
+        // duplicates report under the first pattern that spelled them
+        if (ac->output[s] == -1) { ac->output[s] = p; }
+    }
+
+    // breadth first, so every state's failure target is complete before it
+    int *queue = malloc(sizeof(int) * ac->states);
+    if (queue == NULL) { die("malloc"); }
+    int head = 0;
+    int tail = 0;
+
+    for (int c = 0; c < ac->classes; c++) {
+        int t = ac->next[c];
+        if (t == -1) { ac->next[c] = 0; }
+        else { queue[tail++] = t; }
+    }
+
+    while (head < tail) {
+        int s = queue[head++];
+        int f = ac->fail[s];
+        ac->dict[s] = (ac->output[f] != -1) ? f : ac->dict[f];
+
+        for (int c = 0; c < ac->classes; c++) {
+            int t = ac->next[s * ac->classes + c];
+            if (t == -1) {
+                ac->next[s * ac->classes + c] = ac->next[f * ac->classes + c];
+            }
+            else {
+                ac->fail[t] = ac->next[f * ac->classes + c];
+                queue[tail++] = t;
+            }
+        }
+    }
+    free(queue);
+
+    return ac;
+}
+
+
+void acFree(struct acAutomaton *ac) {
+    if (ac == NULL) { return; }
+
+    free(ac->next);
+    free(ac->fail);
+    free(ac->output);
+    free(ac->dict);
+    free(ac->patternLen);
+    free(ac);
+}
+
+
+/*
+* Reports every occurrence of every pattern in text, overlapping ones
+* included, as emit(start, len, pattern, arg). Hits come out ordered by
+* where they end. The automaton is not modified, so threads can share it.
+*/
+int acScan(struct acAutomaton *ac, const char *text, int len,
+    void (*emit)(int, int, int, void *), void *arg) {
+
+    int found = 0;
+    int s = 0;
+
+    for (int i = 0; i < len; i++) {
+        s = ac->next[s * ac->classes + ac->byteClass[(unsigned char) text[i]]];
+
+        int t = (ac->output[s] != -1) ? s : ac->dict[s];
+        while (t) {
+            int p = ac->output[t];
+            emit(i + 1 - ac->patternLen[p], ac->patternLen[p], p, arg);
+            found++;
+            t = ac->dict[t];
+        }
+    }
+    return found;
+}
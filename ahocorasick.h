@@ -0,0 +1,13 @@
+/* Multi-pattern matching headers. */
+
+#ifndef AHOCORASICK_H
+#define AHOCORASICK_H
+
+struct acAutomaton;
+
+struct acAutomaton *acBuild(char **, int);
+void acFree(struct acAutomaton *);
+int acScan(struct acAutomaton *, const char *, int,
+    void (*emit)(int, int, int, void *), void *);
+
+#endif
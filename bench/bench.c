@@ -0,0 +1,405 @@
+/* Benchmark driver for the editor internals. */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "bench.h"
+#include "threadpool.h"
+#include "io/file.h"
+#include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define BENCH_DEFAULT_MB 64
+#define BENCH_SMALL_BYTES (64 << 10)
+
+
+struct suite {
+    const char *name;
+    void (*run)();
+};
+
+static struct suite SUITES[] = {
+    {"search", benchSearch},
+    {"highlight", benchHighlight},
+    {"syntax", benchSyntax},
+    {"undo", benchUndo},
+    {"cursors", benchCursors},
+    {"selection", benchSelection},
+    {"columns", benchColumns},
+    {"wrap", benchWrap},
+    {"utf8", benchUtf8},
+    {"longline", benchLongLine},
+    {"fold", benchFold},
+    {"brackets", benchBrackets},
+    {"words", benchWords},
+    {"perf", benchPerf},
+    {"core-small-c", benchCoreSmallC},
+    {"core-c", benchCoreC},
+    {"core-log", benchCoreLog},
+    {"core-line", benchCoreLongLine},
+    {"core-tabs", benchCoreTabs},
+};
+
+#define SUITE_ENTRIES (sizeof(SUITES) / sizeof(SUITES[0]))
+
+
+double benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+* Results are printed as a table, or with --json as one JSON document
+* whose results each name the suite they came from.
+*/
+static struct {
+    int json;
+    const char *suite;
+    int results;
+    int failed;
+} OUTPUT = {0, NULL, 0, 0};
+
+
+void benchReport(const char *name, double seconds, long long bytes, long long items) {
+    double rate = seconds > 0 ? bytes / seconds / (1024 * 1024) : 0.0;
+
+    if (OUTPUT.json) {
+        printf(
+            "%s\n    {\"suite\": \"%s\", \"name\": \"%s\", \"ms\": %.3f, \"mb_per_s\": %.1f, \"items\": %lld}",
+            OUTPUT.results++ ? "," : "", OUTPUT.suite, name, seconds * 1e3, rate, items
+        );
+    }
+    else { printf("%-32s %10.3f ms %10.1f MB/s %12lld items\n", name, seconds * 1e3, rate, items); }
+    fflush(stdout);
+}
+
+
+/* Reports a measurement other than a time, such as memory used. */
+void benchNote(const char *name, double value, const char *unit) {
+    if (OUTPUT.json) {
+        printf(
+            "%s\n    {\"suite\": \"%s\", \"name\": \"%s\", \"value\": %.1f, \"unit\": \"%s\"}",
+            OUTPUT.results++ ? "," : "", OUTPUT.suite, name, value, unit
+        );
+    }
+    else { printf("%-32s %10.1f %s\n", name, value, unit); }
+    fflush(stdout);
+}
+
+
+/* Fails the run, after the rest of the suites, unless ok holds. */
+void benchCheck(const char *name, int ok) {
+    if (ok) { return; }
+
+    fprintf(stderr, "check failed: %s\n", name);
+    OUTPUT.failed++;
+}
+
+
+void benchUnload() {
+    undoSuspend();
+    editorDelRows(0, CONFIG.numRows);
+    undoResume();
+    undoReset();
+    free(CONFIG.row);
+    CONFIG.row = NULL;
+    CONFIG.dirty = 0;
+}
+
+
+static char *LOADED = NULL;
+
+
+void benchLoad(const char *path) {
+    // path may be LOADED itself, when reloading
+    char *copy = strdup(path);
+    benchUnload();
+    editorOpen(copy);
+
+    free(LOADED);
+    LOADED = copy;
+}
+
+
+/* Reloads the last corpus, for suites that modify the buffer. */
+void benchReload() {
+    benchLoad(LOADED);
+}
+
+
+long long benchBufferBytes() {
+    long long bytes = 0;
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        bytes += CONFIG.row[j].renderSize;
+    }
+    return bytes;
+}
+
+
+size_t benchCorpusBytes() {
+    char *mb = getenv("MOOSE_BENCH_MB");
+    size_t n = mb ? strtoul(mb, NULL, 10) : BENCH_DEFAULT_MB;
+    return (n ? n : BENCH_DEFAULT_MB) * 1024 * 1024;
+}
+
+
+/* Writes a synthetic service log of roughly the given size, once per run. */
+const char *benchCorpusLog(size_t bytes) {
+    static char path[] = "/tmp/mooseBench-log.txt";
+    static int written_once = 0;
+    if (written_once) { return path; }
+    written_once = 1;
+
+    static const char *levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    static const char *paths[] = {"/api/v1/items", "/api/v1/users", "/healthz", "/api/v2/orders"};
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { die("fopen"); }
+
+    unsigned int seed = 42;
+    size_t written = 0;
+    long line = 0;
+    while (written < bytes) {
+        seed = seed * 1103515245 + 12345;
+        int n = fprintf(
+            fp, "2026-10-%02ldT%02ld:%02ld:%02ld.%03ldZ %-5s req=%08x user=%u %s %s/%u %d %ums\n",
+            1 + line / 86400 % 28, line / 3600 % 24, line / 60 % 60, line % 60, line % 1000,
+            levels[(seed >> 8) % 6], seed, (seed >> 4) % 10000,
+            (seed & 1) ? "GET" : "POST", paths[(seed >> 12) % 4], (seed >> 16) % 100000,
+            (seed >> 20) % 50 ? 200 : 500, (seed >> 3) % 900
+        );
+        written += n;
+        line++;
+    }
+
+    fclose(fp);
+    return path;
+}
+
+
+/*
+* Writes the service log again with a quarter of its lines carrying user
+* text in other scripts: accented Latin, Cyrillic, CJK and emoji.
+*/
+const char *benchCorpusMixed(size_t bytes) {
+    static char path[] = "/tmp/mooseBench-mixed.txt";
+    static int written_once = 0;
+    if (written_once) { return path; }
+    written_once = 1;
+
+    static const char *notes[] = {
+        "usuário José não encontrado", "Ошибка доступа к файлу",
+        "注文が完了しました", "결제 실패 😀 재시도", "Größe überschritten",
+    };
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { die("fopen"); }
+
+    unsigned int seed = 11;
+    size_t written = 0;
+    long line = 0;
+    while (written < bytes) {
+        seed = seed * 1103515245 + 12345;
+        int n = fprintf(
+            fp, "2026-10-%02ldT%02ld:%02ld:%02ldZ %-5s req=%08x",
+            1 + line / 86400 % 28, line / 3600 % 24, line / 60 % 60, line % 60,
+            (seed >> 8) % 4 ? "INFO" : "WARN", seed
+        );
+        if ((seed >> 4) % 4 == 0) { n += fprintf(fp, " msg=\"%s\"", notes[(seed >> 12) % 5]); }
+        else { n += fprintf(fp, " path=/api/v1/items/%u status=200", (seed >> 16) % 100000); }
+        n += fprintf(fp, " %ums\n", (seed >> 3) % 900);
+
+        written += n;
+        line++;
+    }
+
+    fclose(fp);
+    return path;
+}
+
+
+/*
+* Writes a single line of minified records of roughly the given size,
+* once per run. It is named as C source so it gets strings and numbers
+* highlighted.
+*/
+const char *benchCorpusLongLine(size_t bytes) {
+    static char path[] = "/tmp/mooseBench-line.c";
+    static int written_once = 0;
+    if (written_once) { return path; }
+    written_once = 1;
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { die("fopen"); }
+
+    unsigned int seed = 3;
+    size_t written = fprintf(fp, "[");
+    long id = 0;
+    while (written < bytes) {
+        seed = seed * 1103515245 + 12345;
+        written += fprintf(
+            fp, "{\"id\":%ld,\"name\":\"item %u\",\"tags\":[\"t%u\",\"t%u\"],\"price\":%u.%02u,\"ok\":%s},",
+            id++, (seed >> 4) % 100000, (seed >> 8) % 50, (seed >> 12) % 50,
+            (seed >> 16) % 1000, seed % 100, (seed & 1) ? "true" : "false"
+        );
+    }
+    fprintf(fp, "{}]\n");
+
+    fclose(fp);
+    return path;
+}
+
+
+/*
+* Writes a synthetic C source file of roughly the given size: functions
+* with line and block comments, strings with escapes, numbers and a fair
+* share of keywords.
+*/
+static void writeCorpusC(const char *path, size_t bytes) {
+    static const char *types[] = {"int", "long", "unsigned", "char *", "double", "struct node *"};
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { die("fopen"); }
+
+    unsigned int seed = 7;
+    size_t written = 0;
+    long fn = 0;
+    while (written < bytes) {
+        seed = seed * 1103515245 + 12345;
+        const char *type = types[(seed >> 8) % 6];
+        int n = 0;
+
+        n += fprintf(
+            fp, "/*\n* Computes step %ld of the pipeline; see stage_%u for the\n"
+            "* details of how the buffer is consumed.\n*/\n", fn, (seed >> 4) % 97
+        );
+        n += fprintf(fp, "static %s stage_%ld(struct node *head, int limit) {\n", type, fn);
+        n += fprintf(fp, "    int count = 0;  // nodes visited so far\n");
+        n += fprintf(fp, "    double ratio = %u.%03u;\n\n", (seed >> 12) % 100, seed % 1000);
+        n += fprintf(fp, "    for (struct node *n = head; n != NULL; n = n->next) {\n");
+        n += fprintf(fp, "        if (n->value > %u && count < limit) {\n", (seed >> 16) % 5000);
+        n += fprintf(
+            fp, "            printf(\"stage %ld: value=%%d \\\"%%s\\\"\\n\", n->value, n->name);\n", fn
+        );
+        n += fprintf(fp, "            count += n->weight * 0x%x;\n", seed & 0xffff);
+        n += fprintf(fp, "        }\n        else { continue; }\n    }\n\n");
+        n += fprintf(fp, "    return (%s) (count * ratio);\n}\n\n\n", type);
+
+        written += n;
+        fn++;
+    }
+
+    fclose(fp);
+}
+
+
+/* The synthetic C source at the usual corpus size, written once per run. */
+const char *benchCorpusC(size_t bytes) {
+    static char path[] = "/tmp/mooseBench-src.c";
+    static int written_once = 0;
+    if (written_once) { return path; }
+    written_once = 1;
+
+    writeCorpusC(path, bytes);
+    return path;
+}
+
+
+/* The synthetic C source at the size of a hand-written file, for per-file costs. */
+const char *benchCorpusSmallC() {
+    static char path[] = "/tmp/mooseBench-small.c";
+    static int written_once = 0;
+    if (written_once) { return path; }
+    written_once = 1;
+
+    writeCorpusC(path, BENCH_SMALL_BYTES);
+    return path;
+}
+
+
+/*
+* Writes C indented with tabs, with tab-aligned tables and comments, of
+* roughly the given size, once per run. Most rows have several tabs, of
+* different widths.
+*/
+const char *benchCorpusTabs(size_t bytes) {
+    static char path[] = "/tmp/mooseBench-tabs.c";
+    static int written_once = 0;
+    if (written_once) { return path; }
+    written_once = 1;
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { die("fopen"); }
+
+    unsigned int seed = 5;
+    size_t written = 0;
+    long step = 0;
+    while (written < bytes) {
+        seed = seed * 1103515245 + 12345;
+        int depth = 1 + (seed >> 8) % 5;
+        int n = 0;
+
+        for (int d = 0; d < depth; d++) { n += fprintf(fp, "\t"); }
+        if (seed & 1) {
+            n += fprintf(fp, "{%u,\t%u,\t\"t%u\"},\t\t/* row %ld */\n", (seed >> 4) % 1000, (seed >> 12) % 100000, (seed >> 16) % 50, step);
+        }
+        else {
+            n += fprintf(fp, "case %u:\tcount += weight[%u];\t\t// step %ld\n", (seed >> 4) % 1000, (seed >> 12) % 64, step);
+        }
+
+        written += n;
+        step++;
+    }
+
+    fclose(fp);
+    return path;
+}
+
+
+int main(int argc, char *argv[]) {
+    CONFIG.screenRows = 40;
+    CONFIG.screenCols = 120;
+    CONFIG.filename = NULL;
+
+    // searches yield to pending keys; none ever arrive on an empty pipe
+    int quiet[2];
+    if (pipe(quiet) == -1 || dup2(quiet[0], STDIN_FILENO) == -1) { die("pipe"); }
+
+    int named = 0;
+    for (int a = 1; a < argc; a++) {
+        if (!strcmp(argv[a], "--json")) { OUTPUT.json = 1; }
+        else { named++; }
+    }
+
+    if (OUTPUT.json) {
+        printf(
+            "{\n  \"corpus_mb\": %zu,\n  \"threads\": %d,\n  \"results\": [",
+            benchCorpusBytes() >> 20, poolSize()
+        );
+    }
+
+    for (unsigned int s = 0; s < SUITE_ENTRIES; s++) {
+        int wanted = (named == 0);
+        for (int a = 1; a < argc; a++) {
+            if (!strcmp(argv[a], SUITES[s].name)) { wanted = 1; }
+        }
+
+        if (wanted) {
+            OUTPUT.suite = SUITES[s].name;
+            if (!OUTPUT.json) { printf("== %s ==\n", SUITES[s].name); }
+            SUITES[s].run();
+        }
+    }
+
+    if (OUTPUT.json) { printf("\n  ]\n}\n"); }
+    benchUnload();
+    return OUTPUT.failed ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+/* Benchmark harness headers. */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+double benchNow();
+void benchReport(const char *, double, long long, long long);
+void benchNote(const char *, double, const char *);
+void benchCheck(const char *, int);
+void benchLoad(const char *);
+void benchReload();
+void benchUnload();
+long long benchBufferBytes();
+size_t benchCorpusBytes();
+const char *benchCorpusLog(size_t);
+const char *benchCorpusC(size_t);
+const char *benchCorpusSmallC();
+const char *benchCorpusTabs(size_t);
+const char *benchCorpusMixed(size_t);
+const char *benchCorpusLongLine(size_t);
+
+void benchSearch();
+void benchHighlight();
+void benchSyntax();
+void benchUndo();
+void benchCursors();
+void benchSelection();
+void benchColumns();
+void benchWrap();
+void benchUtf8();
+void benchLongLine();
+void benchFold();
+void benchBrackets();
+void benchWords();
+void benchPerf();
+void benchCoreSmallC();
+void benchCoreC();
+void benchCoreLog();
+void benchCoreLongLine();
+void benchCoreTabs();
+
+#endif
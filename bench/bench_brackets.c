@@ -0,0 +1,69 @@
+/* Bracket matching benchmarks over a synthetic C file. */
+
+#include <string.h>
+
+#include "core.h"
+#include "bench.h"
+#include "brackets.h"
+#include "highlight.h"
+#include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define BENCH_LOOKUPS 100000
+#define BENCH_KEYSTROKES 1000
+
+
+void benchBrackets() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+    long long sum = 0;
+    int atX, matchY, matchX;
+
+    // the index is filled in as rows are highlighted
+    double start = benchNow();
+    updateSyntaxRange(0, CONFIG.numRows - 1);
+    benchReport("brackets/highlight-and-index", benchNow() - start, benchBufferBytes(), CONFIG.numRows);
+
+    // one brace around the whole file puts its match as far away as it gets
+    editorInsertRow(0, "{", 1);
+    editorInsertRow(CONFIG.numRows, "}", 1);
+    updateSyntaxRange(0, CONFIG.numRows - 1);
+
+    start = benchNow();
+    sum += bracketMatch(0, 0, &atX, &matchY, &matchX);
+    benchReport("brackets/rebuild-after-insert", benchNow() - start, 0, CONFIG.numRows);
+
+    start = benchNow();
+    for (int k = 0; k < BENCH_LOOKUPS; k++) {
+        sum += bracketMatch(k % 2 ? CONFIG.numRows - 1 : 0, 0, &atX, &matchY, &matchX) + matchY;
+    }
+    benchReport("brackets/match-across-file", benchNow() - start, 0, BENCH_LOOKUPS);
+
+    // from every function's opening brace to its closing one and back
+    int pairs = 0;
+    start = benchNow();
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        editorRow *row = &CONFIG.row[j];
+        if (strncmp(row->characters, "static ", 7)) { continue; }
+        if (bracketMatch(j, row->rowSize - 1, &atX, &matchY, &matchX)) {
+            sum += bracketMatch(matchY, matchX, &atX, &matchY, &matchX);
+            pairs++;
+        }
+    }
+    benchReport("brackets/match-every-function", benchNow() - start, 0, pairs);
+
+    // each keystroke lexes its row again and updates the tree along one path
+    int at = CONFIG.numRows / 2;
+    CONFIG.rowOffset = at;
+    editorRow *row = &CONFIG.row[at];
+    start = benchNow();
+    for (int k = 0; k < BENCH_KEYSTROKES; k++) {
+        editorRowInsertChar(row, row->rowSize, k % 2 ? ')' : '(');
+        undoCommit();
+        sum += bracketMatch(at, row->rowSize, &atX, &matchY, &matchX) + matchY;
+    }
+    benchReport("brackets/type-and-match", benchNow() - start, 0, BENCH_KEYSTROKES);
+
+    if (sum == 0) { benchReport("brackets/checksum", 0, 0, sum); }
+    CONFIG.rowOffset = 0;
+    benchReload();
+}
@@ -0,0 +1,50 @@
+/* Column conversion benchmarks on one long, tab-heavy line. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "bench.h"
+#include "ops/rowops.h"
+
+#define BENCH_LINE_BYTES (1 << 20)
+#define BENCH_CONVERSIONS 100000
+
+
+void benchColumns() {
+    benchUnload();
+
+    static const char piece[] = "\tvalue = 1;";
+    size_t len = BENCH_LINE_BYTES;
+    char *line = malloc(len);
+    if (line == NULL) { die("malloc"); }
+    for (size_t i = 0; i < len; i++) { line[i] = piece[i % (sizeof(piece) - 1)]; }
+
+    double start = benchNow();
+    editorInsertRow(0, line, len);
+    benchReport("columns/render-1mb-line", benchNow() - start, len, 1);
+    free(line);
+
+    editorRow *row = &CONFIG.row[0];
+    unsigned int seed = 3;
+    long long sum = 0;
+
+    start = benchNow();
+    for (int k = 0; k < BENCH_CONVERSIONS; k++) {
+        seed = seed * 1103515245 + 12345;
+        sum += editorRowCxToRx(row, row->rowSize - (int) (seed % 4096));
+    }
+    benchReport("columns/cx-to-rx-line-end", benchNow() - start, 0, BENCH_CONVERSIONS);
+
+    start = benchNow();
+    for (int k = 0; k < BENCH_CONVERSIONS; k++) {
+        seed = seed * 1103515245 + 12345;
+        sum += editorRowRxToCx(row, row->renderSize - (int) (seed % 4096));
+    }
+    benchReport("columns/rx-to-cx-line-end", benchNow() - start, 0, BENCH_CONVERSIONS);
+
+    // keeps the conversions from being optimised away
+    if (sum == 0) { benchReport("columns/checksum", 0, 0, sum); }
+
+    benchUnload();
+}
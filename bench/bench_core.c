@@ -0,0 +1,149 @@
+/* Microbenchmarks of the editor's entry points over each synthetic corpus. */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "bench.h"
+#include "highlight.h"
+#include "search.h"
+#include "io/file.h"
+#include "io/output.h"
+#include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define BENCH_ROW_EDITS 1000
+#define BENCH_ROW_MOVES 100  // each moves every row of a large buffer twice
+#define BENCH_FRAMES 1000
+#define BENCH_JUMPS 100
+#define BENCH_SAVE_PATH "/tmp/mooseBench-save.txt"
+
+
+static long long fileBytes() {
+    long long bytes = 0;
+    for (int j = 0; j < CONFIG.numRows; j++) { bytes += CONFIG.row[j].rowSize + 1; }
+    return bytes;
+}
+
+
+/*
+* Opens, renders, highlights, edits, searches, draws and saves one corpus,
+* reporting each as name/step. Whole-buffer steps run repeat times, so a
+* small file still takes long enough to time.
+*/
+static void benchCore(const char *name, const char *path, int repeat, const char *query) {
+    char step[64];
+    double elapsed = 0;
+
+    for (int r = 0; r < repeat; r++) {
+        benchUnload();
+        double start = benchNow();
+        editorOpen((char *) path);
+        elapsed += benchNow() - start;
+    }
+    long long bytes = fileBytes();
+    snprintf(step, sizeof(step), "%s/open", name);
+    benchReport(step, elapsed, bytes * repeat, (long long) CONFIG.numRows * repeat);
+
+    double start = benchNow();
+    for (int r = 0; r < repeat; r++) {
+        for (int j = 0; j < CONFIG.numRows; j++) { editorUpdateRow(&CONFIG.row[j]); }
+    }
+    snprintf(step, sizeof(step), "%s/update-every-row", name);
+    benchReport(step, benchNow() - start, bytes * repeat, (long long) CONFIG.numRows * repeat);
+
+    // the first full pass, then the rows on screen again one edit at a time
+    elapsed = 0;
+    for (int r = 0; r < repeat; r++) {
+        for (int j = 0; j < CONFIG.numRows; j++) { markSyntaxStale(j); }
+        start = benchNow();
+        updateSyntaxRange(0, CONFIG.numRows - 1);
+        elapsed += benchNow() - start;
+    }
+    snprintf(step, sizeof(step), "%s/highlight", name);
+    benchReport(step, elapsed, benchBufferBytes() * repeat, (long long) CONFIG.numRows * repeat);
+
+    int visible = CONFIG.numRows < CONFIG.screenRows ? CONFIG.numRows : CONFIG.screenRows;
+    start = benchNow();
+    for (int k = 0; k < BENCH_ROW_EDITS; k++) { updateSyntax(&CONFIG.row[k % visible]); }
+    snprintf(step, sizeof(step), "%s/update-syntax", name);
+    benchReport(step, benchNow() - start, 0, BENCH_ROW_EDITS);
+
+    // each one moves every row below it down and back up again
+    start = benchNow();
+    for (int k = 0; k < BENCH_ROW_MOVES; k++) {
+        int at = (int) ((k * 7919LL) % CONFIG.numRows);
+        editorInsertRow(at, "int inserted = 0;", 17);
+        editorDelRow(at);
+        undoCommit();
+    }
+    snprintf(step, sizeof(step), "%s/insert-delete-row", name);
+    benchReport(step, benchNow() - start, 0, BENCH_ROW_MOVES * 2);
+
+    // typing the query into the find prompt, then stepping through matches
+    char typed[64];
+    int keys = 0;
+    start = benchNow();
+    for (int i = 0; query[i] && i < (int) sizeof(typed) - 1; i++) {
+        typed[i] = query[i];
+        typed[i + 1] = '\0';
+        findCallback(typed, query[i]);
+        keys++;
+    }
+    for (int k = 0; k < BENCH_JUMPS; k++, keys++) { findCallback(typed, ARROW_DOWN); }
+    findCallback(typed, '\x1b');
+    snprintf(step, sizeof(step), "%s/find-as-typed", name);
+    benchReport(step, benchNow() - start, benchBufferBytes(), keys);
+
+    // frames at cursors spread over the file, each scrolled to afresh
+    long long drawn = 0;
+    start = benchNow();
+    for (int k = 0; k < BENCH_FRAMES; k++) {
+        CONFIG.cursorY = (int) ((k * 7919LL) % CONFIG.numRows);
+        CONFIG.cursorX = 0;
+
+        struct appendString as = APPENDSTRING_INIT;
+        drawScreen(&as);
+        drawn += as.len;
+        stringFree(&as);
+    }
+    snprintf(step, sizeof(step), "%s/draw-frame", name);
+    benchReport(step, benchNow() - start, drawn, BENCH_FRAMES);
+    CONFIG.cursorY = 0;
+    CONFIG.rowOffset = 0;
+    CONFIG.colOffset = 0;
+
+    char *filename = CONFIG.filename;
+    CONFIG.filename = BENCH_SAVE_PATH;
+    start = benchNow();
+    for (int r = 0; r < repeat; r++) { editorSave(); }
+    snprintf(step, sizeof(step), "%s/save", name);
+    benchReport(step, benchNow() - start, fileBytes() * repeat, (long long) CONFIG.numRows * repeat);
+    CONFIG.filename = filename;
+    unlink(BENCH_SAVE_PATH);
+}
+
+
+void benchCoreSmallC() {
+    benchCore("small-c", benchCorpusSmallC(), 100, "count");
+}
+
+
+void benchCoreC() {
+    benchCore("c", benchCorpusC(benchCorpusBytes()), 1, "count");
+}
+
+
+void benchCoreLog() {
+    benchCore("log", benchCorpusLog(benchCorpusBytes()), 1, "req=dead");
+}
+
+
+void benchCoreLongLine() {
+    benchCore("long-line", benchCorpusLongLine(benchCorpusBytes()), 1, "\"item 4");
+}
+
+
+void benchCoreTabs() {
+    benchCore("tabs", benchCorpusTabs(benchCorpusBytes()), 1, "weight[");
+}
@@ -0,0 +1,48 @@
+/* Multiple cursor benchmarks over a synthetic C file. */
+
+#include <stdio.h>
+
+#include "core.h"
+#include "bench.h"
+#include "ops/cursors.h"
+#include "ops/editorops.h"
+#include "ops/undo.h"
+
+#define BENCH_CURSORS 10000
+#define BENCH_KEYSTROKES 10
+
+
+void benchCursors() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+    int rows = CONFIG.numRows < BENCH_CURSORS ? CONFIG.numRows : BENCH_CURSORS;
+
+    CONFIG.cursorX = 0;
+    CONFIG.cursorY = 0;
+    double start = benchNow();
+    for (int j = 1; j < rows; j++) { cursorsAddBelow(); }
+    benchReport("cursors/add-column-10k", benchNow() - start, 0, cursorsCount());
+
+    start = benchNow();
+    for (int k = 0; k < BENCH_KEYSTROKES; k++) {
+        insertChar('x');
+        undoCommit();
+    }
+    benchReport("cursors/type-10k-cursors", (benchNow() - start) / BENCH_KEYSTROKES, 0, rows);
+
+    start = benchNow();
+    for (int k = 0; k < BENCH_KEYSTROKES; k++) {
+        delChar();
+        undoCommit();
+    }
+    benchReport("cursors/backspace-10k-cursors", (benchNow() - start) / BENCH_KEYSTROKES, 0, rows);
+    cursorsClear();
+
+    CONFIG.cursorX = 0;
+    CONFIG.cursorY = 0;
+    start = benchNow();
+    int found = cursorsAddMatches();
+    benchReport("cursors/add-word-matches", benchNow() - start, 0, found);
+    cursorsClear();
+
+    benchReload();
+}
@@ -0,0 +1,89 @@
+/* Code folding benchmarks over a synthetic C file. */
+
+#include <string.h>
+
+#include "core.h"
+#include "bench.h"
+#include "fold.h"
+#include "search.h"
+#include "io/input.h"
+#include "ops/undo.h"
+
+#define BENCH_LOOKUPS 100000
+#define BENCH_TOGGLES 1000
+
+
+void benchFold() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+    long long sum = 0;
+
+    // searching and replacing with nothing folded, to compare against
+    double start = benchNow();
+    sum += searchBuffer("count", SEARCH_LITERAL);
+    benchReport("fold/search-unfolded", benchNow() - start, benchBufferBytes(), CONFIG.numRows);
+
+    start = benchNow();
+    sum += searchReplaceAll("count", 0, "total");
+    benchReport("fold/replace-all-unfolded", benchNow() - start, 0, CONFIG.numRows);
+    benchReload();
+
+    // every function body collapses onto its signature
+    int folds = 0;
+    start = benchNow();
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        if (!strncmp(CONFIG.row[j].characters, "static ", 7) && foldToggle(j) > 0) { folds++; }
+    }
+    benchReport("fold/fold-every-function", benchNow() - start, 0, folds);
+
+    int lines = foldLineOf(CONFIG.numRows);
+    unsigned int seed = 9;
+    start = benchNow();
+    for (int k = 0; k < BENCH_LOOKUPS; k++) {
+        seed = seed * 1103515245 + 12345;
+        sum += foldLineOf(foldRowAt(seed % lines));
+    }
+    benchReport("fold/line-to-row", benchNow() - start, 0, BENCH_LOOKUPS);
+
+    // moving down the file only ever visits the rows that are shown
+    CONFIG.cursorX = 0;
+    CONFIG.cursorY = 0;
+    int steps = 0;
+    start = benchNow();
+    while (CONFIG.cursorY < CONFIG.numRows) {
+        moveCursorKeypress(ARROW_DOWN);
+        steps++;
+    }
+    benchReport("fold/cursor-down-whole-file", benchNow() - start, 0, steps);
+
+    // hidden rows are neither searched nor rendered again; the first search
+    // after folding also pays for the allocator sweeping up their buffers
+    sum += searchBuffer("count", SEARCH_LITERAL);
+    start = benchNow();
+    int found = searchBuffer("count", SEARCH_LITERAL);
+    benchReport("fold/search-folded", benchNow() - start, benchBufferBytes(), lines);
+
+    // and only what the search found is replaced
+    start = benchNow();
+    int replaced = searchReplaceAll("count", 0, "total");
+    benchReport("fold/replace-all-folded", benchNow() - start, 0, CONFIG.numRows);
+    benchCheck("fold/replace-all-folded", replaced == found);
+    sum += found + replaced;
+    undoCommit();
+
+    // opening and closing one fold among many
+    int middle = foldRowAt(lines / 2);
+    while (middle < CONFIG.numRows && foldLast(middle) == middle) { middle = foldNext(middle); }
+    start = benchNow();
+    for (int k = 0; k < BENCH_TOGGLES; k++) {
+        foldToggle(middle);
+        foldToggle(middle);
+    }
+    benchReport("fold/toggle-one-of-many", (benchNow() - start) / BENCH_TOGGLES, 0, folds);
+
+    start = benchNow();
+    foldOpenAll();
+    benchReport("fold/unfold-all", benchNow() - start, benchBufferBytes(), folds);
+
+    if (sum == 0) { benchReport("fold/checksum", 0, 0, sum); }
+    benchReload();
+}
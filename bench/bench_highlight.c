@@ -0,0 +1,242 @@
+/* Syntax highlighting benchmarks over a synthetic C file. */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "bench.h"
+#include "highlight.h"
+#include "threadpool.h"
+#include "ops/rowops.h"
+
+
+static int legacy_is_separator(int c) {
+    return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
+
+
+/*
+* The character-at-a-time highlighter the table-driven lexer replaced,
+* kept as the baseline to measure against. It fills a byte per render
+* column, as rows used to store it. Returns whether the row's open comment
+* state changed.
+*/
+static unsigned char *LEGACY_HL = NULL;
+static int LEGACY_CAPACITY = 0;
+
+static int legacyHighlightRow(editorRow *row) {
+    if (LEGACY_CAPACITY < row->renderSize) {
+        LEGACY_CAPACITY = row->renderSize * 2;
+        LEGACY_HL = realloc(LEGACY_HL, LEGACY_CAPACITY);
+    }
+    unsigned char *highlight = LEGACY_HL;
+    memset(highlight, HL_NORMAL, row->renderSize);
+
+    if (CONFIG.syntax == NULL) { return 0; }
+
+    char **keywords = CONFIG.syntax->keywords;
+
+    char *scs = CONFIG.syntax->singleline_comment_start;
+    char *mcs = CONFIG.syntax->multiline_comment_start;
+    char *mce = CONFIG.syntax->multiline_comment_end;
+
+    int scs_len = scs ? strlen(scs) : 0;
+    int mcs_len = mcs ? strlen(mcs) : 0;
+    int mce_len = mce ? strlen(mce) : 0;
+
+    int prev_sep = 1;
+    int in_string = 0;
+    int in_comment = (
+        row->index > 0 && CONFIG.row[row->index - 1].highlight_open_comment
+    );
+
+    int i = 0;
+    while (i < row->renderSize) {
+        char c = row->render[i];
+        unsigned char prev_hl = (i > 0) ? highlight[i - 1]: HL_NORMAL;
+
+        if (scs_len && !in_string && !in_comment) {
+            if (!strncmp(&row->render[i], scs, scs_len)) {
+                memset(&highlight[i], HL_COMMENT, row->renderSize - i);
+                break;
+            }
+        }
+
+        if (mcs_len && mce_len && !in_string) {
+            if (in_comment) {
+                highlight[i] = HL_MLCOMMENT;
+
+                if (!strncmp(&row->render[i], mce, mce_len)) {
+                    memset(&highlight[i], HL_MLCOMMENT, mce_len);
+
+                    i += mce_len;
+                    in_comment = 0;
+                    prev_sep = 1;
+                    continue;
+                }
+
+                else {
+                    i++;
+                    continue;
+                }
+            }
+
+            else if (!strncmp(&row->render[i], mcs, mcs_len)) {
+                memset(&highlight[i], HL_MLCOMMENT, mcs_len);
+                i += mcs_len;
+                in_comment = 1;
+                continue;
+            }
+        }
+
+        if (CONFIG.syntax->flags & HL_HIGHLIGHT_STRINGS) {
+            if (in_string) {
+                highlight[i] = HL_STRING;
+
+                if (c == '\\' && i + 1 < row->renderSize) {
+                    highlight[i + 1] = HL_STRING;
+                    i += 2;
+                    continue;
+                }
+
+                if (c == in_string) { in_string = 0; }
+                i++;
+                prev_sep = 1;
+                continue;
+            }
+
+            else {
+                if (c == '"' || c == '\'') {
+                    in_string = c;
+                    highlight[i] = HL_STRING;
+                    i++;
+                    continue;
+                }
+            }
+        }
+
+        if (CONFIG.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
+
+            if (
+                (isdigit(c) && (prev_sep || prev_hl == HL_NUMBER))
+                || (c == '.' && prev_hl == HL_NUMBER)
+            ) {
+                highlight[i] = HL_NUMBER;
+                i++;
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        if (prev_sep) {
+            int j;
+            for (j = 0; keywords[j]; j++) {
+                int klen = strlen(keywords[j]);
+                int kw2 = keywords[j][klen - 1] == '|';
+
+                if (kw2) { klen--; }
+
+                if (
+                    !strncmp(&row->render[i], keywords[j], klen)
+                    && legacy_is_separator(row->render[i + klen])
+                ) {
+                    memset(
+                        &highlight[i],
+                        kw2 ? HL_KEYWORDS2 : HL_KEYWORDS1, klen
+                    );
+                    i += klen;
+                    break;
+                }
+            }
+
+            if (keywords[j] != NULL) {
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        prev_sep = legacy_is_separator(c);
+        i++;
+    }
+
+    int changed = (row->highlight_open_comment != in_comment);
+    row->highlight_open_comment = in_comment;
+    return changed;
+}
+
+
+static void markAllStale() {
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        markSyntaxStale(j);
+    }
+}
+
+
+/*
+* Highlight storage per line: a byte per render column as rows used to
+* keep it, against the spans they keep now.
+*/
+static void reportMemory(const char *name) {
+    markAllStale();
+    updateSyntaxRange(0, CONFIG.numRows - 1);
+
+    long long bytes = 0;
+    long long spans = 0;
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        bytes += CONFIG.row[j].renderSize;
+        spans += CONFIG.row[j].highlightSpans * sizeof(highlightSpan);
+    }
+
+    int lines = CONFIG.numRows ? CONFIG.numRows : 1;
+    benchNote(name, (double) bytes / lines, "B/line bytes");
+    benchNote(name, (double) spans / lines, "B/line spans");
+}
+
+
+static const char *SOURCES[] = {"highlight.c", "search.c", "dfa.c", "io/output.c"};
+
+#define SOURCE_ENTRIES (sizeof(SOURCES) / sizeof(SOURCES[0]))
+
+
+void benchHighlight() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+    long long bytes = benchBufferBytes();
+
+    double start = benchNow();
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        legacyHighlightRow(&CONFIG.row[j]);
+    }
+    benchReport("highlight/legacy", benchNow() - start, bytes, CONFIG.numRows);
+
+    markAllStale();
+    start = benchNow();
+    updateSyntaxRange(0, CONFIG.numRows - 1);
+    benchReport("highlight/table-driven", benchNow() - start, bytes, CONFIG.numRows);
+
+    // the same pass split over the pool; MOOSE_THREADS sets its size
+    char name[48];
+    snprintf(name, sizeof(name), "highlight/parallel-%dt", poolSize());
+    markAllStale();
+    start = benchNow();
+    updateSyntaxParallel(0, CONFIG.numRows - 1, NULL);
+    benchReport(name, benchNow() - start, bytes, CONFIG.numRows);
+
+    // opening a comment on the first line only highlights the viewport
+    start = benchNow();
+    editorInsertRow(0, "/*", 2);
+    benchReport("highlight/open-comment-at-top", benchNow() - start, 0, 1);
+
+    start = benchNow();
+    updateSyntaxVisible();
+    benchReport("highlight/redraw-after-edit", benchNow() - start, 0, 1);
+
+    reportMemory("memory/synthetic");
+    for (unsigned int f = 0; f < SOURCE_ENTRIES; f++) {
+        char name[48];
+        snprintf(name, sizeof(name), "memory/%s", SOURCES[f]);
+        benchLoad(SOURCES[f]);
+        reportMemory(name);
+    }
+}
@@ -0,0 +1,83 @@
+/* Editing a single line many megabytes long. */
+
+#include <string.h>
+
+#include "core.h"
+#include "bench.h"
+#include "brackets.h"
+#include "highlight.h"
+#include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define BENCH_KEYSTROKES 1000
+#define BENCH_WHOLE_KEYSTROKES 10
+#define BENCH_SEEKS 100000
+
+
+void benchLongLine() {
+    double start = benchNow();
+    benchLoad(benchCorpusLongLine(benchCorpusBytes()));
+    benchReport("longline/open", benchNow() - start, benchBufferBytes(), CONFIG.numRows);
+
+    editorRow *row = &CONFIG.row[0];
+    int at = row->rowSize / 2;
+
+    // only the slice around the edit is rendered and lexed again
+    start = benchNow();
+    for (int k = 0; k < BENCH_KEYSTROKES; k++) {
+        editorRowInsertChar(row, at + k, 'x');
+        undoCommit();
+    }
+    benchReport("longline/type-in-middle", benchNow() - start, 0, BENCH_KEYSTROKES);
+
+    start = benchNow();
+    for (int k = BENCH_KEYSTROKES - 1; k >= 0; k--) {
+        editorRowDelChar(row, at + k);
+        undoCommit();
+    }
+    benchReport("longline/delete-in-middle", benchNow() - start, 0, BENCH_KEYSTROKES);
+
+    // an open quote does change the rest of the line, which is lexed to its end
+    start = benchNow();
+    for (int k = 0; k < BENCH_WHOLE_KEYSTROKES; k++) {
+        editorRowInsertChar(row, at, '"');
+        undoCommit();
+    }
+    benchReport("longline/type-quote", benchNow() - start, 0, BENCH_WHOLE_KEYSTROKES);
+
+    // what every keystroke used to cost
+    start = benchNow();
+    for (int k = 0; k < BENCH_WHOLE_KEYSTROKES; k++) {
+        editorRowInsertChar(row, at, 'x');
+        editorUpdateRow(row);
+        undoCommit();
+    }
+    benchReport("longline/whole-row-per-key", benchNow() - start, 0, BENCH_WHOLE_KEYSTROKES);
+
+    unsigned int seed = 9;
+    long long sum = 0;
+    start = benchNow();
+    for (int k = 0; k < BENCH_SEEKS; k++) {
+        seed = seed * 1103515245 + 12345;
+        int spanStart;
+        sum += highlightSeek(row, seed % row->renderSize, &spanStart) + spanStart;
+    }
+    benchReport("longline/first-span-of-draw", benchNow() - start, 0, BENCH_SEEKS);
+
+    // an edit before an earlier one, whose shift the brackets past it still owe
+    editorRowInsertChar(row, row->rowSize * 3 / 4, 'x');
+    undoCommit();
+    editorRowInsertChar(row, 1000, 'x');
+    undoCommit();
+
+    struct bracketRow *b = row->brackets;
+    int placed = b != NULL;
+    for (int i = 0; placed && i < b->count; i++) {
+        int cx = BRACKET_CX(b->at[i]) + (i >= b->shiftFrom ? b->shift : 0);
+        placed = cx < row->rowSize && row->characters[cx] && strchr("()[]{}", row->characters[cx]) != NULL;
+    }
+    benchCheck("longline/brackets-after-edits", placed);
+
+    if (sum == 0) { benchReport("longline/checksum", 0, 0, sum); }
+    benchUnload();
+}
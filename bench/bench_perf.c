@@ -0,0 +1,35 @@
+/* Benchmarks of the performance counters' own overhead. */
+
+#include "core.h"
+#include "bench.h"
+#include "perf.h"
+#include "ops/rowops.h"
+
+#define BENCH_TIMINGS 1000000
+#define BENCH_PERCENTILES 10000
+
+
+void benchPerf() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+
+    // what every instrumented call pays on top of its own work
+    double start = benchNow();
+    for (int k = 0; k < BENCH_TIMINGS; k++) {
+        perfStop(PERF_UPDATE_ROW, perfStart(PERF_UPDATE_ROW));
+    }
+    benchReport("perf/timer-per-row-call", benchNow() - start, 0, BENCH_TIMINGS);
+
+    start = benchNow();
+    for (int j = 0; j < CONFIG.numRows; j++) { editorUpdateRow(&CONFIG.row[j]); }
+    benchReport("perf/update-every-row-timed", benchNow() - start, benchBufferBytes(), CONFIG.numRows);
+
+    // the HUD computes the percentile on every refresh
+    double sum = 0;
+    for (int k = 0; k < BENCH_TIMINGS / 1000; k++) { perfStop(PERF_REFRESH, perfStart(PERF_REFRESH)); }
+    start = benchNow();
+    for (int k = 0; k < BENCH_PERCENTILES; k++) { sum += perfFramePercentile(0.99); }
+    benchReport("perf/frame-percentile", benchNow() - start, 0, BENCH_PERCENTILES);
+
+    if (sum < 0) { benchReport("perf/checksum", 0, 0, 0); }
+    benchReload();
+}
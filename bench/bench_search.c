@@ -0,0 +1,111 @@
+/* Search and replace benchmarks over a synthetic log. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "bench.h"
+#include "search.h"
+#include "ops/rowops.h"
+
+#define BENCH_LONG_ROW (1 << 20)
+
+
+struct searchCase {
+    const char *name;
+    const char *query;
+    int mode;
+};
+
+static struct searchCase CASES[] = {
+    {"literal/common", "user=", SEARCH_LITERAL},
+    {"literal/rare", "req=deadbeef", SEARCH_LITERAL},
+    {"regex/literal-rare", "req=deadbeef", SEARCH_REGEX},
+    {"regex/timestamp", "\\d{4}-\\d\\d-\\d\\dT\\d\\d:\\d\\d:\\d\\d", SEARCH_REGEX},
+    {"regex/request-id", "req=[0-9a-f]{8}", SEARCH_REGEX},
+    {"regex/alternation", "ERROR|WARN", SEARCH_REGEX},
+    {"regex/5xx-anchored", " 5\\d\\d \\d+ms$", SEARCH_REGEX},
+    {"multi/4-patterns", "ERROR|WARN| 500 |/healthz", SEARCH_MULTI},
+};
+
+#define CASE_ENTRIES (sizeof(CASES) / sizeof(CASES[0]))
+
+
+void benchSearch() {
+    benchLoad(benchCorpusLog(benchCorpusBytes()));
+    long long bytes = benchBufferBytes();
+
+    for (unsigned int c = 0; c < CASE_ENTRIES; c++) {
+        double start = benchNow();
+        int found = searchBuffer(CASES[c].query, CASES[c].mode);
+        benchReport(CASES[c].name, benchNow() - start, bytes, found);
+    }
+
+    // a watch-list of signatures, most of which never occur
+    char watch[64 * 24] = "";
+    for (int p = 0; p < 64; p++) {
+        char pattern[24];
+        snprintf(pattern, sizeof(pattern), "%sreq=%04xbeef", p ? "|" : "", p * 977);
+        strcat(watch, pattern);
+    }
+    double start = benchNow();
+    int found = searchBuffer(watch, SEARCH_MULTI);
+    benchReport("multi/64-patterns", benchNow() - start, bytes, found);
+
+    start = benchNow();
+    found = 0;
+    for (char *p = strtok(watch, "|"); p; p = strtok(NULL, "|")) {
+        found += searchBuffer(p, SEARCH_LITERAL);
+    }
+    benchReport("literal/64-passes", benchNow() - start, bytes, found);
+
+    // typing a query, clearing it and typing another one in the find prompt
+    const char *typed[] = {"u", "", "r", "re", "req", "req="};
+    const int keys[] = {'u', BACKSPACE, 'r', 'e', 'q', '='};
+    CONFIG.cursorX = 0;
+    CONFIG.cursorY = 0;
+    start = benchNow();
+    for (int k = 0; k < 6; k++) { findCallback((char *) typed[k], keys[k]); }
+    benchReport("literal/retyped", benchNow() - start, bytes, 6);
+
+    editorRow *row = &CONFIG.row[CONFIG.cursorY];
+    int rx = editorRowCxToRx(row, CONFIG.cursorX);
+    benchCheck("literal/retyped", CONFIG.cursorY || rx ? !strncmp(&row->render[rx], "req=", 4) : 0);
+    findCallback("req=", '\x1b');
+
+    // classic catastrophic-backtracking pattern against a long miss
+    char line[4097];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+
+    editorInsertRow(CONFIG.numRows, line, sizeof(line) - 1);
+    start = benchNow();
+    found = searchBuffer("(x+x+)+[yz]", SEARCH_REGEX);
+    benchReport("regex/pathological", benchNow() - start, bytes, found);
+    editorDelRow(CONFIG.numRows - 1);
+
+    // every '~' matches alone, but could be the start of a longer match
+    // running up to a '!' that never comes
+    char *tildes = malloc(BENCH_LONG_ROW);
+    if (tildes == NULL) { die("malloc"); }
+    memset(tildes, '~', BENCH_LONG_ROW);
+
+    editorInsertRow(CONFIG.numRows, tildes, BENCH_LONG_ROW);
+    start = benchNow();
+    found = searchBuffer("~.*!|~", SEARCH_REGEX);
+    benchReport("regex/long-row-rescan", benchNow() - start, BENCH_LONG_ROW, found);
+    benchCheck("regex/long-row-rescan", found == BENCH_LONG_ROW);
+    editorDelRow(CONFIG.numRows - 1);
+    free(tildes);
+
+    start = benchNow();
+    found = searchReplaceAll("user=", 0, "uid=");
+    benchReport("replace/literal", benchNow() - start, bytes, found);
+
+    start = benchNow();
+    found = searchReplaceAll("req=[0-9a-f]+", 1, "req=?");
+    benchReport("replace/regex", benchNow() - start, bytes, found);
+
+    benchReload();
+}
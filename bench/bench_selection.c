@@ -0,0 +1,42 @@
+/* Selection benchmarks: cutting and pasting large row ranges. */
+
+#include <stdio.h>
+
+#include "core.h"
+#include "bench.h"
+#include "ops/selection.h"
+#include "ops/undo.h"
+
+#define BENCH_SELECTION_ROWS 100000
+
+
+void benchSelection() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+    int rows = CONFIG.numRows - 1 < BENCH_SELECTION_ROWS ? CONFIG.numRows - 1 : BENCH_SELECTION_ROWS;
+
+    CONFIG.cursorX = 2;
+    CONFIG.cursorY = 0;
+    selectionToggle();
+    CONFIG.cursorY = rows;
+
+    double start = benchNow();
+    selectionCut();
+    undoCommit();
+    benchReport("selection/cut-100k-rows", benchNow() - start, 0, rows);
+
+    start = benchNow();
+    selectionPaste();
+    undoCommit();
+    benchReport("selection/paste-100k-rows", benchNow() - start, 0, rows);
+
+    CONFIG.cursorX = 0;
+    CONFIG.cursorY = 0;
+    selectionToggle();
+    CONFIG.cursorY = rows;
+
+    start = benchNow();
+    selectionCopy();
+    benchReport("selection/copy-100k-rows", benchNow() - start, 0, rows);
+
+    benchReload();
+}
@@ -0,0 +1,64 @@
+/* Syntax definition loading benchmarks. */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "bench.h"
+#include "highlight.h"
+#include "syntax.h"
+
+#define BENCH_LANGUAGES 50
+#define BENCH_KEYWORDS 120
+#define BENCH_WARM_RUNS 20
+
+
+/* Writes a directory of made-up but realistically sized definitions. */
+static const char *writeDefinitions() {
+    static char dir[] = "/tmp/mooseBench-syntax";
+    mkdir(dir, 0755);
+
+    for (int l = 0; l < BENCH_LANGUAGES; l++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/lang%02d.syntax", dir, l);
+
+        FILE *fp = fopen(path, "w");
+        if (fp == NULL) { die("fopen"); }
+
+        fprintf(fp, "filetype lang%02d\nmatch .l%02d .lang%02d\n", l, l, l);
+        fprintf(fp, "comment %s\nmultiline {- -}\n", (l % 2) ? "#" : "--");
+        for (int k = 0; k < BENCH_KEYWORDS; k++) {
+            fprintf(fp, "%s kw%d_%02d\n", (k % 4) ? "keywords" : "types", k, l);
+        }
+        fprintf(fp, "highlight numbers strings\n");
+        fclose(fp);
+    }
+
+    char cache[256];
+    snprintf(cache, sizeof(cache), "%s/.cache", dir);
+    unlink(cache);
+    return dir;
+}
+
+
+void benchSyntax() {
+    const char *dir = writeDefinitions();
+
+    double start = benchNow();
+    loadSyntaxDefinitions("/tmp/mooseBench-syntax-none");
+    benchReport("syntax/no-definitions", benchNow() - start, 0, 0);
+
+    start = benchNow();
+    loadSyntaxDefinitions(dir);
+    benchReport("syntax/parse-and-cache-50", benchNow() - start, 0, BENCH_LANGUAGES);
+
+    start = benchNow();
+    for (int r = 0; r < BENCH_WARM_RUNS; r++) { loadSyntaxDefinitions(dir); }
+    benchReport("syntax/mapped-cache-50", (benchNow() - start) / BENCH_WARM_RUNS, 0, BENCH_LANGUAGES);
+
+    setLoadedSyntaxes(NULL, 0);
+}
@@ -0,0 +1,64 @@
+/* Undo log benchmarks over a synthetic C file. */
+
+#include <stdlib.h>
+
+#include "core.h"
+#include "bench.h"
+#include "ops/editorops.h"
+#include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define BENCH_PASTE_ROWS 100000
+#define BENCH_TYPED_CHARS 10000
+
+
+void benchUndo() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+
+    // a paste of the buffer's own first rows at the top, as one edit
+    int rows = CONFIG.numRows < BENCH_PASTE_ROWS ? CONFIG.numRows : BENCH_PASTE_ROWS;
+    char **lines = malloc(sizeof(char *) * rows);
+    size_t *lens = malloc(sizeof(size_t) * rows);
+    long long bytes = 0;
+    for (int j = 0; j < rows; j++) {
+        lines[j] = CONFIG.row[j].characters;
+        lens[j] = CONFIG.row[j].rowSize;
+        bytes += lens[j];
+    }
+
+    double start = benchNow();
+    editorBeginBatch();
+    editorInsertRows(0, lines, lens, rows);
+    editorEndBatch();
+    undoCommit();
+    benchReport("undo/paste-100k-rows", benchNow() - start, bytes, rows);
+    free(lines);
+    free(lens);
+
+    start = benchNow();
+    undo();
+    benchReport("undo/undo-paste", benchNow() - start, bytes, rows);
+
+    start = benchNow();
+    redo();
+    benchReport("undo/redo-paste", benchNow() - start, bytes, rows);
+    undo();
+
+    // typing coalesces into a single op
+    CONFIG.cursorX = 0;
+    CONFIG.cursorY = 0;
+    undoReset();
+    start = benchNow();
+    for (int c = 0; c < BENCH_TYPED_CHARS; c++) {
+        insertChar('a' + c % 26);
+        undoCommit();
+    }
+    benchReport("undo/type-10k-chars", benchNow() - start, BENCH_TYPED_CHARS, BENCH_TYPED_CHARS);
+    benchNote("memory/undo-typing-10k", undoMemory(), "bytes");
+
+    start = benchNow();
+    undo();
+    benchReport("undo/undo-typing", benchNow() - start, BENCH_TYPED_CHARS, 1);
+
+    benchReload();
+}
@@ -0,0 +1,52 @@
+/* UTF-8 rendering benchmarks: plain ASCII against mixed script logs. */
+
+#include "core.h"
+#include "bench.h"
+#include "utf8.h"
+#include "ops/rowops.h"
+
+
+/* Renders every row again; highlighting is left to the viewport. */
+static double renderAll() {
+    double start = benchNow();
+    editorBeginBatch();
+    for (int j = 0; j < CONFIG.numRows; j++) { editorUpdateRow(&CONFIG.row[j]); }
+    editorEndBatch();
+    return benchNow() - start;
+}
+
+
+static void scanAll(const char *name) {
+    long long bytes = 0;
+    int ascii = 0;
+
+    double start = benchNow();
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        ascii += utf8IsAscii(CONFIG.row[j].characters, CONFIG.row[j].rowSize);
+        bytes += CONFIG.row[j].rowSize;
+    }
+    benchReport(name, benchNow() - start, bytes, ascii);
+}
+
+
+void benchUtf8() {
+    benchLoad(benchCorpusLog(benchCorpusBytes()));
+    scanAll("utf8/ascii-check-ascii-log");
+    benchReport("utf8/render-ascii-log", renderAll(), benchBufferBytes(), CONFIG.numRows);
+
+    benchLoad(benchCorpusMixed(benchCorpusBytes()));
+    scanAll("utf8/ascii-check-mixed-log");
+    benchReport("utf8/render-mixed-log", renderAll(), benchBufferBytes(), CONFIG.numRows);
+
+    // the end of every row, as the cursor sits there after End
+    long long sum = 0;
+    double start = benchNow();
+    for (int j = 0; j < CONFIG.numRows; j++) {
+        editorRow *row = &CONFIG.row[j];
+        sum += editorRowRxToCol(row, editorRowCxToRx(row, row->rowSize));
+    }
+    benchReport("utf8/cx-to-column-mixed-log", benchNow() - start, 0, CONFIG.numRows);
+
+    if (sum == 0) { benchReport("utf8/checksum", 0, 0, sum); }
+    benchReload();
+}
@@ -0,0 +1,51 @@
+/* Word completion benchmarks over a synthetic C file. */
+
+#include <string.h>
+
+#include "core.h"
+#include "bench.h"
+#include "words.h"
+#include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define BENCH_QUERIES 100000
+#define BENCH_KEYSTROKES 1000
+#define BENCH_CANDIDATES 8
+
+
+void benchWords() {
+    benchLoad(benchCorpusC(benchCorpusBytes()));
+    char found[BENCH_CANDIDATES][WORDS_MAX_LEN + 1];
+    long long sum = 0;
+
+    // what the background worker does over the idle moments after opening
+    double start = benchNow();
+    while (wordsPending()) { wordsIndexSlice(); }
+    benchReport("words/index-buffer", benchNow() - start, benchBufferBytes(), CONFIG.numRows);
+
+    // short prefixes have many words below them, stage_ over a hundred thousand
+    static const char *prefixes[] = {"c", "co", "n", "va", "st", "stage_", "stage_12", "ret"};
+    start = benchNow();
+    for (int k = 0; k < BENCH_QUERIES; k++) {
+        const char *prefix = prefixes[k % 8];
+        sum += wordsComplete(prefix, strlen(prefix), found, BENCH_CANDIDATES);
+    }
+    benchReport("words/complete-prefix", benchNow() - start, 0, BENCH_QUERIES);
+
+    // each keystroke updates the words around it, then asks for completions
+    int at = CONFIG.numRows / 2;
+    editorRow *row = &CONFIG.row[at];
+    const char *typing = "stage_1234 ";
+    start = benchNow();
+    for (int k = 0; k < BENCH_KEYSTROKES; k++) {
+        editorRowInsertChar(row, row->rowSize, typing[k % 11]);
+        undoCommit();
+
+        int from = row->rowSize - 1 - k % 11;
+        sum += wordsComplete(&row->characters[from], row->rowSize - from, found, BENCH_CANDIDATES);
+    }
+    benchReport("words/type-and-complete", benchNow() - start, 0, BENCH_KEYSTROKES);
+
+    if (sum == 0) { benchReport("words/checksum", 0, 0, sum); }
+    benchReload();
+}
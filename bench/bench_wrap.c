@@ -0,0 +1,55 @@
+/* Soft wrap benchmarks over the synthetic service log. */
+
+#include "core.h"
+#include "bench.h"
+#include "wrap.h"
+#include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define BENCH_WRAP_COLS 40
+#define BENCH_LOOKUPS 100000
+#define BENCH_KEYSTROKES 1000
+
+
+void benchWrap() {
+    benchLoad(benchCorpusLog(benchCorpusBytes()));
+    int cols = CONFIG.screenCols;
+    CONFIG.screenCols = BENCH_WRAP_COLS;
+
+    double start = benchNow();
+    wrapToggle();
+    int lines = wrapLinesBefore(CONFIG.numRows);
+    benchReport("wrap/layout-all-rows", benchNow() - start, benchBufferBytes(), lines);
+
+    unsigned int seed = 5;
+    long long sum = 0;
+    start = benchNow();
+    for (int k = 0; k < BENCH_LOOKUPS; k++) {
+        seed = seed * 1103515245 + 12345;
+        int sub;
+        sum += wrapRowAt(seed % lines, &sub) + sub;
+    }
+    benchReport("wrap/screen-line-to-row", benchNow() - start, 0, BENCH_LOOKUPS);
+
+    // typing that pushes a row onto another screen line updates the tree in place
+    editorRow *row = &CONFIG.row[CONFIG.numRows / 2];
+    start = benchNow();
+    for (int k = 0; k < BENCH_KEYSTROKES; k++) {
+        editorRowInsertChar(row, row->rowSize, 'x');
+        undoCommit();
+        sum += wrapLinesBefore(CONFIG.numRows);
+    }
+    benchReport("wrap/type-in-long-row", benchNow() - start, 0, BENCH_KEYSTROKES);
+
+    // a new row shifts the rest, so the tree is rebuilt once
+    start = benchNow();
+    editorInsertRow(CONFIG.numRows / 2, "", 0);
+    sum += wrapLinesBefore(CONFIG.numRows);
+    benchReport("wrap/insert-row-rebuild", benchNow() - start, 0, CONFIG.numRows);
+
+    if (sum == 0) { benchReport("wrap/checksum", 0, 0, sum); }
+
+    wrapToggle();
+    CONFIG.screenCols = cols;
+    benchReload();
+}
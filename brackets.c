@@ -0,0 +1,489 @@
+/* Bracket matching over an index kept up to date by the highlighter. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "brackets.h"
+#include "core.h"
+#include "highlight.h"
+#include "ops/rowops.h"
+
+#define BRACKET_BLOCK_ROWS 64
+
+
+/*
+* Every time the highlighter lexes a row it also notes the brackets in it
+* that count. A segment tree over blocks of rows sums up how each kind's
+* nesting goes over them, so the row a bracket's match is on is found by
+* descending the tree, past whole stretches of the file that can't
+* contain it, and then looking at a block's rows at most.
+*
+* Editing a row updates its path up the tree, from the sums each row
+* keeps of its own brackets. Inserting or removing rows
+* moves every block after them, so the tree is then rebuilt, in linear
+* time, the next time it is needed; so is a parallel highlighting pass,
+* whose threads only update the rows they lex.
+*/
+static struct {
+    struct bracketSum (*tree)[BRACKET_KINDS];  // 1-based, leaves from leaves
+    int leaves;
+    int capacity;
+    int rows;
+    int valid;
+    int deferred;
+} BRACKETS = {NULL, 0, 0, 0, 0, 0};
+
+
+// 1 more than a bracket's code, for the bytes that are one
+static const unsigned char CODE[256] = {
+    ['('] = 1, ['['] = 2, ['{'] = 3,
+    [')'] = BRACKET_CLOSE + 1, [']'] = BRACKET_CLOSE + 2, ['}'] = BRACKET_CLOSE + 3,
+};
+
+
+static void combine(struct bracketSum *out, const struct bracketSum *a, const struct bracketSum *b) {
+    for (int k = 0; k < BRACKET_KINDS; k++) {
+        struct bracketSum s;
+        s.net = a[k].net + b[k].net;
+        s.low = (a[k].net + b[k].low < a[k].low) ? a[k].net + b[k].low : a[k].low;
+        s.rlow = (a[k].rlow - b[k].net < b[k].rlow) ? a[k].rlow - b[k].net : b[k].rlow;
+        out[k] = s;
+    }
+}
+
+
+/* How count brackets in a row go, for each kind. */
+static void summarise(struct bracketSum *sum, const int *at, int count) {
+    memset(sum, 0, sizeof(struct bracketSum) * BRACKET_KINDS);
+
+    for (int i = 0; i < count; i++) {
+        struct bracketSum *s = &sum[BRACKET_KIND(at[i])];
+        s->net += BRACKET_CLOSES(at[i]) ? -1 : 1;
+        if (s->net < s->low) { s->low = s->net; }
+    }
+
+    int back[BRACKET_KINDS] = {0};
+    for (int i = count - 1; i >= 0; i--) {
+        int k = BRACKET_KIND(at[i]);
+        back[k] += BRACKET_CLOSES(at[i]) ? 1 : -1;
+        if (back[k] < sum[k].rlow) { sum[k].rlow = back[k]; }
+    }
+}
+
+
+static void blockSum(int block, struct bracketSum *out) {
+    memset(out, 0, sizeof(struct bracketSum) * BRACKET_KINDS);
+
+    int last = (block + 1) * BRACKET_BLOCK_ROWS;
+    if (last > CONFIG.numRows) { last = CONFIG.numRows; }
+    for (int j = block * BRACKET_BLOCK_ROWS; j < last; j++) {
+        struct bracketRow *b = CONFIG.row[j].brackets;
+        if (b) { combine(out, out, b->sum); }
+    }
+}
+
+
+static void rebuild() {
+    int blocks = (CONFIG.numRows + BRACKET_BLOCK_ROWS - 1) / BRACKET_BLOCK_ROWS;
+    BRACKETS.leaves = 1;
+    while (BRACKETS.leaves < blocks) { BRACKETS.leaves *= 2; }
+
+    if (2 * BRACKETS.leaves > BRACKETS.capacity) {
+        BRACKETS.capacity = 2 * BRACKETS.leaves;
+        BRACKETS.tree = realloc(BRACKETS.tree, sizeof(*BRACKETS.tree) * BRACKETS.capacity);
+        if (BRACKETS.tree == NULL) { die("realloc"); }
+    }
+    memset(BRACKETS.tree, 0, sizeof(*BRACKETS.tree) * 2 * BRACKETS.leaves);
+
+    for (int b = 0; b < blocks; b++) { blockSum(b, BRACKETS.tree[BRACKETS.leaves + b]); }
+    for (int i = BRACKETS.leaves - 1; i > 0; i--) {
+        combine(BRACKETS.tree[i], BRACKETS.tree[2 * i], BRACKETS.tree[2 * i + 1]);
+    }
+    BRACKETS.rows = CONFIG.numRows;
+    BRACKETS.valid = 1;
+}
+
+
+/* Takes a row's new brackets into the tree, unless the tree is due a rebuild. */
+static void rowChanged(editorRow *row) {
+    if (!BRACKETS.valid || BRACKETS.deferred || row->index >= BRACKETS.rows) {
+        BRACKETS.valid = 0;
+        return;
+    }
+
+    int i = BRACKETS.leaves + row->index / BRACKET_BLOCK_ROWS;
+    blockSum(row->index / BRACKET_BLOCK_ROWS, BRACKETS.tree[i]);
+    for (i /= 2; i > 0; i /= 2) {
+        combine(BRACKETS.tree[i], BRACKETS.tree[2 * i], BRACKETS.tree[2 * i + 1]);
+    }
+}
+
+
+/*
+* Appends the brackets in len lexed bytes of text to out, columns in the
+* characters. Text that is a row's render is converted back to those
+* columns, at offset rx of it.
+*/
+static int collect(editorRow *row, const char *text, const unsigned char *hl, int rx, int len, int *out) {
+    int rendered = (row->render != NULL && text == &row->render[rx]);
+
+    // past each column stop the characters are delta further on than the render
+    int k = 0;
+    int delta = 0;
+    if (rendered) {
+        int hi = row->numStops;
+        while (k < hi) {
+            int mid = (k + hi) / 2;
+            if (row->stops[mid].rx < rx) { k = mid + 1; }
+            else { hi = mid; }
+        }
+    }
+    if (k > 0) {
+        columnStop *stop = &row->stops[k - 1];
+        delta = stop->cx + stop->bytes - stop->rx - stop->renderBytes;
+    }
+
+    int count = 0;
+    for (int i = 0; i < len; i++) {
+        int code = CODE[(unsigned char) text[i]];
+        if (code == 0 || hl[i] != HL_NORMAL) { continue; }
+
+        if (rendered) {
+            for (; k < row->numStops && row->stops[k].rx < rx + i; k++) {
+                delta = row->stops[k].cx + row->stops[k].bytes - row->stops[k].rx - row->stops[k].renderBytes;
+            }
+        }
+        if (out) { out[count] = ((rx + i + delta) << 3) | (code - 1); }
+        count++;
+    }
+    return count;
+}
+
+
+/* Resizes a row's brackets to hold count, a new one starting with none. */
+static struct bracketRow *resizeBrackets(struct bracketRow *b, int count) {
+    int fresh = (b == NULL);
+
+    b = realloc(b, sizeof(struct bracketRow) + sizeof(int) * count);
+    if (b == NULL) { die("realloc"); }
+
+    if (fresh) { memset(b->sum, 0, sizeof(b->sum)); }
+    return b;
+}
+
+
+/* Column of a row's bracket i. */
+static int columnOf(const struct bracketRow *b, int i) {
+    return BRACKET_CX(b->at[i]) + (i >= b->shiftFrom ? b->shift : 0);
+}
+
+
+/* Adds shift to the columns of a row's brackets from index from to before to. */
+static void shiftColumns(struct bracketRow *b, int from, int to, int shift) {
+    for (int i = from; i < to; i++) { b->at[i] += shift * 8; }
+}
+
+
+/* Number of a row's brackets before column cx. */
+static int bracketsBefore(const struct bracketRow *b, int cx) {
+    if (b == NULL) { return 0; }
+
+    int lo = 0;
+    int hi = b->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (columnOf(b, mid) < cx) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    return lo;
+}
+
+
+/* Replaces a row's brackets, updating the tree if their nesting changed. */
+static void setBrackets(editorRow *row, struct bracketRow *b) {
+    static const struct bracketSum none[BRACKET_KINDS];
+    const struct bracketSum *before = row->brackets ? row->brackets->sum : none;
+    const struct bracketSum *after = b ? b->sum : none;
+    int changed = memcmp(before, after, sizeof(none)) != 0;
+
+    free(row->brackets);
+    row->brackets = b;
+    if (changed) { rowChanged(row); }
+}
+
+
+/*
+* Takes a row's brackets from a lex of the whole of it: its render, or
+* the characters of a row hidden in a fold, with hl the class of each of
+* the len bytes.
+*/
+void bracketsFromLex(editorRow *row, const char *text, const unsigned char *hl, int len) {
+    int count = collect(row, text, hl, 0, len, NULL);
+    struct bracketRow *b = NULL;
+
+    if (count) {
+        b = resizeBrackets(NULL, count);
+        b->rowSize = row->rowSize;
+        b->count = count;
+        b->shiftFrom = count;
+        b->shift = 0;
+        collect(row, text, hl, 0, len, b->at);
+        summarise(b->sum, b->at, count);
+    }
+    setBrackets(row, b);
+}
+
+
+/*
+* Takes a long row's brackets from a lex of len render bytes from render
+* column from on, after an edit. Those before are as they were, and if
+* the lex synced up with the old one before the end, so are those past
+* it, just moved along. Only the lexed ones are replaced, in place, and
+* unless their nesting changed the row's sum still holds.
+*
+* Moving those past along is left to the row's pending shift, which
+* successive edits to the same stretch of the row add to. It is only
+* carried out on the brackets it no longer fits.
+*/
+void bracketsFromEdit(editorRow *row, int from, const unsigned char *hl, int len, int synced) {
+    struct bracketRow *b = row->brackets;
+    int oldCount = b ? b->count : 0;
+    int shift = b ? row->rowSize - b->rowSize : 0;
+
+    int before = bracketsBefore(b, editorRowRxToCx(row, from));
+    int after = oldCount;
+    if (synced) {
+        after = bracketsBefore(b, editorRowRxToCx(row, from + len) - shift);
+        if (after < before) { after = before; }
+    }
+
+    int fresh = collect(row, &row->render[from], hl, from, len, NULL);
+    int count = before + fresh + oldCount - after;
+    if (count == 0) {
+        setBrackets(row, NULL);
+        return;
+    }
+
+    struct bracketSum was[BRACKET_KINDS];
+    int pending = 0;
+    if (b) {
+        summarise(was, &b->at[before], after - before);
+
+        // the old shift must cover the brackets after the lexed ones
+        // exactly, so it goes on to cover theirs from where they end up;
+        // those it didn't cover yet are set back by it to make up
+        pending = b->shift;
+        if (b->shiftFrom > after) {
+            shiftColumns(b, after, b->shiftFrom, -pending);
+            b->shiftFrom = after;
+        }
+        if (b->shiftFrom < before) { shiftColumns(b, b->shiftFrom, before, pending); }
+    } else {
+        memset(was, 0, sizeof(was));
+    }
+
+    if (count > oldCount) { b = resizeBrackets(b, count); }
+    if (before + fresh != after) {
+        memmove(&b->at[before + fresh], &b->at[after], sizeof(int) * (oldCount - after));
+    }
+    if (count < oldCount) { b = resizeBrackets(b, count); }
+
+    collect(row, &row->render[from], hl, from, len, &b->at[before]);
+    b->rowSize = row->rowSize;
+    b->count = count;
+    b->shiftFrom = before + fresh;
+    b->shift = (b->shiftFrom < count) ? pending + shift : 0;
+    row->brackets = b;
+
+    struct bracketSum now[BRACKET_KINDS];
+    summarise(now, &b->at[before], fresh);
+    if (!memcmp(was, now, sizeof(now))) { return; }
+
+    struct bracketSum sum[BRACKET_KINDS];
+    memcpy(sum, b->sum, sizeof(sum));
+    summarise(b->sum, b->at, count);
+    if (memcmp(sum, b->sum, sizeof(sum))) { rowChanged(row); }
+}
+
+
+/*
+* While deferred, rows are lexed on several threads at once: they only
+* update their own brackets, and the tree is rebuilt afterwards.
+*/
+void bracketsDefer(int defer) {
+    BRACKETS.deferred = defer;
+    if (!defer) { BRACKETS.valid = 0; }
+}
+
+
+void bracketsRowsMoved() {
+    BRACKETS.valid = 0;
+}
+
+
+/*
+* Looks for the bracket of kind closing the one before where a scan
+* starts, in row at from index i on, keeping the nesting so far in depth.
+* Returns the bracket's index, or -1.
+*/
+static int scanForward(int at, int i, int kind, int *depth) {
+    struct bracketRow *b = CONFIG.row[at].brackets;
+    if (b == NULL) { return -1; }
+
+    for (; i < b->count; i++) {
+        if (BRACKET_KIND(b->at[i]) != kind) { continue; }
+        *depth += BRACKET_CLOSES(b->at[i]) ? -1 : 1;
+        if (*depth < 0) { return i; }
+    }
+    return -1;
+}
+
+
+/* As scanForward, backwards from before index i, or the row's end if i is -1. */
+static int scanBackward(int at, int i, int kind, int *depth) {
+    struct bracketRow *b = CONFIG.row[at].brackets;
+    if (b == NULL) { return -1; }
+
+    if (i < 0) { i = b->count; }
+    while (--i >= 0) {
+        if (BRACKET_KIND(b->at[i]) != kind) { continue; }
+        *depth += BRACKET_CLOSES(b->at[i]) ? 1 : -1;
+        if (*depth < 0) { return i; }
+    }
+    return -1;
+}
+
+
+/* First block from block from on that holds the match, or -1. */
+static int descendForward(int node, int lo, int hi, int from, int kind, int *depth) {
+    if (hi <= from) { return -1; }
+
+    struct bracketSum *s = &BRACKETS.tree[node][kind];
+    if (from <= lo && *depth + s->low > -1) {
+        *depth += s->net;
+        return -1;
+    }
+    if (hi - lo == 1) { return lo; }
+
+    int mid = (lo + hi) / 2;
+    int block = descendForward(2 * node, lo, mid, from, kind, depth);
+    if (block >= 0) { return block; }
+    return descendForward(2 * node + 1, mid, hi, from, kind, depth);
+}
+
+
+/* Last block before block before that holds the match, or -1. */
+static int descendBackward(int node, int lo, int hi, int before, int kind, int *depth) {
+    if (lo >= before) { return -1; }
+
+    struct bracketSum *s = &BRACKETS.tree[node][kind];
+    if (hi <= before && *depth + s->rlow > -1) {
+        *depth -= s->net;
+        return -1;
+    }
+    if (hi - lo == 1) { return lo; }
+
+    int mid = (lo + hi) / 2;
+    int block = descendBackward(2 * node + 1, mid, hi, before, kind, depth);
+    if (block >= 0) { return block; }
+    return descendBackward(2 * node, lo, mid, before, kind, depth);
+}
+
+
+/* Index of the bracket at column cx of a row, or -1. */
+static int bracketAt(struct bracketRow *b, int cx) {
+    if (b == NULL) { return -1; }
+
+    int i = bracketsBefore(b, cx);
+    return (i < b->count && columnOf(b, i) == cx) ? i : -1;
+}
+
+
+/*
+* The bracket at column x of row y, or else the one just before it, and
+* the one it matches. Sets the column of the first in atX, or -1 if there
+* is none, and where the other is in matchY and matchX. Returns whether
+* there is a match.
+*
+* Only as good as the highlighting of the rows from the first of the two
+* to the last: rows still waiting for it may have moved their brackets.
+*/
+int bracketMatch(int y, int x, int *atX, int *matchY, int *matchX) {
+    *atX = -1;
+    if (y < 0 || y >= CONFIG.numRows) { return 0; }
+
+    struct bracketRow *b = CONFIG.row[y].brackets;
+    int i = bracketAt(b, x);
+    if (i < 0 && x > 0) { i = bracketAt(b, x - 1); }
+    if (i < 0) { return 0; }
+    *atX = columnOf(b, i);
+
+    if (!BRACKETS.valid) { rebuild(); }
+
+    int kind = BRACKET_KIND(b->at[i]);
+    int forward = !BRACKET_CLOSES(b->at[i]);
+    int depth = 0;
+    int block = y / BRACKET_BLOCK_ROWS;
+
+    // the rest of the row, then of its block
+    int j = y;
+    int found = forward ? scanForward(y, i + 1, kind, &depth) : scanBackward(y, i, kind, &depth);
+    while (found < 0) {
+        j += forward ? 1 : -1;
+        if (j < 0 || j >= CONFIG.numRows || j / BRACKET_BLOCK_ROWS != block) { break; }
+        found = forward ? scanForward(j, 0, kind, &depth) : scanBackward(j, -1, kind, &depth);
+    }
+
+    // then whole blocks, down to the one it is in
+    if (found < 0) {
+        block = forward
+            ? descendForward(1, 0, BRACKETS.leaves, block + 1, kind, &depth)
+            : descendBackward(1, 0, BRACKETS.leaves, block, kind, &depth);
+        if (block < 0) { return 0; }
+
+        int first = block * BRACKET_BLOCK_ROWS;
+        int last = first + BRACKET_BLOCK_ROWS - 1;
+        if (last >= CONFIG.numRows) { last = CONFIG.numRows - 1; }
+
+        for (j = forward ? first : last; found < 0 && first <= j && j <= last; ) {
+            found = forward ? scanForward(j, 0, kind, &depth) : scanBackward(j, -1, kind, &depth);
+            if (found < 0) { j += forward ? 1 : -1; }
+        }
+        if (found < 0) { return 0; }
+    }
+
+    *matchY = j;
+    *matchX = columnOf(CONFIG.row[j].brackets, found);
+    return 1;
+}
+
+
+/*
+* Moves the cursor to the bracket matching the one at it, highlighting
+* first whatever rows that depends on. Returns 0 if there is none.
+*/
+int bracketJump() {
+    int y = CONFIG.cursorY;
+    int atX, matchY, matchX;
+    int found;
+
+    // the cursor's row must be highlighted for its brackets to count, and
+    // every row up to the match, or to the end for an opening one without
+    while (1) {
+        found = bracketMatch(y, CONFIG.cursorX, &atX, &matchY, &matchX);
+
+        int last = y;
+        if (found && matchY > last) { last = matchY; }
+        if (!found && atX >= 0 && !strchr(")]}", CONFIG.row[y].characters[atX])) {
+            last = CONFIG.numRows - 1;
+        }
+
+        if (CONFIG.highlightFrontier > last) { break; }
+        updateSyntaxRange(CONFIG.highlightFrontier, last);
+    }
+    if (!found) { return 0; }
+
+    CONFIG.cursorY = matchY;
+    CONFIG.cursorX = matchX;
+    return 1;
+}
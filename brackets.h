@@ -0,0 +1,54 @@
+/* Bracket matching headers. */
+
+#ifndef BRACKETS_H
+#define BRACKETS_H
+
+#include "core.h"
+
+#define BRACKET_KINDS 3  // (), [] and {}
+#define BRACKET_CLOSE 4
+
+#define BRACKET_CX(b) ((b) >> 3)
+#define BRACKET_KIND(b) ((b) & 3)
+#define BRACKET_CLOSES(b) ((b) & BRACKET_CLOSE)
+
+
+/*
+* How a run of brackets changes the nesting of one kind: by net overall,
+* dipping at most low below where it started when read forwards (opening
+* brackets counting up), and rlow when read backwards from its end
+* (closing ones counting up).
+*/
+struct bracketSum {
+    int net;
+    int low;
+    int rlow;
+};
+
+
+/*
+* The brackets of a row that the lexer left plain, in order: not in a
+* string or a comment. Each is its character column times 8, plus
+* BRACKET_CLOSE if it closes, plus its kind. A row with none has no
+* bracketRow at all. Edits to a long row move the brackets past them
+* along lazily: from shiftFrom on, their columns are shift further on.
+*/
+struct bracketRow {
+    int rowSize;  // of the characters the columns were taken from
+    int count;
+    int shiftFrom;
+    int shift;
+    struct bracketSum sum[BRACKET_KINDS];  // of all of them
+    int at[];
+};
+
+
+void bracketsFromLex(editorRow *, const char *, const unsigned char *, int);
+void bracketsFromEdit(editorRow *, int, const unsigned char *, int, int);
+void bracketsDefer(int);
+void bracketsRowsMoved();
+
+int bracketMatch(int, int, int *, int *, int *);
+int bracketJump();
+
+#endif
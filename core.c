@@ -6,6 +6,9 @@
 #include <string.h>
 
 #include "core.h"
+#include "perf.h"
+
+struct editorConfig CONFIG;
 
 
 void die(const char *s) {
@@ -27,6 +30,7 @@ void setStatusMessage(const char *fmt, ...) {
 
 void append(struct appendString *as, const char *s, int len) {
     char *newString = realloc(as->s, as->len + len);
+    perfCount(PERF_ALLOCATIONS, 1);
 
     if (newString == NULL) { return; }
 
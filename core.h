@@ -8,6 +8,9 @@
 #define MOOSE_VERSION "0.0.1"
 #define MOOSE_TAB_STOP 8
 #define MOOSE_QUIT_TIMES 3
+#define MOOSE_UNDO_LIMIT (64 << 20)  // bytes of undo history kept
+#define MOOSE_LONG_ROW (64 << 10)         // rows this long are edited a slice at a time
+#define MOOSE_LEX_CHECKPOINT (16 << 10)  // render bytes between lexer checkpoints
 
 #define CTRL_KEY(k) ((k) & 0x1f)
 #define APPENDSTRING_INIT {NULL, 0}
@@ -33,6 +36,35 @@ enum KEYS {
 };
 
 
+/*
+* Highlighting is stored as runs rather than a byte per render column: a
+* span holds a highlight class in its low HL_SPAN_BITS bits and the run's
+* length above them. Longer runs are split over several spans.
+*/
+typedef unsigned short highlightSpan;
+
+#define HL_SPAN_BITS 4
+#define HL_SPAN_MAX_LEN ((1 << (16 - HL_SPAN_BITS)) - 1)
+#define HL_SPAN_CLASS(s) ((s) & ((1 << HL_SPAN_BITS) - 1))
+#define HL_SPAN_LEN(s) ((s) >> HL_SPAN_BITS)
+
+
+/*
+* A character that is not one byte drawn in one column: a tab, or a UTF-8
+* sequence. Rows keep these in order with where each starts in the row,
+* in the render and on screen, so converting between the three kinds of
+* column is a binary search over them rather than a walk along the row.
+*/
+typedef struct columnStop {
+    int cx;
+    int rx;
+    int col;
+    unsigned char bytes;        // in the row
+    unsigned char renderBytes;  // in the render
+    unsigned char width;        // on screen
+} columnStop;
+
+
 typedef struct editorRow {
     int index;
     // stores a line of text as a pointer to dynamically alloc'ed
@@ -42,9 +74,19 @@ typedef struct editorRow {
 
     int renderSize;
     char *render;
+    columnStop *stops;
+    int numStops;
 
-    unsigned char *highlight;
+    int *wraps;  // while wrapping, where each screen line after the first starts
+    int numWraps;
+
+    highlightSpan *highlight;
+    int highlightSpans;
     int highlight_open_comment;
+    int highlight_stale;  // needs highlighting before it is next drawn
+
+    struct lexIndex *lex;  // long rows only: where the lexer can pick up again
+    struct bracketRow *brackets;  // those outside strings and comments, if any
 
 } editorRow;
 
@@ -57,6 +99,8 @@ struct editorSyntax {
     char **filematch;
     char **keywords;
     int flags;
+
+    struct compiledSyntax *compiled;  // lookup tables, built when selected
 };
 
 
@@ -67,6 +111,9 @@ struct editorConfig {
     int colOffset;
     int rowOffset;
 
+    int softWrap;
+    int wrapOffset;  // screen line at the top, while wrapping
+
     int screenRows;
     int screenCols;
 
@@ -83,9 +130,10 @@ struct editorConfig {
     int dirty;
 
     struct editorSyntax *syntax;
+    int highlightFrontier;  // no row above this one is stale
 };
 
-struct editorConfig CONFIG;
+extern struct editorConfig CONFIG;
 
 
 void append(struct appendString *, const char *, int);
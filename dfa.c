@@ -0,0 +1,915 @@
+/* Regular expression search compiled to a lazily built DFA. */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "dfa.h"
+
+#define DFA_MAX_STATES 4096     // cached DFA states before the cache is flushed, fits a short
+#define NFA_MAX_STATES 32768
+#define REGEX_MAX_REPEAT 255
+#define REGEX_MAX_LITERAL 64
+
+#define DFA_UNKNOWN -1
+#define DFA_DEAD -2
+
+
+enum NODES {
+    NODE_EMPTY = 0,
+    NODE_SET,
+    NODE_CAT,
+    NODE_ALT,
+    NODE_STAR,
+    NODE_PLUS,
+    NODE_QUEST,
+    NODE_REPEAT,
+};
+
+
+enum NFA_STATES {
+    NFA_SET = 0,
+    NFA_SPLIT,
+    NFA_MATCH,
+};
+
+
+struct node {
+    int type;
+    int a;
+    int b;
+    int set;
+    int min;
+    int max;  // -1 for unbounded
+};
+
+
+struct nfaState {
+    int type;
+    int out;
+    int out1;
+    int set;
+};
+
+
+/*
+* One direction of the pattern. The NFA is built once; DFA states are
+* subsets of NFA states, created the first time a transition is taken
+* and cached until the cache fills up.
+*/
+struct dfa {
+    struct nfaState *nfa;
+    int nfaLen;
+    int nfaStart;
+    int unanchored;  // re-enter the start state at every byte
+
+    struct regex *re;
+
+    int states;
+    int stateCap;
+    int *trans;      // states * classes, DFA_UNKNOWN until computed
+    char *accept;
+    int *setStart;
+    int *setLen;
+
+    int *pool;
+    int poolLen;
+    int poolCap;
+
+    int *table;      // hash of NFA subset -> DFA state, -1 when empty
+    int tableSize;
+    int start;
+    int flushes;     // state numbers before a flush mean nothing after it
+
+    int *mark;
+    int gen;
+    int *stack;
+    int *work;
+    int workLen;
+};
+
+
+struct regex {
+    unsigned char (*sets)[32];
+    int nsets;
+
+    unsigned char byteClass[256];
+    unsigned char classByte[256];  // representative byte for each class
+    int classes;
+
+    int bol;
+    int eol;
+
+    char literal[REGEX_MAX_LITERAL];  // must appear in every match
+    int literalLen;
+
+    struct dfa forward;
+    struct dfa reverse;
+
+    char *starts;
+    int startsCap;
+
+    // the forward state at each position in [seenFrom, seenTo) of the last
+    // run, or of the runs it joined, whose longest match ends at seenEnd
+    unsigned short *seen;
+    int seenFrom;
+    int seenTo;
+    int seenEnd;
+};
+
+
+struct parser {
+    const char *p;
+    const char *error;
+
+    struct node *nodes;
+    int nodeLen;
+    int nodeCap;
+
+    struct regex *re;
+};
+
+
+/*** parsing ***/
+
+static int setHas(unsigned char *set, int c) {
+    return set[c >> 3] & (1 << (c & 7));
+}
+
+
+static void setAdd(unsigned char *set, int c) {
+    set[c >> 3] |= (1 << (c & 7));
+}
+
+
+static int newSet(struct parser *ps) {
+    struct regex *re = ps->re;
+
+    re->sets = realloc(re->sets, sizeof(re->sets[0]) * (re->nsets + 1));
+    if (re->sets == NULL) { die("realloc"); }
+
+    memset(re->sets[re->nsets], 0, sizeof(re->sets[0]));
+    return re->nsets++;
+}
+
+
+static int newNode(struct parser *ps, int type, int a, int b) {
+    if (ps->nodeLen == ps->nodeCap) {
+        ps->nodeCap = ps->nodeCap ? ps->nodeCap * 2 : 32;
+        ps->nodes = realloc(ps->nodes, sizeof(struct node) * ps->nodeCap);
+        if (ps->nodes == NULL) { die("realloc"); }
+    }
+
+    struct node *n = &ps->nodes[ps->nodeLen];
+    n->type = type;
+    n->a = a;
+    n->b = b;
+    n->set = -1;
+    n->min = 0;
+    n->max = 0;
+    return ps->nodeLen++;
+}
+
+
+static void addEscapeClass(unsigned char *set, int c) {
+    int negate = (c == 'D' || c == 'W' || c == 'S');
+    unsigned char class[32] = {0};
+
+    for (int b = 0; b < 256; b++) {
+        int in = 0;
+        switch (c) {
+            case 'd': case 'D': in = (b >= '0' && b <= '9'); break;
+            case 'w': case 'W':
+                in = (b >= '0' && b <= '9') || (b >= 'a' && b <= 'z')
+                    || (b >= 'A' && b <= 'Z') || b == '_';
+                break;
+            case 's': case 'S':
+                in = (b == ' ' || (b >= '\t' && b <= '\r'));
+                break;
+        }
+        if (in != negate) { setAdd(class, b); }
+    }
+
+    for (int i = 0; i < 32; i++) { set[i] |= class[i]; }
+}
+
+
+static int isClassEscape(int c) {
+    return c && strchr("dDwWsS", c) != NULL;
+}
+
+
+static int escapeByte(int c) {
+    switch (c) {
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        default: return c;
+    }
+}
+
+
+static int parseClass(struct parser *ps) {
+    int s = newSet(ps);
+    unsigned char *set = ps->re->sets[s];
+    int negate = 0;
+
+    if (*ps->p == '^') {
+        negate = 1;
+        ps->p++;
+    }
+
+    int first = 1;
+    while (*ps->p && (*ps->p != ']' || first)) {
+        first = 0;
+        int lo = (unsigned char) *ps->p++;
+
+        if (lo == '\\' && *ps->p) {
+            if (isClassEscape(*ps->p)) {
+                addEscapeClass(ps->re->sets[s], *ps->p++);
+                continue;
+            }
+            lo = escapeByte((unsigned char) *ps->p++);
+        }
+
+        int hi = lo;
+        if (*ps->p == '-' && ps->p[1] && ps->p[1] != ']') {
+            ps->p++;
+            hi = (unsigned char) *ps->p++;
+            if (hi == '\\' && *ps->p) { hi = escapeByte((unsigned char) *ps->p++); }
+        }
+
+        if (hi < lo) {
+            ps->error = "bad range in []";
+            return -1;
+        }
+        for (int c = lo; c <= hi; c++) { setAdd(set, c); }
+    }
+
+    if (*ps->p != ']') {
+        ps->error = "missing ]";
+        return -1;
+    }
+    ps->p++;
+
+    if (negate) {
+        for (int i = 0; i < 32; i++) { set[i] = ~set[i]; }
+    }
+
+    int n = newNode(ps, NODE_SET, -1, -1);
+    ps->nodes[n].set = s;
+    return n;
+}
+
+
+static int parseAlt(struct parser *);
+
+
+static int parseAtom(struct parser *ps) {
+    int c = (unsigned char) *ps->p;
+
+    if (c == '(') {
+        ps->p++;
+        if (ps->p[0] == '?' && ps->p[1] == ':') { ps->p += 2; }
+
+        int n = parseAlt(ps);
+        if (ps->error) { return -1; }
+
+        if (*ps->p != ')') {
+            ps->error = "missing )";
+            return -1;
+        }
+        ps->p++;
+        return n;
+    }
+
+    if (c == '[') {
+        ps->p++;
+        return parseClass(ps);
+    }
+
+    if (c == '*' || c == '+' || c == '?') {
+        ps->error = "nothing to repeat";
+        return -1;
+    }
+
+    int s = newSet(ps);
+    ps->p++;
+
+    if (c == '.') {
+        for (int b = 0; b < 256; b++) {
+            if (b != '\n') { setAdd(ps->re->sets[s], b); }
+        }
+    }
+
+    else if (c == '\\' && *ps->p) {
+        int e = (unsigned char) *ps->p++;
+
+        if (isClassEscape(e)) { addEscapeClass(ps->re->sets[s], e); }
+        else { setAdd(ps->re->sets[s], escapeByte(e)); }
+    }
+
+    else {
+        setAdd(ps->re->sets[s], c);
+    }
+
+    int n = newNode(ps, NODE_SET, -1, -1);
+    ps->nodes[n].set = s;
+    return n;
+}
+
+
+/* Parses "{n}", "{n,}" or "{n,m}"; returns 0 if it isn't a valid bound. */
+static int parseBounds(struct parser *ps, int *min, int *max) {
+    const char *p = ps->p + 1;
+    char *end;
+
+    long lo = strtol(p, &end, 10);
+    if (end == p) { return 0; }
+    long hi = lo;
+
+    if (*end == ',') {
+        p = end + 1;
+        hi = strtol(p, &end, 10);
+        if (end == p) { hi = -1; }
+    }
+
+    if (*end != '}') { return 0; }
+    if (lo < 0 || lo > REGEX_MAX_REPEAT || hi > REGEX_MAX_REPEAT || (hi != -1 && hi < lo)) {
+        ps->error = "bad repetition bound";
+        return 0;
+    }
+
+    *min = lo;
+    *max = hi;
+    ps->p = end + 1;
+    return 1;
+}
+
+
+static int parseRepeat(struct parser *ps) {
+    int n = parseAtom(ps);
+
+    while (!ps->error) {
+        int c = *ps->p;
+        int min, max;
+
+        if (c == '*') { n = newNode(ps, NODE_STAR, n, -1); }
+        else if (c == '+') { n = newNode(ps, NODE_PLUS, n, -1); }
+        else if (c == '?') { n = newNode(ps, NODE_QUEST, n, -1); }
+
+        else if (c == '{' && parseBounds(ps, &min, &max)) {
+            n = newNode(ps, NODE_REPEAT, n, -1);
+            ps->nodes[n].min = min;
+            ps->nodes[n].max = max;
+            continue;
+        }
+
+        else {
+            break;
+        }
+        ps->p++;
+    }
+    return n;
+}
+
+
+static int parseConcat(struct parser *ps) {
+    int left = -1;
+
+    while (*ps->p && *ps->p != '|' && *ps->p != ')') {
+        int n = parseRepeat(ps);
+        if (ps->error) { return -1; }
+
+        left = (left == -1) ? n : newNode(ps, NODE_CAT, left, n);
+    }
+    return (left == -1) ? newNode(ps, NODE_EMPTY, -1, -1) : left;
+}
+
+
+static int parseAlt(struct parser *ps) {
+    int left = parseConcat(ps);
+
+    while (!ps->error && *ps->p == '|') {
+        ps->p++;
+        int right = parseConcat(ps);
+        left = newNode(ps, NODE_ALT, left, right);
+    }
+    return left;
+}
+
+
+/*** literal prefilter ***/
+
+static int singleByte(struct regex *re, int set) {
+    int found = -1;
+
+    for (int c = 0; c < 256; c++) {
+        if (setHas(re->sets[set], c)) {
+            if (found != -1) { return -1; }
+            found = c;
+        }
+    }
+    return found;
+}
+
+
+/*
+* Finds the longest run of plain characters that every match must contain,
+* so rows without it can be skipped with a single memmem.
+*/
+static void requiredLiteral(struct parser *ps, int n, char *run, int *runLen) {
+    struct regex *re = ps->re;
+    struct node *node = &ps->nodes[n];
+
+    if (node->type == NODE_CAT) {
+        requiredLiteral(ps, node->a, run, runLen);
+        requiredLiteral(ps, node->b, run, runLen);
+        return;
+    }
+
+    int c = (node->type == NODE_SET) ? singleByte(re, node->set) : -1;
+    if (c != -1 && *runLen < REGEX_MAX_LITERAL) {
+        run[(*runLen)++] = c;
+    }
+
+    else {
+        *runLen = 0;
+        if (
+            node->type == NODE_PLUS
+            || (node->type == NODE_REPEAT && node->min > 0)
+        ) {
+            char inner[REGEX_MAX_LITERAL];
+            int innerLen = 0;
+            requiredLiteral(ps, node->a, inner, &innerLen);
+        }
+    }
+
+    if (*runLen > re->literalLen) {
+        memcpy(re->literal, run, *runLen);
+        re->literalLen = *runLen;
+    }
+}
+
+
+/*** NFA construction ***/
+
+static int newState(struct dfa *d, int type, int out, int out1, int set) {
+    if (d->nfaLen == NFA_MAX_STATES) { return -1; }
+
+    d->nfa = realloc(d->nfa, sizeof(struct nfaState) * (d->nfaLen + 1));
+    if (d->nfa == NULL) { die("realloc"); }
+
+    struct nfaState *s = &d->nfa[d->nfaLen];
+    s->type = type;
+    s->out = out;
+    s->out1 = out1;
+    s->set = set;
+    return d->nfaLen++;
+}
+
+
+/*
+* Compiles node n so that on success it continues at state next. The
+* graph is built back to front, which makes repetition a matter of
+* compiling the same subtree again. Returns the entry state, -1 on
+* overflow.
+*/
+static int compileNode(struct dfa *d, struct node *nodes, int n, int next, int reverse) {
+    if (next < 0) { return -1; }
+
+    struct node *node = &nodes[n];
+    int s, loop;
+
+    switch (node->type) {
+        case NODE_EMPTY:
+            return next;
+
+        case NODE_SET:
+            return newState(d, NFA_SET, next, -1, node->set);
+
+        case NODE_CAT:
+            if (reverse) {
+                return compileNode(d, nodes, node->b,
+                    compileNode(d, nodes, node->a, next, reverse), reverse);
+            }
+            return compileNode(d, nodes, node->a,
+                compileNode(d, nodes, node->b, next, reverse), reverse);
+
+        case NODE_ALT:
+            s = compileNode(d, nodes, node->a, next, reverse);
+            loop = compileNode(d, nodes, node->b, next, reverse);
+            if (s < 0 || loop < 0) { return -1; }
+            return newState(d, NFA_SPLIT, s, loop, -1);
+
+        case NODE_QUEST:
+            s = compileNode(d, nodes, node->a, next, reverse);
+            if (s < 0) { return -1; }
+            return newState(d, NFA_SPLIT, s, next, -1);
+
+        case NODE_STAR:
+        case NODE_PLUS:
+            loop = newState(d, NFA_SPLIT, -1, next, -1);
+            if (loop < 0) { return -1; }
+
+            s = compileNode(d, nodes, node->a, loop, reverse);
+            if (s < 0) { return -1; }
+
+            d->nfa[loop].out = s;
+            return (node->type == NODE_STAR) ? loop : s;
+
+        case NODE_REPEAT:
+            s = next;
+            if (node->max == -1) {
+                loop = newState(d, NFA_SPLIT, -1, next, -1);
+                if (loop < 0) { return -1; }
+
+                s = compileNode(d, nodes, node->a, loop, reverse);
+                if (s < 0) { return -1; }
+
+                d->nfa[loop].out = s;
+                s = loop;
+            }
+
+            else {
+                for (int i = node->min; i < node->max && s >= 0; i++) {
+                    int body = compileNode(d, nodes, node->a, s, reverse);
+                    if (body < 0) { return -1; }
+                    s = newState(d, NFA_SPLIT, body, next, -1);
+                }
+            }
+
+            for (int i = 0; i < node->min && s >= 0; i++) {
+                s = compileNode(d, nodes, node->a, s, reverse);
+            }
+            return s;
+    }
+    return -1;
+}
+
+
+/*** lazy DFA ***/
+
+static int intCompare(const void *a, const void *b) {
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+    return (x > y) - (x < y);
+}
+
+
+static void closure(struct dfa *d, int s) {
+    int top = 0;
+    d->stack[top++] = s;
+
+    while (top) {
+        int x = d->stack[--top];
+        if (d->mark[x] == d->gen) { continue; }
+        d->mark[x] = d->gen;
+
+        if (d->nfa[x].type == NFA_SPLIT) {
+            d->stack[top++] = d->nfa[x].out1;
+            d->stack[top++] = d->nfa[x].out;
+        }
+        else {
+            d->work[d->workLen++] = x;
+        }
+    }
+}
+
+
+static unsigned int hashSet(int *set, int len) {
+    unsigned int h = 2166136261u;
+
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (unsigned int) set[i]) * 16777619u;
+    }
+    return h;
+}
+
+
+static void dfaFlush(struct dfa *d) {
+    d->states = 0;
+    d->poolLen = 0;
+    for (int i = 0; i < d->tableSize; i++) { d->table[i] = -1; }
+    d->start = -1;
+    d->flushes++;
+}
+
+
+/* Interns the subset in d->work, flushing the cache if it is full. */
+static int dfaAddState(struct dfa *d) {
+    qsort(d->work, d->workLen, sizeof(int), intCompare);
+
+    unsigned int h = hashSet(d->work, d->workLen);
+    unsigned int mask = d->tableSize - 1;
+
+    for (unsigned int i = h & mask; d->table[i] != -1; i = (i + 1) & mask) {
+        int s = d->table[i];
+        if (
+            d->setLen[s] == d->workLen
+            && !memcmp(&d->pool[d->setStart[s]], d->work, sizeof(int) * d->workLen)
+        ) {
+            return s;
+        }
+    }
+
+    if (d->states == DFA_MAX_STATES) {
+        dfaFlush(d);
+        return dfaAddState(d);
+    }
+
+    int classes = d->re->classes;
+    if (d->states == d->stateCap) {
+        d->stateCap = d->stateCap ? d->stateCap * 2 : 16;
+        d->trans = realloc(d->trans, sizeof(int) * classes * d->stateCap);
+        d->accept = realloc(d->accept, d->stateCap);
+        d->setStart = realloc(d->setStart, sizeof(int) * d->stateCap);
+        d->setLen = realloc(d->setLen, sizeof(int) * d->stateCap);
+        if (!d->trans || !d->accept || !d->setStart || !d->setLen) { die("realloc"); }
+    }
+
+    if (d->poolLen + d->workLen > d->poolCap) {
+        while (d->poolLen + d->workLen > d->poolCap) {
+            d->poolCap = d->poolCap ? d->poolCap * 2 : 256;
+        }
+        d->pool = realloc(d->pool, sizeof(int) * d->poolCap);
+        if (d->pool == NULL) { die("realloc"); }
+    }
+
+    int s = d->states++;
+    d->setStart[s] = d->poolLen;
+    d->setLen[s] = d->workLen;
+    memcpy(&d->pool[d->poolLen], d->work, sizeof(int) * d->workLen);
+    d->poolLen += d->workLen;
+
+    d->accept[s] = 0;
+    for (int i = 0; i < d->workLen; i++) {
+        if (d->nfa[d->work[i]].type == NFA_MATCH) { d->accept[s] = 1; }
+    }
+    for (int i = 0; i < classes; i++) { d->trans[s * classes + i] = DFA_UNKNOWN; }
+
+    unsigned int i = h & mask;
+    while (d->table[i] != -1) { i = (i + 1) & mask; }
+    d->table[i] = s;
+
+    return s;
+}
+
+
+static int dfaStart(struct dfa *d) {
+    if (d->start == -1) {
+        d->gen++;
+        d->workLen = 0;
+        closure(d, d->nfaStart);
+        d->start = dfaAddState(d);
+    }
+    return d->start;
+}
+
+
+static int dfaStep(struct dfa *d, int s, unsigned char c) {
+    int cls = d->re->byteClass[c];
+    int t = d->trans[s * d->re->classes + cls];
+    if (t != DFA_UNKNOWN) { return t; }
+
+    int b = d->re->classByte[cls];
+    d->gen++;
+    d->workLen = 0;
+
+    for (int i = 0; i < d->setLen[s]; i++) {
+        struct nfaState *x = &d->nfa[d->pool[d->setStart[s] + i]];
+        if (x->type == NFA_SET && setHas(d->re->sets[x->set], b)) {
+            closure(d, x->out);
+        }
+    }
+    if (d->unanchored) { closure(d, d->nfaStart); }
+
+    if (d->workLen == 0) {
+        t = DFA_DEAD;
+    }
+
+    else {
+        int before = d->states;
+        t = dfaAddState(d);
+        // a flush invalidated s, so there is nothing to cache it in
+        if (d->states < before) { return t; }
+    }
+
+    d->trans[s * d->re->classes + cls] = t;
+    return t;
+}
+
+
+static int dfaInit(struct dfa *d, struct regex *re, struct node *nodes, int root, int reverse) {
+    memset(d, 0, sizeof(*d));
+    d->re = re;
+
+    int match = newState(d, NFA_MATCH, -1, -1, -1);
+    d->nfaStart = compileNode(d, nodes, root, match, reverse);
+    if (d->nfaStart < 0) { return -1; }
+
+    d->tableSize = 1;
+    while (d->tableSize < DFA_MAX_STATES * 2) { d->tableSize *= 2; }
+    d->table = malloc(sizeof(int) * d->tableSize);
+
+    d->mark = calloc(d->nfaLen, sizeof(int));
+    d->stack = malloc(sizeof(int) * (d->nfaLen * 2 + 2));
+    d->work = malloc(sizeof(int) * d->nfaLen);
+    if (!d->table || !d->mark || !d->stack || !d->work) { die("malloc"); }
+
+    dfaFlush(d);
+    return 0;
+}
+
+
+static void dfaFree(struct dfa *d) {
+    free(d->nfa);
+    free(d->trans);
+    free(d->accept);
+    free(d->setStart);
+    free(d->setLen);
+    free(d->pool);
+    free(d->table);
+    free(d->mark);
+    free(d->stack);
+    free(d->work);
+}
+
+
+/* Splits the bytes into classes that every set treats identically. */
+static void computeByteClasses(struct regex *re) {
+    re->classes = 1;
+    re->byteClass[0] = 0;
+    re->classByte[0] = 0;
+
+    for (int c = 1; c < 256; c++) {
+        int differs = 0;
+        for (int s = 0; s < re->nsets && !differs; s++) {
+            differs = !setHas(re->sets[s], c) != !setHas(re->sets[s], c - 1);
+        }
+
+        if (differs) { re->classByte[re->classes++] = c; }
+        re->byteClass[c] = re->classes - 1;
+    }
+}
+
+
+struct regex *regexCompile(const char *pattern, const char **error) {
+    struct regex *re = calloc(1, sizeof(struct regex));
+    if (re == NULL) { die("calloc"); }
+
+    int len = strlen(pattern);
+    if (len && pattern[0] == '^') {
+        re->bol = 1;
+        pattern++;
+        len--;
+    }
+
+    int slashes = 0;
+    while (slashes < len - 1 && pattern[len - 2 - slashes] == '\\') { slashes++; }
+    if (len && pattern[len - 1] == '$' && slashes % 2 == 0) {
+        re->eol = 1;
+        len--;
+    }
+
+    char *body = strndup(pattern, len);
+    struct parser ps = {body, NULL, NULL, 0, 0, re};
+
+    int root = parseAlt(&ps);
+    if (!ps.error && *ps.p == ')') { ps.error = "unmatched )"; }
+
+    if (!ps.error) {
+        char run[REGEX_MAX_LITERAL];
+        int runLen = 0;
+        requiredLiteral(&ps, root, run, &runLen);
+        computeByteClasses(re);
+
+        // the reverse pass finds where matches start, the forward pass
+        // how far they run
+        if (
+            dfaInit(&re->forward, re, ps.nodes, root, 0) < 0
+            || dfaInit(&re->reverse, re, ps.nodes, root, 1) < 0
+        ) {
+            ps.error = "pattern too large";
+        }
+        re->reverse.unanchored = !re->eol;
+    }
+
+    free(ps.nodes);
+    free(body);
+
+    if (ps.error) {
+        if (error) { *error = ps.error; }
+        regexFree(re);
+        return NULL;
+    }
+    return re;
+}
+
+
+void regexFree(struct regex *re) {
+    if (re == NULL) { return; }
+
+    dfaFree(&re->forward);
+    dfaFree(&re->reverse);
+    free(re->sets);
+    free(re->starts);
+    free(re->seen);
+    free(re);
+}
+
+
+/*
+* End of the longest match starting at s, or -1. A run that gets to a
+* position in the same state as the last run did goes the same way from
+* there, so it stops and takes that run's end instead of scanning on.
+*/
+static int longestMatch(struct regex *re, const char *text, int len, int s) {
+    struct dfa *d = &re->forward;
+    int flushes = d->flushes;
+    int state = dfaStart(d);
+    int end = -1;
+
+    int i = s;
+    while (1) {
+        if (
+            i >= re->seenFrom && i < re->seenTo && re->seen[i] == state
+            && d->flushes == flushes
+        ) {
+            // an end the last run found from here is past any found so far
+            if (re->seenEnd >= i) { end = re->seenEnd; }
+            re->seenFrom = s;
+            re->seenEnd = end;
+            return end;
+        }
+
+        re->seen[i] = state;
+        if (d->accept[state] && (!re->eol || i == len)) { end = i; }
+        if (i == len) { break; }
+
+        state = dfaStep(d, state, text[i]);
+        if (state == DFA_DEAD) { break; }
+        i++;
+    }
+
+    re->seenFrom = s;
+    re->seenTo = (d->flushes == flushes) ? i + 1 : s;
+    re->seenEnd = end;
+    return end;
+}
+
+
+/*
+* Reports every leftmost-longest, non-overlapping, non-empty match in
+* text. One reverse pass marks every position a match can start at, then
+* the forward automaton measures each match. No backtracking happens, and
+* runs stop where they join the one before, so text past a match that
+* the last run already read is not read again.
+*/
+int regexFindAll(struct regex *re, const char *text, int len,
+    void (*emit)(int, int, void *), void *arg) {
+
+    if (re->literalLen && !memmem(text, len, re->literal, re->literalLen)) {
+        return 0;
+    }
+
+    if (len + 1 > re->startsCap) {
+        re->startsCap = len + 1;
+        re->starts = realloc(re->starts, re->startsCap);
+        re->seen = realloc(re->seen, sizeof(unsigned short) * re->startsCap);
+        if (re->starts == NULL || re->seen == NULL) { die("realloc"); }
+    }
+    memset(re->starts, 0, len + 1);
+    re->seenTo = 0;
+
+    struct dfa *d = &re->reverse;
+    int state = dfaStart(d);
+    re->starts[len] = d->accept[state];
+
+    for (int i = len - 1; i >= 0; i--) {
+        state = dfaStep(d, state, text[i]);
+        if (state == DFA_DEAD) { break; }
+        re->starts[i] = d->accept[state];
+    }
+
+    int found = 0;
+    int pos = 0;
+    while (pos < len) {
+        while (pos < len && !re->starts[pos]) { pos++; }
+        if (pos == len || (re->bol && pos != 0)) { break; }
+
+        int end = longestMatch(re, text, len, pos);
+        if (end > pos) {
+            emit(pos, end - pos, arg);
+            found++;
+            pos = end;
+        }
+        else {
+            if (re->bol) { break; }
+            pos++;
+        }
+    }
+    return found;
+}
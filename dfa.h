@@ -0,0 +1,18 @@
+/* Regular expression headers. */
+
+#ifndef DFA_H
+#define DFA_H
+
+struct regex;
+
+/*
+* Supported syntax: literals, ., [...] / [^...] classes, \d \w \s and
+* their negations, grouping with ( ), alternation |, the * + ? {n,m}
+* repetitions and ^ / $ anchors at the very start / end of the pattern.
+*/
+struct regex *regexCompile(const char *, const char **);
+void regexFree(struct regex *);
+int regexFindAll(struct regex *, const char *, int,
+    void (*emit)(int, int, void *), void *);
+
+#endif
@@ -0,0 +1,331 @@
+/* Code folding: runs of rows collapsed onto the row before them. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "fold.h"
+#include "wrap.h"
+#include "ops/rowops.h"
+
+
+/*
+* A fold shows its first row and hides the rest, up to its last. Folds are
+* kept sorted and never overlap: folding around existing folds takes them
+* in. Each also knows how many rows the folds before it hide, so mapping
+* between rows and the lines they are drawn on is a binary search over the
+* folds, never a walk over the rows they hide.
+*
+* Hidden rows have no render, column stops, wraps or highlighting: only
+* their characters are kept up to date, and the rest is built when their
+* fold opens. A row's render is NULL exactly while it is hidden.
+*/
+struct foldRange {
+    int start;
+    int end;
+    int hiddenBefore;
+};
+
+static struct {
+    struct foldRange *at;
+    int count;
+    int capacity;
+} FOLD = {NULL, 0, 0};
+
+
+/* Number of folds that start before row. */
+static int foldsBefore(int row) {
+    int lo = 0;
+    int hi = FOLD.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (FOLD.at[mid].start < row) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    return lo;
+}
+
+
+static void recount(int from) {
+    for (int i = from; i < FOLD.count; i++) {
+        FOLD.at[i].hiddenBefore = 0;
+        if (i == 0) { continue; }
+
+        struct foldRange *prev = &FOLD.at[i - 1];
+        FOLD.at[i].hiddenBefore = prev->hiddenBefore + prev->end - prev->start;
+    }
+}
+
+
+/* Columns of indentation a row starts with, or -1 if it is blank. */
+static int indentOf(editorRow *row) {
+    int col = 0;
+    for (int j = 0; j < row->rowSize; j++) {
+        char c = row->characters[j];
+        if (c == ' ') { col++; }
+        else if (c == '\t') { col += MOOSE_TAB_STOP - col % MOOSE_TAB_STOP; }
+        else { return col; }
+    }
+    return -1;
+}
+
+
+/*
+* The last of the rows after at that are indented deeper than it, blank
+* ones in between included. Returns at if there are none.
+*/
+static int indentEnd(int at) {
+    int base = indentOf(&CONFIG.row[at]);
+    if (base < 0) { return at; }
+
+    int end = at;
+    for (int j = at + 1; j < CONFIG.numRows; j++) {
+        int indent = indentOf(&CONFIG.row[j]);
+        if (indent < 0) { continue; }
+        if (indent <= base) { break; }
+        end = j;
+    }
+    return end;
+}
+
+
+/*
+* If row at ends by opening a bracket, the row that closes it, counting
+* brackets of that kind only. Returns at if it doesn't, or if it never
+* closes.
+*/
+static int braceEnd(int at) {
+    static const char OPEN[] = "{[(";
+    static const char CLOSE[] = "}])";
+
+    editorRow *row = &CONFIG.row[at];
+    int j = row->rowSize;
+    while (j > 0 && isspace((unsigned char) row->characters[j - 1])) { j--; }
+    if (j == 0 || row->characters[j - 1] == '\0') { return at; }
+
+    const char *open = strchr(OPEN, row->characters[j - 1]);
+    if (open == NULL) { return at; }
+    char opener = *open;
+    char closer = CLOSE[open - OPEN];
+
+    int depth = 1;
+    for (int r = at + 1; r < CONFIG.numRows; r++) {
+        editorRow *cur = &CONFIG.row[r];
+        for (int k = 0; k < cur->rowSize; k++) {
+            if (cur->characters[k] == opener) { depth++; }
+            else if (cur->characters[k] == closer && --depth == 0) { return r; }
+        }
+    }
+    return at;
+}
+
+
+/* Hides rows (start, end], taking in the folds already there. */
+static int foldRows(int start, int end) {
+    int i = foldsBefore(start + 1);
+    int j = i;
+    while (j < FOLD.count && FOLD.at[j].start <= end) {
+        if (FOLD.at[j].end > end) { end = FOLD.at[j].end; }
+        j++;
+    }
+
+    if (FOLD.count + 1 > FOLD.capacity) {
+        FOLD.capacity = FOLD.capacity ? FOLD.capacity * 2 : 16;
+        FOLD.at = realloc(FOLD.at, sizeof(struct foldRange) * FOLD.capacity);
+        if (FOLD.at == NULL) { die("realloc"); }
+    }
+    memmove(&FOLD.at[i + 1], &FOLD.at[j], sizeof(struct foldRange) * (FOLD.count - j));
+    FOLD.count += 1 - (j - i);
+    FOLD.at[i].start = start;
+    FOLD.at[i].end = end;
+    recount(i);
+
+    for (int r = start + 1; r <= end; r++) {
+        if (CONFIG.row[r].render) { editorHideRow(&CONFIG.row[r]); }
+    }
+    wrapRowsMoved();
+    return end - start;
+}
+
+
+/* Opens fold i, rendering the rows it hid. */
+static void unfold(int i) {
+    struct foldRange fold = FOLD.at[i];
+    memmove(&FOLD.at[i], &FOLD.at[i + 1], sizeof(struct foldRange) * (FOLD.count - i - 1));
+    FOLD.count--;
+    recount(i);
+
+    // the rows go from no lines to some, which the wrap tree can't take in place
+    wrapRowsMoved();
+    editorBeginBatch();
+    for (int r = fold.start + 1; r <= fold.end; r++) { editorUpdateRow(&CONFIG.row[r]); }
+    editorEndBatch();
+}
+
+
+/*
+* Folds the rows that belong to row: up to the bracket it opens, if it
+* ends by opening one, and otherwise those indented deeper below it. On
+* the first row of a fold, opens it instead. Returns how many rows it hid,
+* 0 if there was nothing to fold, or -1 if it opened a fold.
+*/
+int foldToggle(int row) {
+    if (row < 0 || row >= CONFIG.numRows || foldHidden(row)) { return 0; }
+
+    int i = foldsBefore(row + 1);
+    if (i > 0 && FOLD.at[i - 1].start == row) {
+        unfold(i - 1);
+        return -1;
+    }
+
+    int end = braceEnd(row);
+    if (end == row) { end = indentEnd(row); }
+    if (end == row) { return 0; }
+    return foldRows(row, end);
+}
+
+
+/*
+* Opens every fold, rendering what they hid in one batch. Returns how many
+* there were.
+*/
+int foldOpenAll() {
+    int count = FOLD.count;
+    FOLD.count = 0;
+
+    wrapRowsMoved();
+    editorBeginBatch();
+    for (int i = 0; i < count; i++) {
+        for (int r = FOLD.at[i].start + 1; r <= FOLD.at[i].end; r++) { editorUpdateRow(&CONFIG.row[r]); }
+    }
+    editorEndBatch();
+    return count;
+}
+
+
+/* Opens the fold hiding row, if there is one. */
+void foldReveal(int row) {
+    int i = foldsBefore(row);
+    if (i > 0 && row <= FOLD.at[i - 1].end) { unfold(i - 1); }
+}
+
+
+int foldHidden(int row) {
+    int i = foldsBefore(row);
+    return i > 0 && row <= FOLD.at[i - 1].end;
+}
+
+
+/* The last row that row stands for on screen: itself, unless it heads a fold. */
+int foldLast(int row) {
+    int i = foldsBefore(row + 1);
+    if (i > 0 && FOLD.at[i - 1].start == row) { return FOLD.at[i - 1].end; }
+    return row;
+}
+
+
+/* The row shown after row. */
+int foldNext(int row) {
+    return foldLast(row) + 1;
+}
+
+
+/* The row shown before row, or -1. */
+int foldPrev(int row) {
+    int prev = row - 1;
+    int i = foldsBefore(prev);
+    if (i > 0 && prev <= FOLD.at[i - 1].end) { return FOLD.at[i - 1].start; }
+    return prev;
+}
+
+
+/* The line row is drawn on, counted from the top of the buffer. */
+int foldLineOf(int row) {
+    int i = foldsBefore(row);
+    if (i == 0) { return row; }
+
+    struct foldRange *fold = &FOLD.at[i - 1];
+    // a hidden row is where its fold is
+    if (row <= fold->end) { return fold->start - fold->hiddenBefore; }
+    return row - fold->hiddenBefore - (fold->end - fold->start);
+}
+
+
+/* The row drawn on line; lines past the last row give rows past numRows. */
+int foldRowAt(int line) {
+    int lo = 0;
+    int hi = FOLD.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (FOLD.at[mid].start - FOLD.at[mid].hiddenBefore < line) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    if (lo == 0) { return line; }
+
+    struct foldRange *fold = &FOLD.at[lo - 1];
+    return line + fold->hiddenBefore + fold->end - fold->start;
+}
+
+
+/* The row drawn lines below row. */
+int foldRowsDown(int row, int lines) {
+    return foldRowAt(foldLineOf(row) + lines);
+}
+
+
+/*
+* Moves the folds along for count rows inserted at at. A fold they land
+* inside is dropped; its rows, in [first, last] now, still need rendering.
+* Returns whether that happened.
+*/
+int foldRowsInserted(int at, int count, int *first, int *last) {
+    int i = foldsBefore(at);
+    int exposed = 0;
+
+    if (i > 0 && at <= FOLD.at[i - 1].end) {
+        *first = FOLD.at[i - 1].start;
+        *last = FOLD.at[i - 1].end + count;
+        memmove(&FOLD.at[i - 1], &FOLD.at[i], sizeof(struct foldRange) * (FOLD.count - i));
+        FOLD.count--;
+        i--;
+        exposed = 1;
+    }
+
+    for (int j = i; j < FOLD.count; j++) {
+        FOLD.at[j].start += count;
+        FOLD.at[j].end += count;
+    }
+    recount(i);
+    return exposed;
+}
+
+
+/*
+* Moves the folds along for count rows removed at at. Folds that lost any
+* rows are dropped; what is left of them, in [first, last] now, still
+* needs rendering. Returns whether that happened.
+*/
+int foldRowsRemoved(int at, int count, int *first, int *last) {
+    int stop = at + count;
+    int i = foldsBefore(at);
+    if (i > 0 && FOLD.at[i - 1].end >= at) { i--; }
+
+    int j = i;
+    while (j < FOLD.count && FOLD.at[j].start < stop) { j++; }
+
+    int exposed = (j > i);
+    if (exposed) {
+        *first = (FOLD.at[i].start < at) ? FOLD.at[i].start : at;
+        *last = (FOLD.at[j - 1].end >= stop) ? FOLD.at[j - 1].end - count : at - 1;
+        memmove(&FOLD.at[i], &FOLD.at[j], sizeof(struct foldRange) * (FOLD.count - j));
+        FOLD.count -= j - i;
+    }
+
+    for (int k = i; k < FOLD.count; k++) {
+        FOLD.at[k].start -= count;
+        FOLD.at[k].end -= count;
+    }
+    recount(i);
+    return exposed;
+}
@@ -0,0 +1,21 @@
+/* Code folding headers. */
+
+#ifndef FOLD_H
+#define FOLD_H
+
+int foldToggle(int);
+int foldOpenAll();
+void foldReveal(int);
+
+int foldHidden(int);
+int foldLast(int);
+int foldNext(int);
+int foldPrev(int);
+int foldLineOf(int);
+int foldRowAt(int);
+int foldRowsDown(int, int);
+
+int foldRowsInserted(int, int, int *, int *);
+int foldRowsRemoved(int, int, int *, int *);
+
+#endif
@@ -1,11 +1,20 @@
 /* Text Highlighting. */
 
 #include <ctype.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "brackets.h"
 #include "core.h"
+#include "fold.h"
 #include "highlight.h"
+#include "perf.h"
+#include "threadpool.h"
+#include "words.h"
 
 char *c_hl_extensions[] = {".c", ".h", ".cpp", NULL};
 char *c_hl_keywords[] = {
@@ -22,82 +31,336 @@ struct editorSyntax HLDB[] = {
         c_hl_extensions,
         c_hl_keywords,
         HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
+        NULL,
     }
 };
 
+#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+
+#define HIGHLIGHT_EAGER_ROWS 1024  // stale rows worth catching up on before a draw
+#define HIGHLIGHT_SLICE_ROWS 512   // rows the worker highlights between checks
+#define HIGHLIGHT_CHUNK_ROWS 4096  // smallest unit of a parallel pass
+#define HIGHLIGHT_PARALLEL_ROWS (8 * HIGHLIGHT_CHUNK_ROWS)
+
+
+/* Bits of the per-syntax character class table. */
+enum CHAR_CLASSES {
+    CC_SEPARATOR = 1 << 0,
+    CC_DIGIT = 1 << 1,
+    CC_QUOTE = 1 << 2,     // starts a string, if the syntax has strings
+    CC_COMMENT = 1 << 3,   // first byte of a comment start marker
+};
+
+#define CC_BREAK (CC_SEPARATOR | CC_QUOTE | CC_COMMENT)
+
 
 static int is_separator(int c) {
     return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
 }
 
 
-void updateSyntax(editorRow *row) {
-    row->highlight = realloc(row->highlight, row->renderSize);
-    memset(row->highlight, HL_NORMAL, row->renderSize);
+static unsigned int keywordHash(const char *s, int len) {
+    unsigned int h = 2166136261u;
 
-    if (CONFIG.syntax == NULL) { return; }
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (unsigned char) s[i]) * 16777619u;
+    }
+    return h;
+}
 
-    char **keywords = CONFIG.syntax->keywords;
 
-    char *scs = CONFIG.syntax->singleline_comment_start;
-    char *mcs = CONFIG.syntax->multiline_comment_start;
-    char *mce = CONFIG.syntax->multiline_comment_end;
+static void compileKeywords(struct compiledSyntax *cs, char **keywords) {
+    int count = 0;
+    int text = 0;
+    while (keywords[count]) { text += strlen(keywords[count++]); }
 
-    int scs_len = scs ? strlen(scs) : 0;
-    int mcs_len = mcs ? strlen(mcs) : 0;
-    int mce_len = mce ? strlen(mce) : 0;
+    unsigned int size = 8;
+    while (size < (unsigned int) count * 2) { size *= 2; }
 
-    int prev_sep = 1;
-    int in_string = 0;
-    int in_comment = (
-        row->index > 0 && CONFIG.row[row->index - 1].highlight_open_comment
-    );
+    struct keywordSlot *slots = calloc(size, sizeof(struct keywordSlot));
+    char *words = malloc(text + 1);
+    if (slots == NULL || words == NULL) { die("malloc"); }
 
-    int i = 0;
-    while (i < row->renderSize) {
-        char c = row->render[i];
-        unsigned char prev_hl = (i > 0) ? row->highlight[i - 1]: HL_NORMAL;
+    unsigned int mask = size - 1;
+    int wordsLen = 0;
 
-        if (scs_len && !in_string && !in_comment) {
-            if (!strncmp(&row->render[i], scs, scs_len)) {
-                memset(&row->highlight[i], HL_COMMENT, row->renderSize - i);
+    for (int j = 0; j < count; j++) {
+        int klen = strlen(keywords[j]);
+        int kw2 = klen && keywords[j][klen - 1] == '|';
+        if (kw2) { klen--; }
+        if (klen == 0 || klen > 0xffff) { continue; }
+
+        unsigned int i = keywordHash(keywords[j], klen) & mask;
+        while (slots[i].len) {
+            // the first spelling of a duplicate wins, as with a linear scan
+            if (slots[i].len == klen && !memcmp(&words[slots[i].word], keywords[j], klen)) {
                 break;
             }
+            i = (i + 1) & mask;
         }
+        if (slots[i].len) { continue; }
 
-        if (mcs_len && mce_len && !in_string) {
-            if (in_comment) {
-                row->highlight[i] = HL_MLCOMMENT;
+        memcpy(&words[wordsLen], keywords[j], klen);
+        slots[i].word = wordsLen;
+        slots[i].len = klen;
+        slots[i].hl = kw2 ? HL_KEYWORDS2 : HL_KEYWORDS1;
+        wordsLen += klen;
 
-                if (!strncmp(&row->render[i], mce, mce_len)) {
-                    memset(&row->highlight[i], HL_MLCOMMENT, mce_len);
+        if (cs->minLen == 0 || klen < cs->minLen) { cs->minLen = klen; }
+        if (klen > cs->maxLen) { cs->maxLen = klen; }
+    }
 
-                    i += mce_len;
-                    in_comment = 0;
-                    prev_sep = 1;
-                    continue;
-                }
+    cs->slots = slots;
+    cs->words = words;
+    cs->wordsLen = wordsLen;
+    cs->mask = mask;
+}
 
-                else {
-                    i++;
-                    continue;
-                }
+
+/*
+* Builds the lookup form of a syntax. It holds no pointers into the
+* syntax itself, so the syntax cache can store it as it is.
+*/
+struct compiledSyntax *compileSyntax(struct editorSyntax *s) {
+    struct compiledSyntax *cs = calloc(1, sizeof(struct compiledSyntax));
+    unsigned char *classes = calloc(256, 1);
+    if (cs == NULL || classes == NULL) { die("calloc"); }
+    cs->classes = classes;
+
+    char *scs = s->singleline_comment_start;
+    char *mcs = s->multiline_comment_start;
+    char *mce = s->multiline_comment_end;
+
+    cs->scsLen = scs ? strlen(scs) : 0;
+    cs->mcsLen = mcs ? strlen(mcs) : 0;
+    cs->mceLen = mce ? strlen(mce) : 0;
+    // a multi-line comment needs both markers to exist at all
+    if (!cs->mcsLen || !cs->mceLen) {
+        cs->mcsLen = 0;
+        cs->mceLen = 0;
+    }
+
+    for (int c = 0; c < 256; c++) {
+        // classify the byte the way a (signed) char reaches is_separator
+        signed char sc = (signed char) c;
+
+        if (is_separator(sc)) { classes[c] |= CC_SEPARATOR; }
+        if (c >= '0' && c <= '9') { classes[c] |= CC_DIGIT; }
+        if ((s->flags & HL_HIGHLIGHT_STRINGS) && (c == '"' || c == '\'')) {
+            classes[c] |= CC_QUOTE;
+        }
+    }
+    if (cs->scsLen) { classes[(unsigned char) scs[0]] |= CC_COMMENT; }
+    if (cs->mcsLen) { classes[(unsigned char) mcs[0]] |= CC_COMMENT; }
+
+    compileKeywords(cs, s->keywords);
+    return cs;
+}
+
+
+/*
+* Looks up the word starting at s; a keyword only matches a whole word, so
+* the word is measured first (never further than the longest keyword).
+* Returns the keyword's length and class, or 0 if it isn't one.
+*/
+static int matchKeyword(struct compiledSyntax *cs, const char *s, int avail, int *hl) {
+    int len = 0;
+    while (
+        len < avail && len <= cs->maxLen
+        && !(cs->classes[(unsigned char) s[len]] & CC_SEPARATOR)
+    ) {
+        len++;
+    }
+
+    if (len < cs->minLen || len > cs->maxLen) { return 0; }
+
+    unsigned int i = keywordHash(s, len) & cs->mask;
+    while (cs->slots[i].len) {
+        const struct keywordSlot *slot = &cs->slots[i];
+
+        if (slot->len == len && !memcmp(&cs->words[slot->word], s, len)) {
+            *hl = slot->hl;
+            return len;
+        }
+        i = (i + 1) & cs->mask;
+    }
+    return 0;
+}
+
+
+/*
+* A lexer's scratch space, one class per render byte and the checkpoints
+* taken along the way; rows only keep the run-length encoded result.
+* Every thread highlighting rows needs its own.
+*/
+struct lexBuffer {
+    unsigned char *hl;
+    highlightSpan *spans;
+    int capacity;
+
+    struct lexCheckpoint *cps;
+    int numCps;
+    int cpCapacity;
+};
+
+#define LEXBUFFER_INIT {NULL, NULL, 0, NULL, 0, 0}
+
+static struct lexBuffer LEX = LEXBUFFER_INIT;
+
+
+static void lexBufferFree(struct lexBuffer *buf) {
+    free(buf->hl);
+    free(buf->spans);
+    free(buf->cps);
+}
+
+
+/*
+* A lex of a long row takes a checkpoint every so often. One that lexes
+* an edit again may also stop at any old checkpoint past the edit (moved
+* along by shift) that it reaches in the state it had there, as the rest
+* of the row would come out just as it did before.
+*/
+struct lexRun {
+    int from;   // render column the lex starts at
+    int every;  // 0 for no checkpoints
+    int last;   // column of the last checkpoint taken
+    struct lexBuffer *buf;
+
+    const struct lexCheckpoint *old;
+    int numOld;
+    int target;  // next old checkpoint to stop at
+    int shift;
+};
+
+
+/* Column, relative to the start of the lex, of the next call to lexCheck. */
+static int lexNext(struct lexRun *run) {
+    int next = run->every ? run->last + run->every : INT_MAX;
+
+    if (run->target < run->numOld && run->old[run->target].rx + run->shift < next) {
+        next = run->old[run->target].rx + run->shift;
+    }
+    return (next == INT_MAX) ? INT_MAX : next - run->from;
+}
+
+
+/*
+* Called at the top of the lexer's loop once it reaches the column
+* lexNext gave. Takes a checkpoint if one is due, and returns 1 if the
+* lex can stop here instead.
+*/
+static int lexCheck(struct lexRun *run, int i, const struct lexState *state) {
+    int rx = run->from + i;
+
+    while (run->target < run->numOld && run->old[run->target].rx + run->shift < rx) {
+        run->target++;
+    }
+    if (run->target < run->numOld && run->old[run->target].rx + run->shift == rx) {
+        if (!memcmp(&run->old[run->target].state, state, sizeof(*state))) { return 1; }
+        run->target++;
+    }
+
+    if (run->every && rx >= run->last + run->every) {
+        struct lexBuffer *buf = run->buf;
+        if (buf->numCps == buf->cpCapacity) {
+            buf->cpCapacity = buf->cpCapacity ? buf->cpCapacity * 2 : 64;
+            buf->cps = realloc(buf->cps, sizeof(struct lexCheckpoint) * buf->cpCapacity);
+            if (buf->cps == NULL) { die("realloc"); }
+        }
+
+        struct lexCheckpoint *cp = &buf->cps[buf->numCps++];
+        cp->rx = rx;
+        cp->state = *state;
+        run->last = rx;
+    }
+    return 0;
+}
+
+
+/*
+* Lexes size bytes of render into hl, one class per byte, starting in
+* state and leaving the state it ends in there. Returns how far it got,
+* which is short of size only if run let it stop early.
+*
+* The lexer is driven by the syntax's class table: only bytes that can
+* change state are looked at individually, while comment bodies, string
+* bodies and the rest of a word are skipped over as whole runs. A run
+* never goes past the next column run wants to see.
+*/
+static int lexRange(const char *render, int size, struct lexState *state, unsigned char *hl, struct lexRun *run) {
+    int next = lexNext(run);
+    int limit = (next < size) ? next : size;
+    int i = 0;
+
+    if (CONFIG.syntax == NULL) {
+        while (i < size) {
+            if (i >= next) {
+                if (lexCheck(run, i, state)) { return i; }
+                next = lexNext(run);
+                limit = (next < size) ? next : size;
             }
+            memset(&hl[i], HL_NORMAL, limit - i);
+            i = limit;
+        }
+        return size;
+    }
 
-            else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-                memset(&row->highlight[i], HL_MLCOMMENT, mcs_len);
-                i += mcs_len;
-                in_comment = 1;
+    struct compiledSyntax *cs = CONFIG.syntax->compiled;
+    const unsigned char *classes = cs->classes;
+    int numbers = CONFIG.syntax->flags & HL_HIGHLIGHT_NUMBERS;
+
+    char *mcs = CONFIG.syntax->multiline_comment_start;
+    char *mce = CONFIG.syntax->multiline_comment_end;
+
+    int prev_sep = state->prev_sep;
+    int in_string = state->in_string;
+    int in_comment = state->in_comment;
+    int entry_hl = state->prev_hl;
+
+    // whatever nothing else claims is plain, up to the next column run wants
+    memset(hl, HL_NORMAL, limit);
+
+    while (1) {
+        while (i < limit) {
+            if (in_comment) {
+                const char *end = memchr(&render[i], mce[0], limit - i);
+                int stop = end ? end - render : limit;
+
+                memset(&hl[i], HL_MLCOMMENT, stop - i);
+                i = stop;
+
+                if (end) {
+                    if (!strncmp(&render[i], mce, cs->mceLen)) {
+                        memset(&hl[i], HL_MLCOMMENT, cs->mceLen);
+                        i += cs->mceLen;
+                        in_comment = 0;
+                        prev_sep = 1;
+                    }
+                    else {
+                        hl[i++] = HL_MLCOMMENT;
+                    }
+                }
                 continue;
             }
-        }
 
-        if (CONFIG.syntax->flags & HL_HIGHLIGHT_STRINGS) {
+            unsigned char c = render[i];
+
             if (in_string) {
-                row->highlight[i] = HL_STRING;
+                int stop = i;
+                while (stop < limit && render[stop] != in_string && render[stop] != '\\') {
+                    stop++;
+                }
+                memset(&hl[i], HL_STRING, stop - i);
+                if (stop > i) { prev_sep = 1; }
+                i = stop;
+                if (i == limit) { continue; }
 
-                if (c == '\\' && i + 1 < row->renderSize) {
-                    row->highlight[i + 1] = HL_STRING;
+                c = render[i];
+                hl[i] = HL_STRING;
+
+                if (c == '\\' && i + 1 < size) {
+                    hl[i + 1] = HL_STRING;
                     i += 2;
                     continue;
                 }
@@ -108,65 +371,693 @@ void updateSyntax(editorRow *row) {
                 continue;
             }
 
-            else {
-                if (c == '"' || c == '\'') {
-                    in_string = c;
-                    row->highlight[i] = HL_STRING;
-                    i++;
+            int k = classes[c];
+
+            if (k & CC_COMMENT) {
+                if (cs->scsLen && !strncmp(&render[i], CONFIG.syntax->singleline_comment_start, cs->scsLen)) {
+                    memset(&hl[i], HL_COMMENT, size - i);
+                    i = size;
+                    break;
+                }
+
+                if (cs->mcsLen && !strncmp(&render[i], mcs, cs->mcsLen)) {
+                    memset(&hl[i], HL_MLCOMMENT, cs->mcsLen);
+                    i += cs->mcsLen;
+                    in_comment = 1;
                     continue;
                 }
             }
-        }
-
-        if (CONFIG.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
 
-            if (
-                (isdigit(c) && (prev_sep || prev_hl == HL_NUMBER))
-                || (c == '.' && prev_hl == HL_NUMBER)
-            ) {
-                row->highlight[i] = HL_NUMBER;
-                i++;
-                prev_sep = 0;
+            if (k & CC_QUOTE) {
+                in_string = c;
+                hl[i++] = HL_STRING;
                 continue;
             }
-        }
-
-        if (prev_sep) {
-            int j;
-            for (j = 0; keywords[j]; j++) {
-                int klen = strlen(keywords[j]);
-                int kw2 = keywords[j][klen - 1] == '|';
 
-                if (kw2) { klen--; }
+            if (numbers) {
+                unsigned char prev_hl = (i > 0) ? hl[i - 1] : entry_hl;
 
                 if (
-                    !strncmp(&row->render[i], keywords[j], klen)
-                    && is_separator(row->render[i + klen])
+                    ((k & CC_DIGIT) && (prev_sep || prev_hl == HL_NUMBER))
+                    || (c == '.' && prev_hl == HL_NUMBER)
                 ) {
-                    memset(
-                        &row->highlight[i],
-                        kw2 ? HL_KEYWORDS2 : HL_KEYWORDS1, klen
-                    );
+                    hl[i++] = HL_NUMBER;
+                    prev_sep = 0;
+                    continue;
+                }
+            }
+
+            if (prev_sep) {
+                int kwhl;
+                int klen = matchKeyword(cs, &render[i], size - i, &kwhl);
+
+                if (klen) {
+                    memset(&hl[i], kwhl, klen);
                     i += klen;
-                    break;
+                    prev_sep = 0;
+                    continue;
                 }
             }
 
-            if (keywords[j] != NULL) {
-                prev_sep = 0;
-                continue;
+            prev_sep = k & CC_SEPARATOR;
+            i++;
+
+            // nothing inside the rest of a word can change state
+            if (!prev_sep) {
+                while (i < limit && !(classes[(unsigned char) render[i]] & CC_BREAK)) {
+                    i++;
+                }
             }
         }
+        if (i >= size) { break; }
+
+        // past limit, so at or past the next column run wants
+        struct lexState now = {in_comment, in_string, prev_sep, (i > 0) ? hl[i - 1] : entry_hl};
+        if (lexCheck(run, i, &now)) {
+            *state = now;
+            return i;
+        }
+        next = lexNext(run);
+        limit = (next < size) ? next : size;
+        if (limit > i) { memset(&hl[i], HL_NORMAL, limit - i); }
+    }
+
+    state->in_comment = in_comment;
+    state->in_string = in_string;
+    state->prev_sep = prev_sep;
+    state->prev_hl = (i > 0) ? hl[i - 1] : entry_hl;
+    return i;
+}
+
 
-        prev_sep = is_separator(c);
-        i++;
+/*
+* How far past the column it is at the lexer may look ahead, at most: a
+* byte that changed can make a difference to the lex that far back.
+*/
+static int lexReach() {
+    if (CONFIG.syntax == NULL) { return 0; }
+
+    struct compiledSyntax *cs = CONFIG.syntax->compiled;
+    return cs->maxLen + cs->scsLen + cs->mcsLen + cs->mceLen + 2;
+}
+
+
+static void lexReserve(struct lexBuffer *buf, int size) {
+    if (buf->capacity < size) {
+        buf->capacity = size * 2;
+        buf->hl = realloc(buf->hl, buf->capacity);
+        buf->spans = realloc(buf->spans, sizeof(highlightSpan) * buf->capacity);
+        if (buf->hl == NULL || buf->spans == NULL) { die("realloc"); }
     }
+}
 
-    int changed = (row->highlight_open_comment != in_comment);
-    row->highlight_open_comment = in_comment;
-    if (changed && row->index + 1 < CONFIG.numRows) {
-        updateSyntax(&CONFIG.row[row->index + 1]);
+
+/*
+* Run-length encodes len classes into spans, returning how many it took,
+* and notes which span each checkpoint's byte fell in. The classes start
+* at render column origin.
+*/
+static int encodeSpans(const unsigned char *hl, int len, highlightSpan *spans, struct lexCheckpoint *cps, int numCps, int origin) {
+    int count = 0;
+    int cp = 0;
+
+    for (int i = 0; i < len; ) {
+        int start = i++;
+        while (i < len && hl[i] == hl[start] && i - start < HL_SPAN_MAX_LEN) { i++; }
+
+        for (; cp < numCps && cps[cp].rx - origin < i; cp++) {
+            cps[cp].span = count;
+            cps[cp].spanOffset = cps[cp].rx - origin - start;
+        }
+        spans[count++] = ((i - start) << HL_SPAN_BITS) | hl[start];
     }
+    return count;
+}
+
+
+static struct lexIndex *newLexIndex(int count) {
+    struct lexIndex *lex = malloc(sizeof(struct lexIndex) + sizeof(struct lexCheckpoint) * count);
+    if (lex == NULL) { die("malloc"); }
+
+    lex->editFrom = -1;
+    lex->count = count;
+    return lex;
+}
+
+
+/* Lexes a whole row, entering it in state. Returns the state it leaves. */
+static struct lexState lexRow(editorRow *row, struct lexState state, struct lexBuffer *buf) {
+    lexReserve(buf, row->renderSize);
+
+    struct lexRun run = {0};
+    run.every = (row->renderSize >= MOOSE_LONG_ROW) ? MOOSE_LEX_CHECKPOINT : 0;
+    run.last = -MOOSE_LEX_CHECKPOINT;
+    run.buf = buf;
+    buf->numCps = 0;
+
+    lexRange(row->render, row->renderSize, &state, buf->hl, &run);
+    bracketsFromLex(row, row->render, buf->hl, row->renderSize);
+
+    int count = encodeSpans(buf->hl, row->renderSize, buf->spans, buf->cps, buf->numCps, 0);
+    if (count != row->highlightSpans || row->highlight == NULL) {
+        row->highlight = realloc(row->highlight, sizeof(highlightSpan) * (count ? count : 1));
+        if (row->highlight == NULL) { die("realloc"); }
+        row->highlightSpans = count;
+    }
+    // an empty row leaves the span buffer unallocated
+    if (count) { memcpy(row->highlight, buf->spans, sizeof(highlightSpan) * count); }
+
+    free(row->lex);
+    row->lex = NULL;
+    if (buf->numCps) {
+        row->lex = newLexIndex(buf->numCps);
+        memcpy(row->lex->at, buf->cps, sizeof(struct lexCheckpoint) * buf->numCps);
+    }
+
+    return state;
+}
+
+
+/*
+* Lexes the part of a long row an edit changed again, from the last
+* checkpoint the edit can't have made a difference to. Once the lex
+* reaches an old checkpoint in the state it had there it stops, and the
+* new spans and checkpoints are spliced in between the old ones. Returns
+* the state the row leaves, which only a lex to the end can change.
+*/
+static struct lexState lexEdit(editorRow *row, struct lexBuffer *buf) {
+    struct lexIndex *lex = row->lex;
+    const struct lexCheckpoint *old = lex->at;
+    int numOld = lex->count;
+    int shift = lex->editNewEnd - lex->editOldEnd;
+
+    // the last checkpoint far enough before the edit, the first one is always fine
+    int reach = lexReach();
+    int lo = 1;
+    int hi = numOld;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (old[mid].rx + reach <= lex->editFrom) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    int k = lo - 1;
+    int from = old[k].rx;
+
+    struct lexRun run = {0};
+    run.from = from;
+    run.every = MOOSE_LEX_CHECKPOINT;
+    run.last = from;
+    run.buf = buf;
+    run.old = old;
+    run.numOld = numOld;
+    run.shift = shift;
+    buf->numCps = 0;
+
+    // an old checkpoint inside the edit is no longer valid
+    run.target = k + 1;
+    while (run.target < numOld && old[run.target].rx < lex->editOldEnd) { run.target++; }
+
+    lexReserve(buf, row->renderSize - from);
+    struct lexState state = old[k].state;
+    int len = lexRange(&row->render[from], row->renderSize - from, &state, buf->hl, &run);
+    int synced = (from + len < row->renderSize);
+    bracketsFromEdit(row, from, buf->hl, len, synced);
+
+    int count = encodeSpans(buf->hl, len, buf->spans, buf->cps, buf->numCps, from);
+
+    // spans up to the resumed checkpoint, the new ones, and the old from where it stopped
+    highlightSpan *spans = row->highlight;
+    int n = row->highlightSpans;
+    int sk = old[k].span;
+    int before = sk + (old[k].spanOffset > 0);
+    highlightSpan first = spans[sk];
+
+    int sj = synced ? old[run.target].span : n;
+    int after = n - sj;
+    highlightSpan rest = synced ? spans[sj] : 0;
+    int restOffset = synced ? old[run.target].spanOffset : 0;
+
+    int total = before + count + after;
+    if (total > n) {
+        spans = realloc(spans, sizeof(highlightSpan) * total);
+        if (spans == NULL) { die("realloc"); }
+    }
+    if (after > 1) {
+        memmove(&spans[before + count + 1], &spans[sj + 1], sizeof(highlightSpan) * (after - 1));
+    }
+    if (after) {
+        int restLen = HL_SPAN_LEN(rest) - restOffset;
+        spans[before + count] = (restLen << HL_SPAN_BITS) | HL_SPAN_CLASS(rest);
+    }
+    if (old[k].spanOffset > 0) {
+        spans[sk] = (old[k].spanOffset << HL_SPAN_BITS) | HL_SPAN_CLASS(first);
+    }
+    memcpy(&spans[before], buf->spans, sizeof(highlightSpan) * count);
+    row->highlight = spans;
+    row->highlightSpans = total;
+
+    // and the checkpoints likewise
+    int keptAfter = synced ? numOld - run.target : 0;
+    row->lex = newLexIndex(k + 1 + buf->numCps + keptAfter);
+    struct lexCheckpoint *cps = row->lex->at;
+
+    memcpy(cps, old, sizeof(struct lexCheckpoint) * (k + 1));
+    cps[k].span = before;
+    cps[k].spanOffset = 0;
+    for (int c = 0; c < buf->numCps; c++) {
+        cps[k + 1 + c] = buf->cps[c];
+        cps[k + 1 + c].span += before;
+    }
+    for (int c = 0; c < keptAfter; c++) {
+        struct lexCheckpoint *cp = &cps[k + 1 + buf->numCps + c];
+        *cp = old[run.target + c];
+        if (cp->span == sj) { cp->spanOffset -= restOffset; }
+        cp->span += before + count - sj;
+        cp->rx += shift;
+    }
+
+    free(lex);
+
+    if (synced) { state.in_comment = row->highlight_open_comment; }
+    return state;
+}
+
+
+/*
+* A row hidden in a fold keeps no highlighting, but the rows below still
+* need the comment state it leaves, and bracket matching its brackets, so
+* its characters are lexed for those alone. They only differ from a render
+* in tabs, which lex as the spaces they render to would.
+*/
+static struct lexState lexHidden(editorRow *row, struct lexState state, struct lexBuffer *buf) {
+    lexReserve(buf, row->rowSize);
+    struct lexRun run = {0};
+    lexRange(row->characters, row->rowSize, &state, buf->hl, &run);
+    bracketsFromLex(row, row->characters, buf->hl, row->rowSize);
+    return state;
+}
+
+
+/*
+* Highlights a single row, entering it inside a comment or not. Returns 1
+* if the state this row leaves open changed, meaning the next row needs
+* highlighting again too.
+*
+* A long row that was lexed entering the same state only needs what its
+* edit changed lexed again, if anything.
+*/
+static int highlightRowFrom(editorRow *row, int entry_comment, struct lexBuffer *buf) {
+    struct lexState entry = {0, 0, 1, HL_NORMAL};
+    entry.in_comment = CONFIG.syntax && CONFIG.syntax->compiled->mcsLen && entry_comment;
+
+    struct lexState state = entry;
+    if (row->render == NULL) {
+        state = lexHidden(row, entry, buf);
+    }
+    else if (row->lex && !memcmp(&row->lex->at[0].state, &entry, sizeof(entry))) {
+        if (row->lex->editFrom >= 0) { state = lexEdit(row, buf); }
+        else { state.in_comment = row->highlight_open_comment; }
+        row->lex->editFrom = -1;
+    }
+    else {
+        state = lexRow(row, entry, buf);
+    }
+    row->highlight_stale = 0;
+
+    int changed = (row->highlight_open_comment != state.in_comment);
+    row->highlight_open_comment = state.in_comment;
+    return changed;
+}
+
+
+/*
+* Forgets where a row's lexer can resume, once its render has been built
+* again from scratch or the syntax changed under it.
+*/
+void highlightForget(editorRow *row) {
+    free(row->lex);
+    row->lex = NULL;
+}
+
+
+/*
+* Notes that render bytes [from, oldEnd) of a long row were replaced by
+* [from, newEnd). A second edit before the row is lexed again widens the
+* first to cover both.
+*/
+void highlightRowEdited(editorRow *row, int from, int oldEnd, int newEnd) {
+    struct lexIndex *lex = row->lex;
+    if (lex == NULL) { return; }
+
+    if (lex->editFrom < 0) {
+        lex->editFrom = from;
+        lex->editOldEnd = oldEnd;
+        lex->editNewEnd = newEnd;
+        return;
+    }
+
+    // in between the two edits, the first one's end and the second's old end
+    int end = (lex->editNewEnd > oldEnd) ? lex->editNewEnd : oldEnd;
+    if (from < lex->editFrom) { lex->editFrom = from; }
+    lex->editOldEnd = end - (lex->editNewEnd - lex->editOldEnd);
+    lex->editNewEnd = end + (newEnd - oldEnd);
+}
+
+
+/*
+* Span to start walking a row's highlighting from to reach render column
+* rx, with the column it starts at in start: on long rows the one at the
+* checkpoint before rx, otherwise the first.
+*/
+int highlightSeek(editorRow *row, int rx, int *start) {
+    int lo = 0;
+    int hi = row->lex ? row->lex->count : 0;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (row->lex->at[mid].rx <= rx) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+
+    if (lo == 0) {
+        *start = 0;
+        return 0;
+    }
+    const struct lexCheckpoint *cp = &row->lex->at[lo - 1];
+    *start = cp->rx - cp->spanOffset;
+    return cp->span;
+}
+
+
+/* Highlights a row from the comment state the previous row left open. */
+static int highlightRow(editorRow *row) {
+    return highlightRowFrom(
+        row, row->index > 0 && CONFIG.row[row->index - 1].highlight_open_comment, &LEX
+    );
+}
+
+
+/*
+* Flags a row for highlighting. Rows are only ever highlighted in order,
+* so the frontier is kept as a lower bound on the first stale row.
+*/
+void markSyntaxStale(int at) {
+    if (at < 0 || at >= CONFIG.numRows) { return; }
+
+    CONFIG.row[at].highlight_stale = 1;
+    if (at < CONFIG.highlightFrontier) { CONFIG.highlightFrontier = at; }
+}
+
+
+/* Last row worth highlighting eagerly: the end of the viewport. */
+static int viewportEnd() {
+    return foldRowsDown(CONFIG.rowOffset, CONFIG.screenRows - 1);
+}
+
+
+/*
+* One ordered pass over the stale rows of [first, last]. A row whose
+* outgoing comment state changed marks the next row stale, so the change
+* keeps propagating within the range and stops at the first row whose
+* incoming state matches what it was highlighted with. Anything past last
+* is left stale for updateSyntaxVisible to pick up once it is on screen.
+*/
+void updateSyntaxRange(int first, int last) {
+    if (first < 0) { first = 0; }
+    if (last >= CONFIG.numRows) { last = CONFIG.numRows - 1; }
+
+    int highlighted = 0;
+    for (int j = first; j <= last; j++) {
+        if (!CONFIG.row[j].highlight_stale) { continue; }
+
+        highlighted++;
+        if (highlightRow(&CONFIG.row[j])) { markSyntaxStale(j + 1); }
+    }
+    perfCount(PERF_ROWS_HIGHLIGHTED, highlighted);
+
+    // everything up to last is clean again
+    if (first <= CONFIG.highlightFrontier && CONFIG.highlightFrontier <= last) {
+        CONFIG.highlightFrontier = last + 1;
+    }
+}
+
+
+/*
+* A parallel pass cuts the range into chunks that are highlighted
+* independently, each starting from the state its previous row had before
+* the pass. A chunk whose last row ends up leaving a different state than
+* before "carries" into the next chunk, whose first row is then marked
+* stale; the sequential pass over the finished prefix that follows only
+* has those rows (and whatever they in turn affect) left to redo.
+*/
+struct highlightJob {
+    int first;
+    int last;
+    int chunkRows;
+
+    int *entry;   // assumed incoming comment state per chunk
+    int *carry;   // the chunk's last row changed its outgoing state
+    int *done;
+    int *lexed;   // rows the chunk highlighted
+};
+
+
+static void highlightChunk(int chunk, int worker, void *arg) {
+    (void) worker;
+    struct highlightJob *job = arg;
+
+    int first = job->first + chunk * job->chunkRows;
+    int last = first + job->chunkRows - 1;
+    if (last > job->last) { last = job->last; }
+
+    struct lexBuffer buf = LEXBUFFER_INIT;
+    int changed = 0;
+    int lexed = 0;
+    for (int j = first; j <= last; j++) {
+        editorRow *row = &CONFIG.row[j];
+
+        if (j == first) {
+            if (!row->highlight_stale) { continue; }
+            changed = highlightRowFrom(row, job->entry[chunk], &buf);
+        }
+        else if (changed || row->highlight_stale) {
+            changed = highlightRowFrom(row, CONFIG.row[j - 1].highlight_open_comment, &buf);
+        }
+        else { continue; }
+        lexed++;
+    }
+    lexBufferFree(&buf);
+
+    job->lexed[chunk] = lexed;
+    job->carry[chunk] = changed;
+    job->done[chunk] = 1;
+}
+
+
+/*
+* Highlights the stale rows of [first, last] on the worker pool. Once
+* interrupt fires no more chunks are started; rows of the chunks that
+* never ran are simply left stale.
+*/
+void updateSyntaxParallel(int first, int last, int (*interrupt)()) {
+    if (first < 0) { first = 0; }
+    if (last >= CONFIG.numRows) { last = CONFIG.numRows - 1; }
+    if (first > last) { return; }
+
+    struct highlightJob job;
+    job.first = first;
+    job.last = last;
+
+    // a few chunks per worker keeps them busy when row lengths vary
+    int rows = last - first + 1;
+    job.chunkRows = rows / (poolSize() * 4) + 1;
+    if (job.chunkRows < HIGHLIGHT_CHUNK_ROWS) { job.chunkRows = HIGHLIGHT_CHUNK_ROWS; }
+    int chunks = (rows + job.chunkRows - 1) / job.chunkRows;
+
+    job.entry = malloc(sizeof(int) * chunks);
+    job.carry = calloc(chunks, sizeof(int));
+    job.done = calloc(chunks, sizeof(int));
+    job.lexed = calloc(chunks, sizeof(int));
+    if (job.entry == NULL || job.carry == NULL || job.done == NULL || job.lexed == NULL) { die("malloc"); }
+
+    for (int c = 0; c < chunks; c++) {
+        int at = first + c * job.chunkRows;
+        job.entry[c] = at > 0 && CONFIG.row[at - 1].highlight_open_comment;
+    }
+
+    bracketsDefer(1);
+    poolRun(chunks, highlightChunk, &job, interrupt);
+    bracketsDefer(0);
+
+    int prefix = 0;
+    for (int c = 0; c < chunks; c++) {
+        if (!job.done[c]) { continue; }
+        if (prefix == c) { prefix++; }
+        perfCount(PERF_ROWS_HIGHLIGHTED, job.lexed[c]);
+
+        int next = first + (c + 1) * job.chunkRows;
+        if (job.carry[c]) { markSyntaxStale(next <= last ? next : last + 1); }
+    }
+
+    // fix up the carried rows of the finished prefix in order
+    if (prefix) {
+        int end = first + prefix * job.chunkRows - 1;
+        updateSyntaxRange(first, end < last ? end : last);
+    }
+
+    free(job.entry);
+    free(job.carry);
+    free(job.done);
+    free(job.lexed);
+}
+
+
+/*
+* Highlights a row that changed, and whatever it affects on screen. Rows
+* below the viewport are only marked, for the background worker.
+*/
+void updateSyntax(editorRow *row) {
+    unsigned long long start = perfStart(PERF_UPDATE_SYNTAX);
+    int end = viewportEnd();
+
+    markSyntaxStale(row->index);
+    if (row->index <= end) { updateSyntaxRange(row->index, end); }
+    perfStop(PERF_UPDATE_SYNTAX, start);
+}
+
+
+/*
+* Brings the rows up to the bottom of the viewport up to date before a
+* draw, when that is only a little work. Otherwise the background worker
+* gets to them; drawRows shows stale rows uncoloured in the meantime.
+*/
+void updateSyntaxVisible() {
+    int end = viewportEnd();
+
+    if (end - CONFIG.highlightFrontier <= HIGHLIGHT_EAGER_ROWS) {
+        updateSyntaxRange(CONFIG.highlightFrontier, end);
+    }
+}
+
+
+/*
+* The background worker only touches rows while the main thread sits idle
+* waiting for a key (IDLE), and the main thread doesn't go back to the
+* rows before the worker has finished its current slice (BUSY). Rows are
+* therefore never used by both at once and need no locking of their own.
+* Once every row is highlighted it goes on to index the words in them.
+* Finished slices that reached the viewport are announced on NOTIFY so the
+* waiting main thread can redraw.
+*/
+static pthread_mutex_t WORKER_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t WORKER_WAKE = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t WORKER_DONE = PTHREAD_COND_INITIALIZER;
+
+static int WORKER_STARTED = 0;
+static int IDLE = 0;
+static int BUSY = 0;
+static int NOTIFY[2] = {-1, -1};
+
+
+/* Stops a parallel pass as soon as the main thread wants the rows back. */
+static int workerInterrupted() {
+    pthread_mutex_lock(&WORKER_LOCK);
+    int stop = !IDLE;
+    pthread_mutex_unlock(&WORKER_LOCK);
+    return stop;
+}
+
+
+/*
+* Rows are highlighted in file order, which is also the order of priority
+* the dependencies allow: everything from the frontier to the bottom of
+* the viewport, then the rows just below it, then the rest of the file.
+* Long stretches of stale rows, such as a freshly opened file, go to the
+* pool in parallel. Returns whether the slice finished any visible rows.
+*/
+static int highlightSlice() {
+    int first = CONFIG.highlightFrontier;
+    int end = viewportEnd();
+    int target = (first <= end) ? end : CONFIG.numRows - 1;
+
+    if (target - first + 1 >= HIGHLIGHT_PARALLEL_ROWS) {
+        updateSyntaxParallel(first, target, workerInterrupted);
+        return first <= end && CONFIG.highlightFrontier > CONFIG.rowOffset;
+    }
+
+    int last = first + HIGHLIGHT_SLICE_ROWS - 1;
+    // never stop a few rows short of a complete screen
+    if (first <= end && last < end && end - last < HIGHLIGHT_SLICE_ROWS) { last = end; }
+
+    updateSyntaxRange(first, last);
+    return first <= end && last >= CONFIG.rowOffset;
+}
+
+
+static void *highlightWorker(void *arg) {
+    (void) arg;
+
+    pthread_mutex_lock(&WORKER_LOCK);
+    while (1) {
+        while (!IDLE || (CONFIG.highlightFrontier >= CONFIG.numRows && !wordsPending())) {
+            pthread_cond_wait(&WORKER_WAKE, &WORKER_LOCK);
+        }
+
+        BUSY = 1;
+        pthread_mutex_unlock(&WORKER_LOCK);
+
+        // completion can wait until everything on screen has its colours
+        if (CONFIG.highlightFrontier >= CONFIG.numRows) { wordsIndexSlice(); }
+
+        // a full pipe already holds a pending redraw, so a failed write is fine
+        else if (highlightSlice() && write(NOTIFY[1], "", 1)) {}
+
+        pthread_mutex_lock(&WORKER_LOCK);
+        BUSY = 0;
+        pthread_cond_signal(&WORKER_DONE);
+    }
+    return NULL;
+}
+
+
+/* Lets the worker run until highlightIdleEnd; returns the fd to poll. */
+int highlightIdleBegin() {
+    pthread_mutex_lock(&WORKER_LOCK);
+
+    if (!WORKER_STARTED) {
+        pthread_t thread;
+        if (pipe(NOTIFY) == -1) { die("pipe"); }
+        fcntl(NOTIFY[0], F_SETFL, O_NONBLOCK);
+        fcntl(NOTIFY[1], F_SETFL, O_NONBLOCK);
+
+        if (pthread_create(&thread, NULL, highlightWorker, NULL) != 0) {
+            die("pthread_create");
+        }
+        pthread_detach(thread);
+        WORKER_STARTED = 1;
+    }
+
+    IDLE = 1;
+    pthread_cond_signal(&WORKER_WAKE);
+    pthread_mutex_unlock(&WORKER_LOCK);
+
+    return NOTIFY[0];
+}
+
+
+/*
+* Takes the rows back from the worker, waiting for at most one slice.
+* Returns whether it published highlighting the screen should show.
+*/
+int highlightIdleEnd() {
+    pthread_mutex_lock(&WORKER_LOCK);
+    IDLE = 0;
+    while (BUSY) { pthread_cond_wait(&WORKER_DONE, &WORKER_LOCK); }
+    pthread_mutex_unlock(&WORKER_LOCK);
+
+    char drain[64];
+    int published = 0;
+    while (read(NOTIFY[0], drain, sizeof(drain)) > 0) { published = 1; }
+    return published;
 }
 
 
@@ -180,36 +1071,59 @@ int syntaxToColor(int hl) {
         case HL_STRING: return 35;
         case HL_NUMBER: return 31;
         case HL_MATCH: return 34;
+        case HL_BRACKET: return 36;
         default: return 37;
     }
 }
 
 
+/*
+* Definitions loaded from the syntax directory; they are consulted before
+* the built-in HLDB, so a file there can also replace a built-in syntax.
+*/
+static struct editorSyntax *LOADED = NULL;
+static int LOADED_ENTRIES = 0;
+
+
+void setLoadedSyntaxes(struct editorSyntax *syntaxes, int count) {
+    LOADED = syntaxes;
+    LOADED_ENTRIES = count;
+}
+
+
+static int syntaxMatches(struct editorSyntax *s, char *ext) {
+    for (unsigned int i = 0; s->filematch[i]; i++) {
+        int is_ext = (s->filematch[i][0] == '.');
+        if (
+            (is_ext && ext && !strcmp(ext, s->filematch[i]))
+            || (!is_ext && strstr(CONFIG.filename, s->filematch[i]))
+        ) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
 void selectSyntaxHighlight() {
     CONFIG.syntax = NULL;
     if (CONFIG.filename == NULL) { return; }
 
     char *ext = strrchr(CONFIG.filename, '.');
 
-    for (unsigned int j = 0; j < HLDB_ENTRIES; j++) {
-        struct editorSyntax *s = &HLDB[j];
-
-        unsigned int i = 0;
-        while (s->filematch[i]) {
-            int is_ext = (s->filematch[i][0] == '.');
-            if (
-                (is_ext && ext && !strcmp(ext, s->filematch[i]))
-                || (!is_ext && strstr(CONFIG.filename, s->filematch[i]))
-            ) {
-                CONFIG.syntax = s;
-
-                int filerow;
-                for (filerow = 0; filerow < CONFIG.numRows; filerow++) {
-                    updateSyntax(&CONFIG.row[filerow]);
-                }
-                return;
-            }
-            i++;
+    for (int j = 0; j < LOADED_ENTRIES + (int) HLDB_ENTRIES; j++) {
+        struct editorSyntax *s = (j < LOADED_ENTRIES) ? &LOADED[j] : &HLDB[j - LOADED_ENTRIES];
+        if (!syntaxMatches(s, ext)) { continue; }
+
+        CONFIG.syntax = s;
+        if (s->compiled == NULL) { s->compiled = compileSyntax(s); }
+
+        int filerow;
+        for (filerow = 0; filerow < CONFIG.numRows; filerow++) {
+            highlightForget(&CONFIG.row[filerow]);
+            markSyntaxStale(filerow);
         }
+        updateSyntaxVisible();
+        return;
     }
 }
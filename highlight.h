@@ -17,18 +17,102 @@ enum HIGHLIGHT
     HL_STRING,
     HL_NUMBER,
     HL_MATCH,
+    HL_BRACKET,
 };
 
 
-char *c_hl_extensions[5];
-char *c_hl_keywords[40];
-struct editorSyntax HLDB[5];
+/*
+* Open addressing hash of a syntax's keywords, with the "|" suffix already
+* turned into a highlight class. Sized to at most half full, so a miss
+* usually costs one probe. Empty slots have a zero length.
+*/
+struct keywordSlot {
+    unsigned int word;  // offset into the syntax's keyword text
+    unsigned short len;
+    unsigned char hl;
+};
+
+
+/*
+* Everything the highlighter needs about a syntax in lookup form. Built
+* when a syntax is first selected, or mapped straight from the syntax
+* cache, so it only refers to its own tables.
+*/
+struct compiledSyntax {
+    const unsigned char *classes;  // 256 entries
+    const struct keywordSlot *slots;
+    const char *words;
+    int wordsLen;
+
+    unsigned int mask;
+    int minLen;
+    int maxLen;
+
+    int scsLen;
+    int mcsLen;
+    int mceLen;
+};
+
+
+/*
+* All the lexer carries from one byte to the next. A lex resumed from a
+* saved state goes on exactly as if it had started at the row's start.
+*/
+struct lexState {
+    unsigned char in_comment;
+    unsigned char in_string;
+    unsigned char prev_sep;
+    unsigned char prev_hl;  // class of the byte before
+};
+
+
+/*
+* The lexer's state every MOOSE_LEX_CHECKPOINT render bytes or so of a
+* long row, with the highlight span that byte falls in. An edit is lexed
+* again from the checkpoint before it, and a draw finds its first span
+* without walking the row.
+*/
+struct lexCheckpoint {
+    int rx;
+    int span;
+    int spanOffset;  // bytes of the span before rx
+    struct lexState state;
+};
+
+
+/*
+* A long row's checkpoints, and what changed since they were taken:
+* render bytes [editFrom, editOldEnd) became [editFrom, editNewEnd), or
+* editFrom is -1 if nothing did.
+*/
+struct lexIndex {
+    int editFrom;
+    int editOldEnd;
+    int editNewEnd;
+
+    int count;
+    struct lexCheckpoint at[];
+};
+
 
-#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+extern char *c_hl_extensions[];
+extern char *c_hl_keywords[];
+extern struct editorSyntax HLDB[];
 
 
+struct compiledSyntax *compileSyntax(struct editorSyntax *);
 int syntaxToColor(int);
+void setLoadedSyntaxes(struct editorSyntax *, int);
 void selectSyntaxHighlight();
+void markSyntaxStale(int);
+void highlightForget(editorRow *);
+void highlightRowEdited(editorRow *, int, int, int);
+int highlightSeek(editorRow *, int, int *);
 void updateSyntax(editorRow *);
+void updateSyntaxRange(int, int);
+void updateSyntaxParallel(int, int, int (*interrupt)());
+void updateSyntaxVisible();
+int highlightIdleBegin();
+int highlightIdleEnd();
 
 #endif
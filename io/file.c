@@ -1,5 +1,7 @@
 /* Handle file I/O. */
 
+#define _DEFAULT_SOURCE
+
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -11,9 +13,12 @@
 #include "core.h"
 #include "highlight.h"
 #include "output.h"
+#include "perf.h"
 #include "ops/rowops.h"
+#include "ops/undo.h"
 
 void editorOpen(char *filename) {
+    unsigned long long start = perfStart(PERF_OPEN);
     free(CONFIG.filename);
     CONFIG.filename = strdup(filename);
 
@@ -26,6 +31,8 @@ void editorOpen(char *filename) {
     size_t linecap = 0;
     ssize_t linelen;
 
+    // a freshly opened file has nothing to undo
+    undoSuspend();
     while ((linelen = getline(&line, &linecap, fp)) != -1) {
 
         while (
@@ -41,9 +48,13 @@ void editorOpen(char *filename) {
         editorInsertRow(CONFIG.numRows, line, linelen);
     }
 
+    undoResume();
+    undoReset();
+
     free(line);
     fclose(fp);
     CONFIG.dirty = 0;
+    perfStop(PERF_OPEN, start);
 }
 
 
@@ -80,6 +91,7 @@ void editorSave() {
         selectSyntaxHighlight();
     }
 
+    unsigned long long start = perfStart(PERF_SAVE);
     int len;
     char *buf = editorRowsToString(&len);
 
@@ -91,6 +103,8 @@ void editorSave() {
                 free(buf);
                 CONFIG.dirty = 0;
                 setStatusMessage("%d bytes written to disk", len);
+                perfCount(PERF_BYTES_SAVED, len);
+                perfStop(PERF_SAVE, start);
                 return;
             }
         }
@@ -101,4 +115,5 @@ void editorSave() {
         "Oh oh - didn't manage to save the file: %s", 
         strerror(errno)
     );
+    perfStop(PERF_SAVE, start);
 }
@@ -1,10 +1,16 @@
 /* Handle low level keyboard input.*/
 
 #include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <unistd.h>
 
 #include "core.h"
+#include "fold.h"
+#include "highlight.h"
+#include "output.h"
+#include "utf8.h"
+#include "ops/rowops.h"
 
 static int readEscapeSequence() {
     char seq[3];
@@ -62,33 +68,37 @@ void moveCursorKeypress(int key) {
     switch(key) {
         case ARROW_LEFT:
             if (CONFIG.cursorX != 0) {
-                CONFIG.cursorX--;
+                CONFIG.cursorX = utf8Prev(row->characters, CONFIG.cursorX);
             }
             else if (CONFIG.cursorY > 0) {
-                CONFIG.cursorY--;
+                CONFIG.cursorY = foldPrev(CONFIG.cursorY);
                 CONFIG.cursorX = CONFIG.row[CONFIG.cursorY].rowSize;
             }
             break;
 
         case ARROW_RIGHT:
             if (row && CONFIG.cursorX < row->rowSize) {
-                CONFIG.cursorX++;
+                int cp;
+                CONFIG.cursorX += utf8Decode(
+                    &row->characters[CONFIG.cursorX], row->rowSize - CONFIG.cursorX, &cp
+                );
             }
             else if (row && CONFIG.cursorX == row->rowSize) {
-                CONFIG.cursorY++;
+                CONFIG.cursorY = foldNext(CONFIG.cursorY);
                 CONFIG.cursorX = 0;
             }
             break;
 
         case ARROW_DOWN:
             // cursorY starts from 0 (top left), so "down" == incrementing up
-            if (CONFIG.cursorY < CONFIG.numRows) { CONFIG.cursorY++; }
+            // and a folded row steps over the rows it hides
+            if (CONFIG.cursorY < CONFIG.numRows) { CONFIG.cursorY = foldNext(CONFIG.cursorY); }
             break;
 
         case ARROW_UP:
             // going up the page is taking cursorY back down to 0 as the cursor
             // starts at 0,0 top left hand side of the editor
-            if (CONFIG.cursorY != 0) { CONFIG.cursorY--; }
+            if (CONFIG.cursorY != 0) { CONFIG.cursorY = foldPrev(CONFIG.cursorY); }
             break;
     }
 
@@ -96,6 +106,19 @@ void moveCursorKeypress(int key) {
     int rowLen = row ? row->rowSize : 0;
 
     if (CONFIG.cursorX > rowLen) { CONFIG.cursorX = rowLen; }
+
+    // a column kept from another row may fall inside a character
+    if (row && row->numStops) {
+        CONFIG.cursorX = editorRowRxToCx(row, editorRowCxToRx(row, CONFIG.cursorX));
+    }
+}
+
+
+int keyPending() {
+    // non-blocking check used by long running work to yield to the user
+    struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+
+    return poll(&pfd, 1, 0) > 0;
 }
 
 
@@ -103,9 +126,25 @@ int readKey() {
     int nread;
     char c;
 
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-        if (nread == -1 && errno != EAGAIN) { die("read"); } 
+    // the background highlighter only works on the rows while we wait here
+    int notify = highlightIdleBegin();
+
+    while (1) {
+        struct pollfd pfd[2] = {{STDIN_FILENO, POLLIN, 0}, {notify, POLLIN, 0}};
+        if (poll(pfd, 2, -1) == -1 && errno != EINTR) { die("poll"); }
+
+        if (pfd[1].revents & POLLIN) {
+            if (highlightIdleEnd()) { refreshScreen(); }
+            notify = highlightIdleBegin();
+        }
+
+        if (pfd[0].revents & POLLIN) {
+            nread = read(STDIN_FILENO, &c, 1);
+            if (nread == 1) { break; }
+            if (nread == -1 && errno != EAGAIN) { die("read"); }
+        }
     }
+    highlightIdleEnd();
 
     if (c == '\x1b') {
         return readEscapeSequence();
@@ -3,6 +3,7 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+int keyPending();
 void moveCursorKeypress(int);
 int readKey();
 
@@ -9,12 +9,20 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "brackets.h"
 #include "core.h"
 #include "escapecodes.h"
+#include "fold.h"
 #include "input.h"
 #include "highlight.h"
 #include "output.h"
+#include "perf.h"
+#include "search.h"
+#include "utf8.h"
+#include "wrap.h"
+#include "ops/cursors.h"
 #include "ops/rowops.h"
+#include "ops/selection.h"
 
 
 static void drawMessageBar(struct appendString *as) {
@@ -29,87 +37,383 @@ static void drawMessageBar(struct appendString *as) {
 }
 
 
-static void drawRows(struct appendString *as) {
-    for (int y = 0; y < CONFIG.screenRows; y++) {
-        int fileRow = y + CONFIG.rowOffset;
-        if (fileRow>= CONFIG.numRows) {
-            if (CONFIG.numRows == 0 && y == CONFIG.screenRows / 3 ) {
-                char welcome[80];
+static void drawSymbol(struct appendString *as, char sym, int current_color) {
+    append(as, SELECT_GRAPHIC_RENDITION_INVERT, 4);
+    append(as, &sym, 1);
+    append(as, SELECT_GRAPHIC_RENDITION_DEFFAULT, 3);
 
-                int welcomeLen = snprintf(
-                    welcome, sizeof(welcome),
-                    "MOOSE EDITOR -- VERSION %s", MOOSE_VERSION);
+    if (current_color != -1) {
+        char buf[16];
+        int clen = snprintf(buf, sizeof(buf), CUSTOM_COLOR, current_color);
+        append(as, buf, clen);
+    }
+}
 
-                if (welcomeLen > CONFIG.screenCols) {
-                    welcomeLen = CONFIG.screenCols;
-                }
 
-                int padding = (CONFIG.screenCols - welcomeLen) / 2;
+/*
+* Draws a run of render bytes that share one highlight class, switching
+* colour at most once. UTF-8 is passed through whole; control characters
+* and bytes that are not valid UTF-8 are shown inverted.
+*/
+static void drawRun(struct appendString *as, char *c, int len, int hl, int *current_color) {
+    int color = (hl == HL_NORMAL) ? -1 : syntaxToColor(hl);
+
+    int j = 0;
+    while (j < len) {
+        int start = j;
+        int skip = 0;
+        char sym = '?';
+
+        while (j < len) {
+            unsigned char u = c[j];
+            if (u >= 0x20 && u < 0x7f) {
+                j++;
+                continue;
+            }
 
-                if (padding) {
-                    append(as, "~", 1);
-                    padding--;
-                }
+            if (u < 0x80) {
+                if (u <= 26) { sym = '@' + u; }
+                skip = 1;
+                break;
+            }
+
+            // C1 controls are left out along with invalid bytes
+            int cp;
+            int bytes = utf8Decode(&c[j], len - j, &cp);
+            if (cp < 0xa0) {
+                skip = bytes;
+                break;
+            }
+            j += bytes;
+        }
 
-                while (padding--) { append(as, " ", 1); }
-                append(as, welcome, welcomeLen);
+        if (j > start) {
+            if (color != *current_color) {
+                if (color == -1) { append(as, DEFAULT_COLOR, 5); }
+                else {
+                    char buf[16];
+                    int clen = snprintf(buf, sizeof(buf), CUSTOM_COLOR, color);
+                    append(as, buf, clen);
+                }
+                *current_color = color;
             }
+            append(as, &c[start], j - start);
+        }
+
+        if (skip) {
+            drawSymbol(as, sym, *current_color);
+            j += skip;
+        }
+    }
+}
+
+
+/*
+* Render column of the next extra cursor on a row that is on screen,
+* skipping the editor's own cursor, which the terminal draws. Returns -1
+* once there are none left.
+*/
+static int nextCursorRx(editorRow *row, int from, const struct cursor **cursor, int *cursors) {
+    while (*cursors) {
+        const struct cursor *c = (*cursor)++;
+        (*cursors)--;
+
+        if (c->y == CONFIG.cursorY && c->x == CONFIG.cursorX) { continue; }
+
+        int rx = editorRowCxToRx(row, c->x);
+        if (rx >= from) { return rx; }
+    }
+    return -1;
+}
+
+
+/*
+* The bracket at the cursor and the one it matches, in order, painted in
+* their own colour. Found once per refresh.
+*/
+static struct {
+    int count;
+    int y[2];
+    int x[2];
+} PAIR = {0, {0, 0}, {0, 0}};
+
+
+static void findPair() {
+    int atX, matchY, matchX;
+    int y = CONFIG.cursorY;
+    PAIR.count = 0;
+
+    // only when every row the match depends on is highlighted
+    if (!bracketMatch(y, CONFIG.cursorX, &atX, &matchY, &matchX)) { return; }
+    if ((matchY > y ? matchY : y) >= CONFIG.highlightFrontier) { return; }
+
+    int first = (matchY < y || (matchY == y && matchX < atX));
+    PAIR.count = 2;
+    PAIR.y[!first] = y;
+    PAIR.x[!first] = atX;
+    PAIR.y[first] = matchY;
+    PAIR.x[first] = matchX;
+}
+
+
+/* Render column of the next bracket of the pair on a row, from from on, or -1. */
+static int nextPairRx(editorRow *row, int from, int *pair) {
+    for (; *pair < PAIR.count; (*pair)++) {
+        if (PAIR.y[*pair] != row->index) { continue; }
+
+        int rx = editorRowCxToRx(row, PAIR.x[*pair]);
+        if (rx >= from) {
+            (*pair)++;
+            return rx;
+        }
+    }
+    return -1;
+}
+
+
+static void drawEmptyRow(struct appendString *as, int y) {
+    if (CONFIG.numRows == 0 && y == CONFIG.screenRows / 3 ) {
+        char welcome[80];
+
+        int welcomeLen = snprintf(
+            welcome, sizeof(welcome),
+            "MOOSE EDITOR -- VERSION %s", MOOSE_VERSION);
 
+        if (welcomeLen > CONFIG.screenCols) {
+            welcomeLen = CONFIG.screenCols;
+        }
+
+        int padding = (CONFIG.screenCols - welcomeLen) / 2;
+
+        if (padding) {
+            append(as, "~", 1);
+            padding--;
+        }
+
+        while (padding--) { append(as, " ", 1); }
+        append(as, welcome, welcomeLen);
+    }
+
+    else {
+        append(as, "~", 1);
+    }
+}
+
+
+/*
+* Draws render columns from up to end of a row, starting a new screen line
+* at each of the ascending breaks between them. The first line starts at
+* screen column lineCol of the row. The caller ends the last line.
+*/
+static void drawRow(struct appendString *as, int fileRow, int from, int end, int lineCol, const int *breaks, int numBreaks) {
+    editorRow *row = &CONFIG.row[fileRow];
+    int current_color = -1;
+
+    // search matches are painted over the stored highlighting
+    struct searchMatch *match = NULL;
+    int matches = searchRowMatches(fileRow, &match);
+    int matchEnd = 0;
+
+    // rows still waiting for the background highlighter are drawn plain
+    int spans = row->highlight_stale ? 0 : row->highlightSpans;
+    int spanEnd = 0;
+    int span = spans ? highlightSeek(row, from, &spanEnd) : 0;
+    int h = HL_NORMAL;
+
+    // extra cursors are drawn as inverted cells
+    const struct cursor *cursor = NULL;
+    int cursors = cursorsOnRow(fileRow, &cursor);
+    int cursorRx = nextCursorRx(row, from, &cursor, &cursors);
+
+    // the bracket pair too, in a colour of its own
+    int pair = 0;
+    int pairRx = nextPairRx(row, from, &pair);
+
+    // and so is the selection
+    int sx, sy, ex, ey;
+    int selFrom = 0;
+    int selTo = 0;
+    if (selectionRange(&sx, &sy, &ex, &ey) && sy <= fileRow && fileRow <= ey) {
+        selFrom = (fileRow == sy) ? editorRowCxToRx(row, sx) : 0;
+        selTo = (fileRow == ey) ? editorRowCxToRx(row, ex) : row->renderSize;
+    }
+
+    int b = 0;
+    int x = from;
+    while (x < end) {
+        if (b < numBreaks && x == breaks[b]) {
+            append(as, ERASE_IN_LINE, 3);
+            append(as, "\r\n", 2);
+            lineCol = editorRowRxToCol(row, x);
+            b++;
+        }
+
+        while (spanEnd <= x) {
+            if (span < spans) {
+                h = HL_SPAN_CLASS(row->highlight[span]);
+                spanEnd += HL_SPAN_LEN(row->highlight[span]);
+                span++;
+            }
             else {
-                append(as, "~", 1);
+                h = HL_NORMAL;
+                spanEnd = end;
+            }
+        }
+
+        int stop = (spanEnd < end) ? spanEnd : end;
+        int runHl = h;
+
+        while (matches && match->rx <= x) {
+            if (match->rx + match->len > matchEnd) {
+                matchEnd = match->rx + match->len;
             }
+            match++;
+            matches--;
+        }
+        if (x < matchEnd) {
+            runHl = HL_MATCH;
+            if (matchEnd < stop) { stop = matchEnd; }
+        }
+        else if (matches && match->rx < stop) { stop = match->rx; }
+
+        if (pairRx == x) {
+            runHl = HL_BRACKET;
+            stop = x + 1;
+            pairRx = nextPairRx(row, from, &pair);
+        }
+        else if (pairRx != -1 && pairRx < stop) { stop = pairRx; }
+
+        int invert = 0;
+        if (cursorRx == x) {
+            invert = 1;
+            stop = editorRowRxCharEnd(row, x);
+            cursorRx = nextCursorRx(row, from, &cursor, &cursors);
+        }
+        else if (cursorRx != -1 && cursorRx < stop) { stop = cursorRx; }
+
+        if (selFrom <= x && x < selTo) {
+            invert = 1;
+            if (selTo < stop) { stop = selTo; }
+        }
+        else if (x < selFrom && selFrom < stop) { stop = selFrom; }
+
+        if (b < numBreaks && breaks[b] < stop) { stop = breaks[b]; }
+
+        // a run never ends part way through a character
+        if (row->numStops && stop < end) {
+            int charEnd = editorRowRxCharEnd(row, stop - 1);
+            if (charEnd > stop) { stop = charEnd; }
         }
 
+        if (invert) { append(as, SELECT_GRAPHIC_RENDITION_INVERT, 4); }
+        drawRun(as, &row->render[x], stop - x, runHl, &current_color);
+        if (invert) {
+            append(as, SELECT_GRAPHIC_RENDITION_DEFFAULT, 3);
+            current_color = -1;
+        }
+        x = stop;
+    }
+
+    // or past the end of the line
+    int endCol = editorRowRxToCol(row, row->renderSize);
+    if (cursorRx == row->renderSize && end == row->renderSize && endCol >= lineCol
+        && endCol < lineCol + CONFIG.screenCols) {
+        append(as, SELECT_GRAPHIC_RENDITION_INVERT, 4);
+        append(as, " ", 1);
+        append(as, SELECT_GRAPHIC_RENDITION_DEFFAULT, 3);
+    }
+    append(as, DEFAULT_COLOR, 5);
+}
+
+
+/*
+* Follows the first row of a fold with how many rows it hides, as far as
+* the screen line has room. used is how many columns the row took on it;
+* a cell is kept free for a cursor past its end.
+*/
+static void drawFoldMarker(struct appendString *as, int fileRow, int used) {
+    int hidden = foldLast(fileRow) - fileRow;
+    if (hidden == 0) { return; }
+
+    char marker[32];
+    int len = snprintf(marker, sizeof(marker), " +%d rows ", hidden);
+    int room = CONFIG.screenCols - (used > 0 ? used : 0) - 2;
+    if (room <= 0) { return; }
+    if (len > room) { len = room; }
+
+    append(as, " ", 1);
+    append(as, SELECT_GRAPHIC_RENDITION_INVERT, 4);
+    append(as, marker, len);
+    append(as, SELECT_GRAPHIC_RENDITION_DEFFAULT, 3);
+}
+
+
+/* Draws the window from its top screen line, rows broken over several. */
+static void drawWrappedRows(struct appendString *as) {
+    int sub;
+    int fileRow = wrapRowAt(CONFIG.wrapOffset, &sub);
+
+    for (int y = 0; y < CONFIG.screenRows; ) {
+        int lines = 1;
+
+        if (fileRow >= CONFIG.numRows) { drawEmptyRow(as, y); }
         else {
-            int len = CONFIG.row[fileRow].renderSize - CONFIG.colOffset;
-            if (len < 0) { len = 0; }
-
-            if (len > CONFIG.screenCols) { len = CONFIG.screenCols; }
-
-            char *c = &CONFIG.row[fileRow].render[CONFIG.colOffset];
-            unsigned char *hl = &CONFIG.row[fileRow].highlight[CONFIG.colOffset];
-            int current_color = -1;
-            int j;
-            for (j = 0; j < len; j++) {
-                if (iscntrl(c[j])) {
-                    char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-                    append(as, SELECT_GRAPHIC_RENDITION_INVERT, 4);
-                    append(as, &sym, 1);
-                    append(as, SELECT_GRAPHIC_RENDITION_DEFFAULT, 3);
-
-                    if (current_color != -1) {
-                        char buf[16];
-                        int clen = snprintf(
-                            buf, sizeof(buf), CUSTOM_COLOR, current_color
-                        );
-                        append(as, buf, clen);
-                    }
-                }
+            editorRow *row = &CONFIG.row[fileRow];
+            lines = row->numWraps + 1 - sub;
+            if (lines > CONFIG.screenRows - y) { lines = CONFIG.screenRows - y; }
+
+            int from = wrapLineStart(row, sub);
+            drawRow(
+                as, fileRow, from, wrapLineEnd(row, sub + lines - 1),
+                editorRowRxToCol(row, from), &row->wraps[sub], lines - 1
+            );
+
+            if (sub + lines - 1 == row->numWraps) {
+                int lineCol = editorRowRxToCol(row, wrapLineStart(row, row->numWraps));
+                drawFoldMarker(as, fileRow, editorRowRxToCol(row, row->renderSize) - lineCol);
+            }
+        }
+        append(as, ERASE_IN_LINE, 3);
+        append(as, "\r\n", 2);
 
-                else if (hl[j] == HL_NORMAL) {
-                    if (current_color != -1) {
-                        append(as, DEFAULT_COLOR, 5);
-                        current_color = -1;
-                    }
-                    append(as, &c[j], 1);
-                }
+        y += lines;
+        fileRow = foldNext(fileRow);
+        sub = 0;
+    }
+}
 
-                else {
-                    int color = syntaxToColor(hl[j]);
-                    if (color != current_color) {
-                        current_color = color;
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), CUSTOM_COLOR, color);
-                        append(as, buf, clen);
-                    }
-                    append(as, &c[j], 1);
-                }
+
+static void drawRows(struct appendString *as) {
+    if (CONFIG.softWrap) {
+        drawWrappedRows(as);
+        return;
+    }
+
+    // rows hidden in a fold are stepped over, not walked
+    int fileRow = CONFIG.rowOffset;
+    for (int y = 0; y < CONFIG.screenRows; y++) {
+        if (fileRow>= CONFIG.numRows) { drawEmptyRow(as, y); }
+
+        else {
+            editorRow *row = &CONFIG.row[fileRow];
+            int from = editorRowColToRx(row, CONFIG.colOffset);
+            int end = editorRowColToRx(row, CONFIG.colOffset + CONFIG.screenCols);
+            if (end > row->renderSize) { end = row->renderSize; }
+            if (from > end) { from = end; }
+
+            // a wide character cut by the left edge shows as a space
+            if (from < end && editorRowRxToCol(row, from) < CONFIG.colOffset) {
+                append(as, " ", 1);
+                from = editorRowRxCharEnd(row, from);
             }
-            append(as, DEFAULT_COLOR, 5);
+
+            drawRow(as, fileRow, from, end, CONFIG.colOffset, NULL, 0);
+            drawFoldMarker(as, fileRow, editorRowRxToCol(row, row->renderSize) - CONFIG.colOffset);
         }
         // clear lines as we draw them
         append(as, ERASE_IN_LINE, 3);
         append(as, "\r\n", 2);
+        fileRow = foldNext(fileRow);
     }
 }
 
@@ -119,7 +423,12 @@ static void drawStatusBar(struct appendString *as) {
     append(as, SELECT_GRAPHIC_RENDITION_INVERT, 4);
 
     char status[80];
-    char rstatus[80];  // holds current line number
+    char rstatus[120];  // holds current line number
+    char search[40];
+    char hud[40];
+
+    int slen = searchStatus(search, sizeof(search));
+    int hlen = perfHud(hud, sizeof(hud));
 
     int len = snprintf(
         status, sizeof(status), "%.20s - %d lines %s",
@@ -127,7 +436,9 @@ static void drawStatusBar(struct appendString *as) {
         CONFIG.dirty ? "(modified)" : ""
     );
     int rlen = snprintf(
-        rstatus, sizeof(rstatus), "%s | %d/%d",
+        rstatus, sizeof(rstatus), "%.*s%s%.*s%s%s | %d/%d",
+        hlen, hud, hlen ? " | " : "",
+        slen, search, slen ? " | " : "",
         CONFIG.syntax ? CONFIG.syntax->filetype : "no ft",
         CONFIG.cursorY + 1, CONFIG.numRows
     );
@@ -153,32 +464,79 @@ static void drawStatusBar(struct appendString *as) {
 }
 
 
+/* Where the cursor is drawn, counted from the top left of the window. */
+static struct {
+    int y;
+    int x;
+} SCREEN_CURSOR = {0, 0};
+
+
+/* Scrolls by screen lines, so a row longer than the window still fits. */
+static void scrollWrapped() {
+    int x;
+    int line = wrapCursorLine(&x);
+    if (x >= CONFIG.screenCols) { x = CONFIG.screenCols - 1; }
+
+    if (line < CONFIG.wrapOffset) {
+        CONFIG.wrapOffset = line;
+    }
+    if (line >= CONFIG.wrapOffset + CONFIG.screenRows) {
+        CONFIG.wrapOffset = line - CONFIG.screenRows + 1;
+    }
+
+    int sub;
+    CONFIG.colOffset = 0;
+    CONFIG.rowOffset = wrapRowAt(CONFIG.wrapOffset, &sub);
+
+    SCREEN_CURSOR.y = line - CONFIG.wrapOffset;
+    SCREEN_CURSOR.x = x;
+}
+
+
 static void editorScroll() {
+    // whatever moved the cursor into a fold opens it
+    foldReveal(CONFIG.cursorY);
+
+    if (CONFIG.softWrap) {
+        scrollWrapped();
+        return;
+    }
+
     CONFIG.renderX = 0;
+    int col = 0;
     if (CONFIG.cursorY < CONFIG.numRows) {
-        CONFIG.renderX = editorRowCxToRx(
-            &CONFIG.row[CONFIG.cursorY], CONFIG.cursorX);
+        editorRow *row = &CONFIG.row[CONFIG.cursorY];
+        CONFIG.renderX = editorRowCxToRx(row, CONFIG.cursorX);
+        col = editorRowRxToCol(row, CONFIG.renderX);
     }
 
+    // rows are counted by the lines they are drawn on, a fold taking one
+    int line = foldLineOf(CONFIG.cursorY);
+    int top = foldLineOf(CONFIG.rowOffset);
+
     // is cursor above the visible window? If so, scroll up to cursor
-    if (CONFIG.cursorY < CONFIG.rowOffset) {
-        CONFIG.rowOffset = CONFIG.cursorY;
+    if (line < top) {
+        top = line;
     }
 
     // is cursor below the visible window? If so, scroll down to cursor.
-    if (CONFIG.cursorY >= CONFIG.rowOffset + CONFIG.screenRows) {
-        CONFIG.rowOffset = CONFIG.cursorY - CONFIG.screenRows + 1;
+    if (line >= top + CONFIG.screenRows) {
+        top = line - CONFIG.screenRows + 1;
     }
+    CONFIG.rowOffset = foldRowAt(top);
 
     // cursor is to the left of visible window
-    if (CONFIG.renderX < CONFIG.colOffset) {
-        CONFIG.colOffset = CONFIG.renderX;
+    if (col < CONFIG.colOffset) {
+        CONFIG.colOffset = col;
     }
 
     // cursor is to the right of visible window
-    if (CONFIG.renderX >= CONFIG.colOffset + CONFIG.screenCols) {
-        CONFIG.colOffset = CONFIG.renderX - CONFIG.screenCols + 1;
+    if (col >= CONFIG.colOffset + CONFIG.screenCols) {
+        CONFIG.colOffset = col - CONFIG.screenCols + 1;
     }
+
+    SCREEN_CURSOR.y = line - top;
+    SCREEN_CURSOR.x = col - CONFIG.colOffset;
 }
 
 
@@ -186,36 +544,47 @@ static void moveCursorToCxCyPosition(struct appendString *as) {
     char buf[32];
     snprintf(
         buf, sizeof(buf), CUSTOM_CURSOR_POSITION,
-        (CONFIG.cursorY - CONFIG.rowOffset) + 1,
-        (CONFIG.renderX - CONFIG.colOffset) + 1
+        SCREEN_CURSOR.y + 1, SCREEN_CURSOR.x + 1
     );
 
     append(as, buf, strlen(buf));
 }
 
 
-void refreshScreen() {
+/* Assembles the next frame in as, scrolling to the cursor first. */
+void drawScreen(struct appendString *as) {
     editorScroll();
+    updateSyntaxVisible();
+    findPair();
 
-    struct appendString as = APPENDSTRING_INIT;
+    append(as, HIDE_CURSOR, 6);
+    append(as, CURSOR_TOP_LEFT, 3);
 
-    append(&as, HIDE_CURSOR, 6);
-    append(&as, CURSOR_TOP_LEFT, 3);
+    unsigned long long rows = perfStart(PERF_DRAW_ROWS);
+    drawRows(as);
+    perfStop(PERF_DRAW_ROWS, rows);
+    drawStatusBar(as);
+    drawMessageBar(as);
 
-    drawRows(&as);
-    drawStatusBar(&as);
-    drawMessageBar(&as);
+    moveCursorToCxCyPosition(as);
+
+    append(as, SHOW_CURSOR, 6);
+}
 
-    moveCursorToCxCyPosition(&as);
 
-    append(&as, SHOW_CURSOR, 6);
+void refreshScreen() {
+    unsigned long long start = perfStart(PERF_REFRESH);
+    struct appendString as = APPENDSTRING_INIT;
+    drawScreen(&as);
 
     write(STDOUT_FILENO, as.s, as.len);
+    perfCount(PERF_BYTES_DRAWN, as.len);
     stringFree(&as);
+    perfStop(PERF_REFRESH, start);
 }
 
 
-char * prompt(char *prompt, void (*callback)(char *, int)) {
+static char * promptLine(char *prompt, void (*callback)(char *, int), int allowEmpty) {
 
     size_t bufsize = 128;
     char *buf = malloc(bufsize);
@@ -242,7 +611,7 @@ char * prompt(char *prompt, void (*callback)(char *, int)) {
         }
 
         else if (c == '\r') {
-            if (buflen != 0) {
+            if (buflen != 0 || allowEmpty) {
                 setStatusMessage("");
                 if (callback) { callback(buf, c); }
                 return buf;
@@ -261,3 +630,14 @@ char * prompt(char *prompt, void (*callback)(char *, int)) {
         if (callback) { callback(buf, c); }
     }
 }
+
+
+char * prompt(char *prompt, void (*callback)(char *, int)) {
+    return promptLine(prompt, callback, 0);
+}
+
+
+/* Like prompt, but Enter on an empty line returns an empty string. */
+char * promptAllowEmpty(char *prompt, void (*callback)(char *, int)) {
+    return promptLine(prompt, callback, 1);
+}
@@ -3,7 +3,11 @@
 #ifndef OUTPUT_H
 #define OUTPUT_H
 
+#include "core.h"
+
+void drawScreen(struct appendString *);
 char * prompt(char *, void (*callback)(char *, int));
+char * promptAllowEmpty(char *, void (*callback)(char *, int));
 void refreshScreen();
 
 #endif
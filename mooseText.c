@@ -17,15 +17,24 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include "brackets.h"
 #include "core.h"
 #include "termconf.h"
+#include "fold.h"
+#include "wrap.h"
 #include "highlight.h"
+#include "perf.h"
 #include "search.h"
+#include "syntax.h"
+#include "words.h"
 #include "io/file.h"
 #include "io/input.h"
 #include "io/output.h"
+#include "ops/cursors.h"
 #include "ops/editorops.h"
 #include "ops/rowops.h"
+#include "ops/selection.h"
+#include "ops/undo.h"
 
 static void initEditor() {
     CONFIG.cursorX = 0;
@@ -35,6 +44,9 @@ static void initEditor() {
     CONFIG.colOffset = 0;
     CONFIG.rowOffset = 0;
 
+    CONFIG.softWrap = 0;
+    CONFIG.wrapOffset = 0;
+
     CONFIG.row = NULL;
     CONFIG.filename = NULL;
 
@@ -80,34 +92,62 @@ static void processKeypress() {
             break;
 
         case HOME_KEY:
+            undoSeal();
             if (CONFIG.cursorY < CONFIG.numRows) {
                 CONFIG.cursorX = CONFIG.row[CONFIG.cursorY].rowSize;
             }
             break;
 
         case END_KEY:
+            undoSeal();
             CONFIG.cursorX = CONFIG.screenCols - 1;
             break;
 
         case CTRL_KEY('f'):
+            undoSeal();
             find();
             break;
 
+        case CTRL_KEY('r'):
+            replace();
+            break;
+
+        case CTRL_KEY('w'):
+            undoSeal();
+            watchList();
+            break;
+
+        case CTRL_KEY('z'):
+            cursorsClear();
+            if (!undo()) { setStatusMessage("Nothing to undo"); }
+            break;
+
+        case CTRL_KEY('y'):
+            cursorsClear();
+            if (!redo()) { setStatusMessage("Nothing to redo"); }
+            break;
+
         case BACKSPACE:
         case CTRL_KEY('h'):
         case DEL_KEY:
-            if (c == DEL_KEY) { moveCursorKeypress(ARROW_RIGHT); }
+            if (c == DEL_KEY) { cursorsMove(ARROW_RIGHT); }
             delChar();
             break;
 
         case PAGE_UP:
         case PAGE_DOWN: {
+                undoSeal();
+                if (CONFIG.softWrap) {
+                    wrapMoveLines(c == PAGE_UP ? -CONFIG.screenRows : CONFIG.screenRows);
+                    break;
+                }
+
                 if (c == PAGE_UP) {
                     CONFIG.cursorY = CONFIG.rowOffset;
                 }
 
                 else if (c == PAGE_DOWN) {
-                    CONFIG.cursorY = CONFIG.rowOffset + CONFIG.screenRows - 1;
+                    CONFIG.cursorY = foldRowsDown(CONFIG.rowOffset, CONFIG.screenRows - 1);
 
                     if (CONFIG.cursorY > CONFIG.numRows) {
                         CONFIG.cursorY = CONFIG.numRows;
@@ -123,13 +163,87 @@ static void processKeypress() {
 
         case ARROW_UP:
         case ARROW_DOWN:
+            // moving the cursor ends the edit being typed, even if it
+            // comes back to where it was
+            undoSeal();
+            // wrapped rows are walked a screen line at a time
+            if (CONFIG.softWrap && !cursorsActive()) {
+                wrapMoveLines(c == ARROW_UP ? -1 : 1);
+                break;
+            }
+            cursorsMove(c);
+            break;
+
         case ARROW_LEFT:
         case ARROW_RIGHT:
-            moveCursorKeypress(c);
+            undoSeal();
+            cursorsMove(c);
+            break;
+
+        case CTRL_KEY('n'):
+            cursorsAddBelow();
+            setStatusMessage("%d cursors | Esc = drop them", cursorsCount());
+            break;
+
+        case CTRL_KEY('d'):
+            if (!cursorsAddMatches()) { setStatusMessage("No word under the cursor"); }
+            else { setStatusMessage("%d cursors | Esc = drop them", cursorsCount()); }
+            break;
+
+        case CTRL_KEY('t'):
+            wrapToggle();
+            setStatusMessage("Soft wrap %s", CONFIG.softWrap ? "on" : "off");
+            break;
+
+        case CTRL_KEY('k'): {
+                int hidden = foldToggle(CONFIG.cursorY);
+                if (hidden > 0) { setStatusMessage("Folded %d rows | Ctrl-K = unfold", hidden); }
+                else if (hidden == 0) { setStatusMessage("Nothing to fold here"); }
+            }
+            break;
+
+        case CTRL_KEY('u'):
+            setStatusMessage("Opened %d folds", foldOpenAll());
+            break;
+
+        case CTRL_KEY('p'):
+            undoSeal();
+            if (!bracketJump()) { setStatusMessage("No matching bracket"); }
+            break;
+
+        case CTRL_KEY('o'):
+            cursorsClear();
+            if (!wordComplete()) { setStatusMessage("No completions"); }
+            break;
+
+        case CTRL_KEY('b'):
+            selectionToggle();
+            break;
+
+        case CTRL_KEY('c'):
+            selectionCopy();
+            break;
+
+        case CTRL_KEY('x'):
+            cursorsClear();
+            selectionCut();
+            break;
+
+        case CTRL_KEY('v'):
+            cursorsClear();
+            selectionPaste();
             break;
 
-        case CTRL_KEY('l'):
         case '\x1b':
+            cursorsClear();
+            selectionClear();
+            break;
+
+        case CTRL_KEY('g'):
+            setStatusMessage("Profiling HUD %s", perfHudToggle() ? "on" : "off");
+            break;
+
+        case CTRL_KEY('l'):
             break;
 
         default:
@@ -143,17 +257,20 @@ static void processKeypress() {
 
 int main(int argc, const char *argv[]) {
     enableRawMode();
+    atexit(perfDump);
     initEditor();
+    loadSyntaxDefinitions(syntaxDirectory());
 
     if (argc >= 2) {
         editorOpen(argv[1]);
     }
 
-    setStatusMessage("HELP:  Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find");
+    setStatusMessage("HELP:  Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find | Ctrl-R = replace");
 
     while (1) {
         refreshScreen();
         processKeypress();
+        undoCommit();
     }
     return 0;
 }
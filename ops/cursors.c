@@ -0,0 +1,416 @@
+/* Edits repeated at several cursors at once. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "cursors.h"
+#include "fold.h"
+#include "rowops.h"
+#include "utf8.h"
+#include "io/input.h"
+
+
+/*
+* While more than one cursor is active, every cursor, the editor's own
+* included, is kept here sorted by row and then column, with no two on the
+* same spot. Each keystroke is applied to all of them inside one row batch,
+* so a row is re-rendered once however many cursors are on it and the
+* batch is highlighted in a single pass.
+*/
+static struct {
+    struct cursor *at;
+    int count;
+    int capacity;
+    int primary;  // the one CONFIG.cursorX and cursorY mirror
+} CURSORS = {NULL, 0, 0, 0};
+
+
+static int same(const struct cursor *a, const struct cursor *b) {
+    return a->y == b->y && a->x == b->x;
+}
+
+
+static int before(const struct cursor *a, const struct cursor *b) {
+    return a->y < b->y || (a->y == b->y && a->x < b->x);
+}
+
+
+static void reserve(int count) {
+    if (count <= CURSORS.capacity) { return; }
+
+    CURSORS.capacity = CURSORS.capacity ? CURSORS.capacity * 2 : 16;
+    if (CURSORS.capacity < count) { CURSORS.capacity = count; }
+
+    CURSORS.at = realloc(CURSORS.at, sizeof(struct cursor) * CURSORS.capacity);
+    if (CURSORS.at == NULL) { die("realloc"); }
+}
+
+
+/* First cursor at or after c. */
+static int lowerBound(const struct cursor *c) {
+    int lo = 0;
+    int hi = CURSORS.count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (before(&CURSORS.at[mid], c)) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    return lo;
+}
+
+
+/* Adds a cursor in order unless one is already there; returns its index. */
+static int addCursor(int x, int y) {
+    struct cursor c = {x, y};
+    int at = lowerBound(&c);
+    if (at < CURSORS.count && same(&CURSORS.at[at], &c)) { return at; }
+
+    reserve(CURSORS.count + 1);
+    memmove(
+        &CURSORS.at[at + 1], &CURSORS.at[at],
+        sizeof(struct cursor) * (CURSORS.count - at)
+    );
+    CURSORS.at[at] = c;
+    CURSORS.count++;
+    if (CURSORS.primary >= at) { CURSORS.primary++; }
+    return at;
+}
+
+
+/* Merges cursors that edits or moves have brought onto the same spot. */
+static void dedupe() {
+    int out = 0;
+    for (int i = 0; i < CURSORS.count; i++) {
+        if (out && same(&CURSORS.at[out - 1], &CURSORS.at[i])) {
+            if (i == CURSORS.primary) { CURSORS.primary = out - 1; }
+            continue;
+        }
+        if (i == CURSORS.primary) { CURSORS.primary = out; }
+        CURSORS.at[out++] = CURSORS.at[i];
+    }
+    CURSORS.count = out;
+}
+
+
+/*
+* Brings the list up to date before an edit: the editor's own cursor may
+* have been moved on its own, and edits made at it alone may have left
+* other cursors past the end of their rows.
+*/
+static void begin() {
+    if (CURSORS.count == 0) {
+        reserve(1);
+        CURSORS.at[0].x = CONFIG.cursorX;
+        CURSORS.at[0].y = CONFIG.cursorY;
+        CURSORS.count = 1;
+        CURSORS.primary = 0;
+    }
+
+    struct cursor *primary = &CURSORS.at[CURSORS.primary];
+    if (primary->x != CONFIG.cursorX || primary->y != CONFIG.cursorY) {
+        memmove(
+            primary, primary + 1,
+            sizeof(struct cursor) * (CURSORS.count - CURSORS.primary - 1)
+        );
+        CURSORS.count--;
+
+        // parked past the end so adding the new one cannot shift it
+        CURSORS.primary = CURSORS.count;
+        CURSORS.primary = addCursor(CONFIG.cursorX, CONFIG.cursorY);
+    }
+
+    for (int i = 0; i < CURSORS.count; i++) {
+        struct cursor *c = &CURSORS.at[i];
+        if (c->y > CONFIG.numRows) { c->y = CONFIG.numRows; }
+
+        if (c->y == CONFIG.numRows) {
+            c->x = 0;
+            continue;
+        }
+
+        // and a cursor is never left inside a character
+        editorRow *row = &CONFIG.row[c->y];
+        if (c->x > row->rowSize) { c->x = row->rowSize; }
+        if (row->numStops) { c->x = editorRowRxToCx(row, editorRowCxToRx(row, c->x)); }
+    }
+    dedupe();
+}
+
+
+static void end() {
+    dedupe();
+    CONFIG.cursorX = CURSORS.at[CURSORS.primary].x;
+    CONFIG.cursorY = CURSORS.at[CURSORS.primary].y;
+
+    if (CURSORS.count < 2) { CURSORS.count = 0; }
+}
+
+
+int cursorsActive() {
+    return CURSORS.count > 1;
+}
+
+
+int cursorsCount() {
+    return CURSORS.count ? CURSORS.count : 1;
+}
+
+
+/* Points first at the cursors on a row, in column order; returns how many. */
+int cursorsOnRow(int row, const struct cursor **first) {
+    struct cursor c = {0, row};
+    int at = lowerBound(&c);
+
+    int n = 0;
+    while (at + n < CURSORS.count && CURSORS.at[at + n].y == row) { n++; }
+    *first = &CURSORS.at[at];
+    return n;
+}
+
+
+void cursorsClear() {
+    CURSORS.count = 0;
+}
+
+
+/* Leaves a cursor where the editor's is and moves that one a row down. */
+void cursorsAddBelow() {
+    begin();
+    moveCursorKeypress(ARROW_DOWN);
+    CURSORS.primary = addCursor(CONFIG.cursorX, CONFIG.cursorY);
+    end();
+}
+
+
+static int isWordChar(int c) {
+    return isalnum(c) || c == '_';
+}
+
+
+/*
+* Adds a cursor at every whole-word occurrence of the word under the
+* cursor, each as far into its match as the cursor is into the word.
+* Returns the number of cursors, or 0 if there is no word there.
+*/
+int cursorsAddMatches() {
+    if (CONFIG.cursorY >= CONFIG.numRows) { return 0; }
+
+    editorRow *row = &CONFIG.row[CONFIG.cursorY];
+    int start = CONFIG.cursorX;
+    int stop = CONFIG.cursorX;
+    while (start > 0 && isWordChar((unsigned char) row->characters[start - 1])) { start--; }
+    while (stop < row->rowSize && isWordChar((unsigned char) row->characters[stop])) { stop++; }
+    if (start == stop) { return 0; }
+
+    int len = stop - start;
+    int offset = CONFIG.cursorX - start;
+    char *word = malloc(len);
+    if (word == NULL) { die("malloc"); }
+    memcpy(word, &row->characters[start], len);
+
+    begin();
+
+    // matches come out in order, so the two sorted lists are merged
+    struct cursor *old = CURSORS.at;
+    int oldCount = CURSORS.count;
+    int oldPrimary = CURSORS.primary;
+    CURSORS.at = NULL;
+    CURSORS.count = 0;
+    CURSORS.capacity = 0;
+
+    // rows hidden in a fold get no cursors
+    int o = 0;
+    for (int j = 0; j < CONFIG.numRows; j = foldNext(j)) {
+        editorRow *r = &CONFIG.row[j];
+
+        for (int i = 0; i + len <= r->rowSize; i++) {
+            if (r->characters[i] != word[0] || memcmp(&r->characters[i], word, len)) { continue; }
+            if (i > 0 && isWordChar((unsigned char) r->characters[i - 1])) { continue; }
+            if (i + len < r->rowSize && isWordChar((unsigned char) r->characters[i + len])) { continue; }
+
+            struct cursor match = {i + offset, j};
+            while (o < oldCount && before(&old[o], &match)) {
+                reserve(CURSORS.count + 1);
+                if (o == oldPrimary) { CURSORS.primary = CURSORS.count; }
+                CURSORS.at[CURSORS.count++] = old[o++];
+            }
+            reserve(CURSORS.count + 1);
+            CURSORS.at[CURSORS.count++] = match;
+            i += len - 1;
+        }
+    }
+    while (o < oldCount) {
+        reserve(CURSORS.count + 1);
+        if (o == oldPrimary) { CURSORS.primary = CURSORS.count; }
+        CURSORS.at[CURSORS.count++] = old[o++];
+    }
+    free(old);
+    free(word);
+
+    end();
+    return cursorsCount();
+}
+
+
+/* Moves every cursor as the arrow key would move the editor's own. */
+void cursorsMove(int key) {
+    if (!cursorsActive()) {
+        moveCursorKeypress(key);
+        return;
+    }
+
+    begin();
+    for (int i = 0; i < CURSORS.count; i++) {
+        CONFIG.cursorX = CURSORS.at[i].x;
+        CONFIG.cursorY = CURSORS.at[i].y;
+        moveCursorKeypress(key);
+        CURSORS.at[i].x = CONFIG.cursorX;
+        CURSORS.at[i].y = CONFIG.cursorY;
+    }
+    end();
+}
+
+
+/* Length of the run of cursors on the same row as cursor i. */
+static int rowRun(int i) {
+    int j = i;
+    while (j < CURSORS.count && CURSORS.at[j].y == CURSORS.at[i].y) { j++; }
+    return j - i;
+}
+
+
+void cursorsInsertChar(int c) {
+    begin();
+
+    // every cursor past the last row has been merged into one
+    if (CURSORS.at[CURSORS.count - 1].y == CONFIG.numRows) {
+        editorInsertRow(CONFIG.numRows, "", 0);
+    }
+
+    int *cols = malloc(sizeof(int) * CURSORS.count);
+    if (cols == NULL) { die("malloc"); }
+
+    editorBeginBatch();
+    for (int i = 0; i < CURSORS.count; ) {
+        int n = rowRun(i);
+        for (int k = 0; k < n; k++) { cols[k] = CURSORS.at[i + k].x; }
+
+        editorRowInsertCharAt(&CONFIG.row[CURSORS.at[i].y], cols, n, c);
+        for (int k = 0; k < n; k++) { CURSORS.at[i + k].x += k + 1; }
+        i += n;
+    }
+    editorEndBatch();
+
+    free(cols);
+    end();
+}
+
+
+/*
+* Backspace at every cursor. Rows are worked through top down, so a row
+* joined onto the one above only moves the rows not yet visited, and those
+* are found by how many rows have been removed so far.
+*/
+void cursorsDelChar() {
+    begin();
+
+    int *cols = malloc(sizeof(int) * CURSORS.count);
+    if (cols == NULL) { die("malloc"); }
+
+    editorBeginBatch();
+    int removed = 0;
+    for (int i = 0; i < CURSORS.count; ) {
+        int n = rowRun(i);
+        int y = CURSORS.at[i].y - removed;
+        struct cursor *run = &CURSORS.at[i];
+        i += n;
+
+        for (int k = 0; k < n; k++) { run[k].y = y; }
+        if (y >= CONFIG.numRows) { continue; }
+
+        editorRow *row = &CONFIG.row[y];
+        int deleted = 0;
+        for (int k = 0; k < n; k++) {
+            if (run[k].x > 0) { cols[deleted++] = utf8Prev(row->characters, run[k].x); }
+        }
+        editorRowDelCharsAt(row, cols, deleted);
+
+        // each cursor goes back by the bytes deleted up to and at it
+        int m = 0;
+        int bytes = 0;
+        for (int k = 0; k < n; k++) {
+            if (run[k].x > 0) {
+                bytes += run[k].x - cols[m++];
+                run[k].x -= bytes;
+            }
+        }
+
+        // a cursor at the start of the row joins it onto the one above
+        if (deleted < n && y > 0) {
+            row = &CONFIG.row[y];
+            int prevLen = CONFIG.row[y - 1].rowSize;
+
+            editorRowAppendString(&CONFIG.row[y - 1], row->characters, row->rowSize);
+            editorDelRow(y);
+            for (int k = 0; k < n; k++) {
+                run[k].y = y - 1;
+                run[k].x += prevLen;
+            }
+            removed++;
+        }
+    }
+    editorEndBatch();
+
+    free(cols);
+    end();
+}
+
+
+/* Enter at every cursor; a row with several cursors splits at each. */
+void cursorsInsertNewLine() {
+    begin();
+
+    char **lines = malloc(sizeof(char *) * CURSORS.count);
+    size_t *lens = malloc(sizeof(size_t) * CURSORS.count);
+    if (lines == NULL || lens == NULL) { die("malloc"); }
+
+    editorBeginBatch();
+    int added = 0;
+    for (int i = 0; i < CURSORS.count; ) {
+        int n = rowRun(i);
+        int y = CURSORS.at[i].y + added;
+        struct cursor *run = &CURSORS.at[i];
+        i += n;
+
+        if (y >= CONFIG.numRows) {
+            editorInsertRow(CONFIG.numRows, "", 0);
+            run[0].x = 0;
+            run[0].y = y + 1;
+            added++;
+            continue;
+        }
+
+        editorRow *row = &CONFIG.row[y];
+        for (int k = 0; k < n; k++) {
+            int to = (k + 1 < n) ? run[k + 1].x : row->rowSize;
+            lines[k] = &row->characters[run[k].x];
+            lens[k] = to - run[k].x;
+        }
+        editorInsertRows(y + 1, lines, lens, n);
+
+        row = &CONFIG.row[y];
+        editorRowDelChars(row, run[0].x, row->rowSize - run[0].x);
+        for (int k = 0; k < n; k++) {
+            run[k].x = 0;
+            run[k].y = y + 1 + k;
+        }
+        added += n;
+    }
+    editorEndBatch();
+
+    free(lines);
+    free(lens);
+    end();
+}
@@ -0,0 +1,23 @@
+/* Multiple cursor headers. */
+
+#ifndef CURSORS_H
+#define CURSORS_H
+
+struct cursor {
+    int x;
+    int y;
+};
+
+int cursorsActive();
+int cursorsCount();
+int cursorsOnRow(int, const struct cursor **);
+void cursorsClear();
+void cursorsAddBelow();
+int cursorsAddMatches();
+
+void cursorsMove(int);
+void cursorsInsertChar(int);
+void cursorsDelChar();
+void cursorsInsertNewLine();
+
+#endif
@@ -1,9 +1,16 @@
 /* Handle operations on the editor. */
 
 #include "core.h"
+#include "cursors.h"
 #include "rowops.h"
+#include "utf8.h"
 
 void insertChar(int c) {
+    if (cursorsActive()) {
+        cursorsInsertChar(c);
+        return;
+    }
+
     if (CONFIG.cursorY == CONFIG.numRows) {
         editorInsertRow(CONFIG.numRows,"", 0);
     }
@@ -13,13 +20,19 @@ void insertChar(int c) {
 
 
 void delChar() {
+    if (cursorsActive()) {
+        cursorsDelChar();
+        return;
+    }
+
     if (CONFIG.cursorY == CONFIG.numRows) { return; }
     if (CONFIG.cursorX == 0 && CONFIG.cursorY == 0) { return; }
     editorRow *row = &CONFIG.row[CONFIG.cursorY];
     if (CONFIG.cursorX > 0) {
-        editorRowDelChar(row, CONFIG.cursorX - 1);
+        int start = utf8Prev(row->characters, CONFIG.cursorX);
+        editorRowDelChars(row, start, CONFIG.cursorX - start);
         // this moves the cursor along with the deletion
-        CONFIG.cursorX--;
+        CONFIG.cursorX = start;
     }
     else {
         CONFIG.cursorX = CONFIG.row[CONFIG.cursorY - 1].rowSize;
@@ -33,6 +46,11 @@ void delChar() {
 
 
 void insertNewLine() {
+    if (cursorsActive()) {
+        cursorsInsertNewLine();
+        return;
+    }
+
     if (CONFIG.cursorX == 0) {
         editorInsertRow(CONFIG.cursorY, "", 0);
     }
@@ -43,9 +61,7 @@ void insertNewLine() {
             row->rowSize - CONFIG.cursorX
         );
         row = &CONFIG.row[CONFIG.cursorY];
-        row->rowSize = CONFIG.cursorX;
-        row->characters[row->rowSize] = '\0';
-        editorUpdateRow(row);
+        editorRowDelChars(row, CONFIG.cursorX, row->rowSize - CONFIG.cursorX);
     }
     CONFIG.cursorY++;
     CONFIG.cursorX = 0;
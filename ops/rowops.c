@@ -3,17 +3,207 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "brackets.h"
 #include "core.h"
+#include "fold.h"
 #include "highlight.h"
+#include "perf.h"
+#include "undo.h"
+#include "utf8.h"
+#include "words.h"
+#include "wrap.h"
+
+/*
+* While a batch is open, rows are re-rendered immediately but only marked
+* for highlighting; the rows touched are tracked as a range so the batch
+* can be highlighted in a single ordered pass when it closes.
+*/
+static int BATCH_DEPTH = 0;
+static int BATCH_FIRST;
+static int BATCH_LAST;
+
+
+static void batchTouch(int at) {
+    if (at < BATCH_FIRST) { BATCH_FIRST = at; }
+    if (at > BATCH_LAST) { BATCH_LAST = at; }
+}
+
+
+static void batchMarkStale(int at) {
+    if (at < 0 || at >= CONFIG.numRows) { return; }
+    markSyntaxStale(at);
+    batchTouch(at);
+}
+
+
+void editorBeginBatch() {
+    if (BATCH_DEPTH++ == 0) {
+        BATCH_FIRST = CONFIG.numRows;
+        BATCH_LAST = -1;
+    }
+}
+
+
+void editorEndBatch() {
+    if (--BATCH_DEPTH > 0) { return; }
+
+    // rows below the viewport are left stale for the background worker
+    int end = foldRowsDown(CONFIG.rowOffset, CONFIG.screenRows - 1);
+    if (BATCH_LAST > end) { BATCH_LAST = end; }
+
+    if (BATCH_FIRST <= BATCH_LAST) {
+        updateSyntaxRange(BATCH_FIRST, BATCH_LAST);
+    }
+}
 
 static void editorFreerRow(editorRow *row) {
     free(row->render);
     free(row->characters);
     free(row->highlight);
+    free(row->stops);
+    free(row->wraps);
+    free(row->lex);
+    free(row->brackets);
+}
+
+
+static void addStop(editorRow *row, int *capacity, int cx, int rx, int col, int bytes, int renderBytes, int width) {
+    if (row->numStops == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 8;
+        row->stops = realloc(row->stops, sizeof(columnStop) * *capacity);
+        if (row->stops == NULL) { die("realloc"); }
+    }
+
+    columnStop *stop = &row->stops[row->numStops++];
+    stop->cx = cx;
+    stop->rx = rx;
+    stop->col = col;
+    stop->bytes = bytes;
+    stop->renderBytes = renderBytes;
+    stop->width = width;
+}
+
+
+/*
+* A row of plain ASCII renders a byte to a column, so all but its tabs is
+* copied across in runs.
+*/
+static int renderAscii(editorRow *row, int tabs) {
+    int capacity = tabs;
+    row->stops = tabs ? malloc(sizeof(columnStop) * tabs) : NULL;
+
+    int i = 0;
+    int j = 0;
+    while (j < row->rowSize) {
+        char *tab = memchr(&row->characters[j], '\t', row->rowSize - j);
+        int run = tab ? tab - &row->characters[j] : row->rowSize - j;
+
+        memcpy(&row->render[i], &row->characters[j], run);
+        i += run;
+        j += run;
+        if (tab == NULL) { break; }
+
+        int start = i;
+        row->render[i++] = ' ';
+
+        while (i % MOOSE_TAB_STOP != 0) { row->render[i++] = ' '; }
+
+        addStop(row, &capacity, j, start, start, 1, i - start, i - start);
+        j++;
+    }
+    return i;
+}
+
+
+/*
+* Any other row is decoded as UTF-8. Each sequence is copied into the
+* render as it is and takes as many columns as the character is wide; a
+* byte that is not valid UTF-8 stays a byte of its own, one column wide.
+*/
+static int renderUtf8(editorRow *row) {
+    int capacity = 0;
+    int i = 0;
+    int col = 0;
+
+    for (int j = 0; j < row->rowSize; ) {
+        unsigned char c = row->characters[j];
+
+        if (c == '\t') {
+            int width = MOOSE_TAB_STOP - col % MOOSE_TAB_STOP;
+            addStop(row, &capacity, j, i, col, 1, width, width);
+
+            memset(&row->render[i], ' ', width);
+            i += width;
+            col += width;
+            j++;
+        }
+
+        else if (c < 0x80) {
+            row->render[i++] = c;
+            col++;
+            j++;
+        }
+
+        else {
+            int cp;
+            int bytes = utf8Decode(&row->characters[j], row->rowSize - j, &cp);
+            int width = (cp < 0) ? 1 : utf8Width(cp);
+            addStop(row, &capacity, j, i, col, bytes, bytes, width);
+
+            memcpy(&row->render[i], &row->characters[j], bytes);
+            i += bytes;
+            col += width;
+            j += bytes;
+        }
+    }
+    return i;
+}
+
+
+/* Everything that follows a row's render changing. */
+static void rowRendered(editorRow *row) {
+    wrapUpdateRow(row);
+
+    if (BATCH_DEPTH) { batchMarkStale(row->index); }
+    else { updateSyntax(row); }
+}
+
+
+/*
+* Drops everything built from a row's characters, for a row hidden in a
+* fold. Its outgoing comment state stays as it was.
+*/
+void editorHideRow(editorRow *row) {
+    free(row->render);
+    row->render = NULL;
+    row->renderSize = 0;
+
+    free(row->stops);
+    row->stops = NULL;
+    row->numStops = 0;
+
+    free(row->wraps);
+    row->wraps = NULL;
+    row->numWraps = 0;
+
+    free(row->highlight);
+    row->highlight = NULL;
+    row->highlightSpans = 0;
+    highlightForget(row);
 }
 
 
 void editorUpdateRow(editorRow *row) {
+    unsigned long long start = perfStart(PERF_UPDATE_ROW);
+
+    // a hidden row is rendered once its fold opens
+    if (foldHidden(row->index)) {
+        editorHideRow(row);
+        rowRendered(row);
+        perfStop(PERF_UPDATE_ROW, start);
+        return;
+    }
+
     int tabs = 0;
     int j;
 
@@ -23,136 +213,558 @@ void editorUpdateRow(editorRow *row) {
 
     free(row->render);
     row->render = malloc(row->rowSize + tabs * (MOOSE_TAB_STOP - 1) + 1);
+    perfCount(PERF_ALLOCATIONS, 1);
 
-    int i = 0;
-
-    for (j = 0; j < row->rowSize; j++) {
-        if (row->characters[j] == '\t') {
-            row->render[i++] = ' ';
+    free(row->stops);
+    row->stops = NULL;
+    row->numStops = 0;
 
-            while (i % MOOSE_TAB_STOP != 0) { row->render[i++] = ' '; }
-        }
+    // the vectorised check keeps rows of plain ASCII on the fast path
+    int i = utf8IsAscii(row->characters, row->rowSize)
+        ? renderAscii(row, tabs) : renderUtf8(row);
 
-        else {
-            row->render[i++] = row->characters[j];
-        }
-    }
     row->render[i] = '\0';
     row->renderSize = i;
+    highlightForget(row);
+    rowRendered(row);
+    perfStop(PERF_UPDATE_ROW, start);
+}
 
-    updateSyntax(row);
+
+/* Renders the rows in [first, last] left hidden by a fold that was dropped. */
+static void renderExposed(int first, int last) {
+    for (int j = first; j <= last; j++) {
+        if (CONFIG.row[j].render == NULL) { editorUpdateRow(&CONFIG.row[j]); }
+    }
 }
 
 
-void editorDelRow(int at) {
-    if (at < 0 || at >= CONFIG.numRows) { return; }
-    editorFreerRow(&CONFIG.row[at]);
+/*
+* Removes count rows at once. If lines is given the rows' text is handed
+* over in it rather than freed, and the number of rows taken is returned.
+*/
+static int removeRows(int at, int count, char **lines, size_t *lens) {
+    if (at < 0 || count <= 0 || at >= CONFIG.numRows) { return 0; }
+    if (count > CONFIG.numRows - at) { count = CONFIG.numRows - at; }
+    wordsRowsRemoved(at, count);
+
+    for (int j = at; j < at + count; j++) {
+        editorRow *row = &CONFIG.row[j];
+        undoRecordDeleteRow(at, row->characters, row->rowSize);
+
+        if (lines) {
+            lines[j - at] = row->characters;
+            lens[j - at] = row->rowSize;
+            row->characters = NULL;
+        }
+        editorFreerRow(row);
+    }
 
-    memmove(&CONFIG.row[at], &CONFIG.row[at + 1],
-        sizeof(editorRow) * (CONFIG.numRows - at - 1)
+    memmove(&CONFIG.row[at], &CONFIG.row[at + count],
+        sizeof(editorRow) * (CONFIG.numRows - at - count)
     );
-    for (int j = at; j <= CONFIG.numRows - 1; j++) { CONFIG.row[j].index--; }
-    CONFIG.numRows--;
+    CONFIG.numRows -= count;
+    for (int j = at; j < CONFIG.numRows; j++) { CONFIG.row[j].index -= count; }
+    wrapRowsMoved();
+    bracketsRowsMoved();
     CONFIG.dirty++;
 
+    int first, last;
+    int exposed = foldRowsRemoved(at, count, &first, &last);
+
+    if (CONFIG.highlightFrontier > at + count) { CONFIG.highlightFrontier -= count; }
+    else if (CONFIG.highlightFrontier > at) { CONFIG.highlightFrontier = at; }
+
+    // the row that moved up now follows a different row
+    if (BATCH_DEPTH) {
+        if (BATCH_LAST >= at + count) { BATCH_LAST -= count; }
+        else if (BATCH_LAST > at) { BATCH_LAST = at; }
+        batchMarkStale(at);
+    }
+    else { markSyntaxStale(at); }
+
+    if (exposed) { renderExposed(first, last); }
+    return count;
 }
 
 
-void editorRowAppendString(editorRow *row, char *s, size_t len) {
-    row->characters = realloc(row->characters, row->rowSize + len + 1);
-    memcpy(&row->characters[row->rowSize], s, len);
+void editorDelRows(int at, int count) {
+    removeRows(at, count, NULL, NULL);
+}
 
-    row->rowSize += len;
-    row->characters[row->rowSize] = '\0';
-    editorUpdateRow(row);
-    CONFIG.dirty++;
+
+int editorTakeRows(int at, int count, char **lines, size_t *lens) {
+    return removeRows(at, count, lines, lens);
 }
 
 
-int editorRowCxToRx(editorRow *row, int cursorX) {
-    int rx = 0;
-    int j;
+void editorDelRow(int at) {
+    editorDelRows(at, 1);
+}
 
-    for (j = 0; j < cursorX; j++) {
-        if (row->characters[j] == '\t') {
-            rx += (MOOSE_TAB_STOP - 1) - (rx % MOOSE_TAB_STOP);        
-        }
-        rx++;
+
+enum columnKind {
+    COLUMN_CX,
+    COLUMN_RX,
+    COLUMN_COL
+};
+
+
+static int stopStart(const columnStop *stop, int kind) {
+    if (kind == COLUMN_CX) { return stop->cx; }
+    return (kind == COLUMN_RX) ? stop->rx : stop->col;
+}
+
+
+static int stopSize(const columnStop *stop, int kind) {
+    if (kind == COLUMN_CX) { return stop->bytes; }
+    return (kind == COLUMN_RX) ? stop->renderBytes : stop->width;
+}
+
+
+/* Number of column stops starting at or before column at. */
+static int stopsUpTo(editorRow *row, int at, int kind) {
+    int lo = 0;
+    int hi = row->numStops;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (stopStart(&row->stops[mid], kind) <= at) { lo = mid + 1; }
+        else { hi = mid; }
     }
-    return rx;
+    return lo;
+}
+
+
+/*
+* Converts column at of one kind to another. Between column stops every
+* character is one byte in one column, so only the last stop starting at
+* or before the column is needed; a column inside a character maps to
+* where that character starts.
+*/
+static int convertColumn(editorRow *row, int at, int from, int to) {
+    int k = stopsUpTo(row, at, from);
+    if (k == 0) { return at; }
+
+    columnStop *stop = &row->stops[k - 1];
+    int past = at - stopStart(stop, from) - stopSize(stop, from);
+    if (past < 0) { return stopStart(stop, to); }
+    return stopStart(stop, to) + stopSize(stop, to) + past;
+}
+
+
+int editorRowCxToRx(editorRow *row, int cursorX) {
+    return convertColumn(row, cursorX, COLUMN_CX, COLUMN_RX);
 }
 
 
 int editorRowRxToCx(editorRow *row, int rx) {
-    int cur_rx = 0;
-    int cx;
+    if (rx <= 0) { return 0; }
+
+    int cx = convertColumn(row, rx, COLUMN_RX, COLUMN_CX);
+    if (cx > row->rowSize) { cx = row->rowSize; }
+    return cx;
+}
+
+
+/* Screen column, counted from the start of the row, of render column rx. */
+int editorRowRxToCol(editorRow *row, int rx) {
+    return convertColumn(row, rx, COLUMN_RX, COLUMN_COL);
+}
+
+
+/* Render column of the character on screen column col of the row. */
+int editorRowColToRx(editorRow *row, int col) {
+    return convertColumn(row, col, COLUMN_COL, COLUMN_RX);
+}
+
+
+/* Render column just past the character that render column rx is in. */
+int editorRowRxCharEnd(editorRow *row, int rx) {
+    int k = stopsUpTo(row, rx, COLUMN_RX);
+    if (k > 0) {
+        columnStop *stop = &row->stops[k - 1];
+        if (rx < stop->rx + stop->renderBytes) { return stop->rx + stop->renderBytes; }
+    }
+    return rx + 1;
+}
+
+
+/* Whether byte at of the row was where a character started, before an edit. */
+static int wasCharStart(editorRow *row, int at) {
+    int k = stopsUpTo(row, at, COLUMN_CX);
+    if (k == 0) { return 1; }
+
+    columnStop *stop = &row->stops[k - 1];
+    return at == stop->cx || at >= stop->cx + stop->bytes;
+}
+
+
+/*
+* Re-renders only the characters an edit of a long row touched. Past
+* them the old render is moved along as it is, and so are the stops.
+* Only the first tab after the edit can change width; past it everything
+* is a whole number of tab stops from where it was. Before the edit only
+* stray bytes of broken UTF-8 can change, as the new text may complete
+* them.
+*
+* The row's characters already have removed bytes at at replaced by
+* inserted ones, while its render and stops are still the old ones.
+*/
+static void updateRowSlice(editorRow *row, int at, int removed, int inserted) {
+    int shiftCx = inserted - removed;
+
+    int from = at;
+    int k = stopsUpTo(row, at, COLUMN_CX);
+    if (k > 0 && at < row->stops[k - 1].cx + row->stops[k - 1].bytes) { from = row->stops[k - 1].cx; }
+
+    for (int n = 0; n < 3 && from > 0; n++) {
+        k = stopsUpTo(row, from - 1, COLUMN_CX);
+        if (k == 0) { break; }
+
+        columnStop *stop = &row->stops[k - 1];
+        int stray = stop->bytes == 1 && (unsigned char) row->characters[stop->cx] >= 0x80;
+        if (!stray || stop->cx + 1 != from) { break; }
+        from = stop->cx;
+    }
+
+    int keep = stopsUpTo(row, from - 1, COLUMN_CX);
+    int rxFrom = convertColumn(row, from, COLUMN_CX, COLUMN_RX);
+
+    // render the new characters until they line up with the old ones again
+    editorRow slice = {0};
+    int capacity = 0;
+    int size = 0;
+    int room = 64;
+    slice.render = malloc(room);
+    if (slice.render == NULL) { die("malloc"); }
+
+    int j = from;
+    int rx = rxFrom;
+    int col = convertColumn(row, from, COLUMN_CX, COLUMN_COL);
+    while (j < at + inserted || !wasCharStart(row, j - shiftCx)) {
+        if (size + MOOSE_TAB_STOP > room) {
+            room *= 2;
+            slice.render = realloc(slice.render, room);
+            if (slice.render == NULL) { die("realloc"); }
+        }
+        unsigned char c = row->characters[j];
+
+        if (c == '\t') {
+            int width = MOOSE_TAB_STOP - col % MOOSE_TAB_STOP;
+            addStop(&slice, &capacity, j, rx, col, 1, width, width);
 
-    for (cx = 0; cx < row->rowSize; cx++) {
-        if (row->characters[cx] == '\t') {
-            cur_rx += (MOOSE_TAB_STOP - 1) - (cur_rx % MOOSE_TAB_STOP);
+            memset(&slice.render[size], ' ', width);
+            size += width;
+            rx += width;
+            col += width;
+            j++;
         }
-        cur_rx++;
 
-        if (cur_rx > rx) { return cx; }
+        else if (c < 0x80) {
+            slice.render[size++] = c;
+            rx++;
+            col++;
+            j++;
+        }
+
+        else {
+            int cp;
+            int bytes = utf8Decode(&row->characters[j], row->rowSize - j, &cp);
+            int width = (cp < 0) ? 1 : utf8Width(cp);
+            addStop(&slice, &capacity, j, rx, col, bytes, bytes, width);
+
+            memcpy(&slice.render[size], &row->characters[j], bytes);
+            size += bytes;
+            rx += bytes;
+            col += width;
+            j += bytes;
+        }
     }
-    return cx;
+
+    int q = j - shiftCx;
+    int shiftRx = rx - convertColumn(row, q, COLUMN_CX, COLUMN_RX);
+    int shiftCol = col - convertColumn(row, q, COLUMN_CX, COLUMN_COL);
+    int moved = stopsUpTo(row, q - 1, COLUMN_CX);
+
+    // the first tab after the edit, if it changes width
+    int tab = -1;
+    if (shiftCol % MOOSE_TAB_STOP != 0) {
+        for (k = moved; k < row->numStops; k++) {
+            if (row->characters[row->stops[k].cx + shiftCx] == '\t') {
+                tab = k;
+                break;
+            }
+        }
+    }
+
+    int oldSize = row->renderSize;
+    int tabRx = oldSize;
+    int oldWidth = 0;
+    int newWidth = 0;
+    if (tab >= 0) {
+        tabRx = row->stops[tab].rx;
+        oldWidth = row->stops[tab].width;
+        newWidth = MOOSE_TAB_STOP - (row->stops[tab].col + shiftCol) % MOOSE_TAB_STOP;
+    }
+    int shiftTail = shiftRx + newWidth - oldWidth;
+    int newSize = oldSize + shiftTail;
+
+    if (newSize > oldSize) {
+        row->render = realloc(row->render, newSize + 1);
+        if (row->render == NULL) { die("realloc"); }
+    }
+
+    // move whichever part is going right first, so neither overwrites the other
+    int rxQ = rx - shiftRx;
+    int tailRx = tabRx + oldWidth;
+    if (shiftRx > 0 && tab >= 0) {
+        memmove(&row->render[tailRx + shiftTail], &row->render[tailRx], oldSize - tailRx);
+    }
+    memmove(&row->render[rxQ + shiftRx], &row->render[rxQ], tabRx - rxQ);
+    if (shiftRx <= 0 && tab >= 0) {
+        memmove(&row->render[tailRx + shiftTail], &row->render[tailRx], oldSize - tailRx);
+    }
+    memset(&row->render[tabRx + shiftRx], ' ', newWidth);
+    memcpy(&row->render[rxFrom], slice.render, size);
+    row->render[newSize] = '\0';
+    row->renderSize = newSize;
+
+    // the stops likewise
+    int tail = row->numStops - moved;
+    int numStops = keep + slice.numStops + tail;
+    if (numStops > row->numStops) {
+        row->stops = realloc(row->stops, sizeof(columnStop) * numStops);
+        if (row->stops == NULL) { die("realloc"); }
+    }
+    if (tail) {
+        memmove(&row->stops[keep + slice.numStops], &row->stops[moved], sizeof(columnStop) * tail);
+    }
+
+    for (k = 0; k < tail; k++) {
+        columnStop *stop = &row->stops[keep + slice.numStops + k];
+        stop->cx += shiftCx;
+
+        if (tab < 0 || moved + k < tab) {
+            stop->rx += shiftRx;
+            stop->col += shiftCol;
+        }
+        else if (moved + k == tab) {
+            stop->rx += shiftRx;
+            stop->col += shiftCol;
+            stop->renderBytes = newWidth;
+            stop->width = newWidth;
+        }
+        else {
+            stop->rx += shiftTail;
+            stop->col += shiftCol + newWidth - oldWidth;
+        }
+    }
+    if (slice.numStops) {
+        memcpy(&row->stops[keep], slice.stops, sizeof(columnStop) * slice.numStops);
+    }
+    row->numStops = numStops;
+
+    free(slice.render);
+    free(slice.stops);
+
+    if (tab >= 0) { highlightRowEdited(row, rxFrom, tailRx, tailRx + shiftTail); }
+    else { highlightRowEdited(row, rxFrom, rxQ, rx); }
+    rowRendered(row);
 }
 
 
-void editorRowInsertChar(editorRow *row, int at, int c) {
+/*
+* Re-renders a row after removed bytes at at were replaced by inserted
+* ones: long rows just the part that changed, others whole.
+*/
+static void updateRowEdit(editorRow *row, int at, int removed, int inserted) {
+    if (row->rowSize >= MOOSE_LONG_ROW && row->render) { updateRowSlice(row, at, removed, inserted); }
+    else { editorUpdateRow(row); }
+}
+
+
+void editorRowInsertChars(editorRow *row, int at, const char *s, size_t len) {
     if (at < 0 || at > row->rowSize) { at = row->rowSize; }
+    undoRecordInsertChars(row->index, at, s, len);
+    wordsForget(row, at, 0);
 
-    row->characters = realloc(row->characters, row->rowSize + 2);
+    row->characters = realloc(row->characters, row->rowSize + len + 1);
     memmove(
-        &row->characters[at + 1], &row->characters[at],
+        &row->characters[at + len], &row->characters[at],
         row->rowSize - at + 1
     );
-    row->rowSize++;
-    row->characters[at] = c;
-    editorUpdateRow(row);
+    memcpy(&row->characters[at], s, len);
+    row->rowSize += len;
+    wordsLearn(row, at, len);
+    updateRowEdit(row, at, 0, len);
 
     CONFIG.dirty++;
 }
 
 
-void editorRowDelChar(editorRow *row, int at) {
-    if (at < 0 || at >= row->rowSize) { return; }
+void editorRowAppendString(editorRow *row, char *s, size_t len) {
+    editorRowInsertChars(row, row->rowSize, s, len);
+}
+
+
+void editorRowInsertChar(editorRow *row, int at, int c) {
+    char ch = c;
+    editorRowInsertChars(row, at, &ch, 1);
+}
+
+
+void editorRowDelChars(editorRow *row, int at, int len) {
+    if (at < 0 || at >= row->rowSize || len <= 0) { return; }
+    if (len > row->rowSize - at) { len = row->rowSize - at; }
+    undoRecordDeleteChars(row->index, at, &row->characters[at], len);
+    wordsForget(row, at, len);
 
     memmove(
-        &row->characters[at], &row->characters[at + 1],
-        row->rowSize - at
+        &row->characters[at], &row->characters[at + len],
+        row->rowSize - at - len + 1
     );
-    row->rowSize--;
+    row->rowSize -= len;
+    wordsLearn(row, at, 0);
+    updateRowEdit(row, at, len, 0);
+
+    CONFIG.dirty++;
+}
+
+
+void editorRowDelChar(editorRow *row, int at) {
+    editorRowDelChars(row, at, 1);
+}
+
+
+/*
+* Inserts c before each of n ascending columns of a row, re-rendering the
+* row once however many cursors are on it.
+*/
+void editorRowInsertCharAt(editorRow *row, const int *cols, int n, int c) {
+    char ch = c;
+    char *chars = malloc(row->rowSize + n + 1);
+    if (chars == NULL) { die("malloc"); }
+
+    char *p = chars;
+    int from = 0;
+    for (int k = 0; k < n; k++) {
+        int at = cols[k];
+        if (at < from) { at = from; }
+        if (at > row->rowSize) { at = row->rowSize; }
+
+        memcpy(p, &row->characters[from], at - from);
+        p += at - from;
+        undoRecordInsertChars(row->index, p - chars, &ch, 1);
+        *p++ = ch;
+        from = at;
+    }
+    memcpy(p, &row->characters[from], row->rowSize - from + 1);
+
+    wordsForget(row, 0, row->rowSize);
+    free(row->characters);
+    row->characters = chars;
+    row->rowSize += n;
+    wordsLearn(row, 0, row->rowSize);
     editorUpdateRow(row);
 
     CONFIG.dirty++;
 }
 
 
-void editorInsertRow(int at, char *s, size_t len) {
-    if (at < 0 || at > CONFIG.numRows) { return; }
+/*
+* Deletes the character, however many bytes of UTF-8 it takes, at each of
+* n ascending, distinct columns at once.
+*/
+void editorRowDelCharsAt(editorRow *row, const int *cols, int n) {
+    char *p = row->characters;
+    int from = 0;
+    int deleted = 0;
+
+    for (int k = 0; k < n; k++) {
+        int at = cols[k];
+        if (at < from || at >= row->rowSize) { continue; }
+        if (deleted == 0) { wordsForget(row, 0, row->rowSize); }
+
+        int cp;
+        int len = utf8Decode(&row->characters[at], row->rowSize - at, &cp);
+
+        memmove(p, &row->characters[from], at - from);
+        p += at - from;
+        undoRecordDeleteChars(row->index, at - deleted, &row->characters[at], len);
+        deleted += len;
+        from = at + len;
+    }
+    if (deleted == 0) { return; }
+
+    memmove(p, &row->characters[from], row->rowSize - from + 1);
+    row->rowSize -= deleted;
+    wordsLearn(row, 0, row->rowSize);
+    editorUpdateRow(row);
+
+    CONFIG.dirty++;
+}
+
+
+/* Inserts count rows at once, moving the rows below only once. */
+void editorInsertRows(int at, char **lines, size_t *lens, int count) {
+    if (at < 0 || at > CONFIG.numRows || count <= 0) { return; }
 
-    CONFIG.row = realloc(CONFIG.row, sizeof(editorRow) * (CONFIG.numRows + 1));
+    CONFIG.row = realloc(CONFIG.row, sizeof(editorRow) * (CONFIG.numRows + count));
     memmove(
-        &CONFIG.row[at + 1], &CONFIG.row[at],
+        &CONFIG.row[at + count], &CONFIG.row[at],
         sizeof(editorRow) * (CONFIG.numRows - at)
     );
-    for (int j = at + 1; j <= CONFIG.numRows; j++) { CONFIG.row[j].index++; }
-
-    CONFIG.row[at].index = at;
-    CONFIG.row[at].rowSize = len;
-    CONFIG.row[at].characters = malloc(len + 1);
+    for (int j = at + count; j < CONFIG.numRows + count; j++) { CONFIG.row[j].index += count; }
+    wrapRowsMoved();
+    bracketsRowsMoved();
+
+    int first, last;
+    int exposed = foldRowsInserted(at, count, &first, &last);
+
+    if (BATCH_DEPTH && BATCH_LAST >= at) { BATCH_LAST += count; }
+    if (CONFIG.highlightFrontier > at) { CONFIG.highlightFrontier += count; }
+    CONFIG.numRows += count;
+
+    for (int r = 0; r < count; r++) {
+        editorRow *row = &CONFIG.row[at + r];
+        size_t len = lens[r];
+        undoRecordInsertRow(at + r, lines[r], len);
+
+        row->index = at + r;
+        row->rowSize = len;
+        row->characters = malloc(len + 1);
+        perfCount(PERF_ALLOCATIONS, 1);
+        memcpy(row->characters, lines[r], len);
+        row->characters[len] = '\0';
+
+        row->renderSize = 0;
+        row->render = NULL;
+        row->stops = NULL;
+        row->numStops = 0;
+        row->wraps = NULL;
+        row->numWraps = 0;
+        row->highlight = NULL;
+        row->highlightSpans = 0;
+        row->highlight_open_comment = 0;
+        row->highlight_stale = 0;
+        row->lex = NULL;
+        row->brackets = NULL;
+    }
 
-    memcpy(CONFIG.row[at].characters, s, len);
+    wordsRowsInserted(at, count);
 
-    CONFIG.row[at].characters[len] = '\0';
+    // only once every new row is set up, as updating one may highlight the next
+    for (int r = 0; r < count; r++) { editorUpdateRow(&CONFIG.row[at + r]); }
 
-    CONFIG.row[at].renderSize = 0;
-    CONFIG.row[at].render = NULL;
-    CONFIG.row[at].highlight = NULL;
-    CONFIG.row[at].highlight_open_comment = 0;
-    editorUpdateRow(&CONFIG.row[at]);
+    // and the row it pushed down follows it now
+    if (BATCH_DEPTH) { batchMarkStale(at + count); }
+    else { markSyntaxStale(at + count); }
 
-    CONFIG.numRows++;
+    if (exposed) { renderExposed(first, last); }
     CONFIG.dirty++;
 }
+
+
+void editorInsertRow(int at, char *s, size_t len) {
+    editorInsertRows(at, &s, &len, 1);
+}
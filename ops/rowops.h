@@ -4,13 +4,26 @@
 
 #include "core.h"
 
+void editorBeginBatch();
+void editorEndBatch();
 void editorInsertRow(int, char *, size_t);
+void editorInsertRows(int, char **, size_t *, int);
 void editorUpdateRow(editorRow *);
+void editorHideRow(editorRow *);
 int editorRowCxToRx(editorRow *, int);
 int editorRowRxToCx(editorRow *, int);
+int editorRowRxToCol(editorRow *, int);
+int editorRowColToRx(editorRow *, int);
+int editorRowRxCharEnd(editorRow *, int);
 void editorRowInsertChar(editorRow *, int, int);
+void editorRowInsertChars(editorRow *, int, const char *, size_t);
+void editorRowInsertCharAt(editorRow *, const int *, int, int);
 void editorRowDelChar(editorRow *, int);
+void editorRowDelChars(editorRow *, int, int);
+void editorRowDelCharsAt(editorRow *, const int *, int);
 void editorDelRow(int);
+void editorDelRows(int, int);
+int editorTakeRows(int, int, char **, size_t *);
 void editorRowAppendString(editorRow *, char *, size_t);
 
 #endif
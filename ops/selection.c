@@ -0,0 +1,239 @@
+/* Selection, and cut, copy and paste through an internal clipboard. */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "rowops.h"
+#include "selection.h"
+#include "undo.h"
+
+
+/* The selection runs between the mark and the cursor, either way round. */
+static struct {
+    int active;
+    int x;
+    int y;
+} MARK = {0, 0, 0};
+
+
+/*
+* Lines cut or copied. A cut hands the text of the rows it removes whole
+* straight over, so only its first line, which starts part way into a row,
+* is copied.
+*/
+static struct {
+    char **lines;
+    size_t *lens;
+    int count;
+} CLIPBOARD = {NULL, NULL, 0};
+
+
+static void clipboardFree() {
+    for (int k = 0; k < CLIPBOARD.count; k++) { free(CLIPBOARD.lines[k]); }
+    free(CLIPBOARD.lines);
+    free(CLIPBOARD.lens);
+
+    CLIPBOARD.lines = NULL;
+    CLIPBOARD.lens = NULL;
+    CLIPBOARD.count = 0;
+}
+
+
+static void clipboardReserve(int count) {
+    clipboardFree();
+
+    CLIPBOARD.lines = malloc(sizeof(char *) * count);
+    CLIPBOARD.lens = malloc(sizeof(size_t) * count);
+    if (CLIPBOARD.lines == NULL || CLIPBOARD.lens == NULL) { die("malloc"); }
+    CLIPBOARD.count = count;
+}
+
+
+static char *copyOf(const char *s, size_t len) {
+    char *copy = malloc(len ? len : 1);
+    if (copy == NULL) { die("malloc"); }
+    memcpy(copy, s, len);
+    return copy;
+}
+
+
+/* Moves a position onto the text; past the last row is the end of it. */
+static void clamp(int *x, int *y) {
+    if (*y >= CONFIG.numRows) {
+        *y = CONFIG.numRows ? CONFIG.numRows - 1 : 0;
+        *x = INT_MAX;
+    }
+
+    int len = (*y < CONFIG.numRows) ? CONFIG.row[*y].rowSize : 0;
+    if (*x > len) { *x = len; }
+}
+
+
+/*
+* Fills in the start and end of the selection, start first. Returns 0 if
+* nothing is selected.
+*/
+int selectionRange(int *sx, int *sy, int *ex, int *ey) {
+    if (!MARK.active) { return 0; }
+
+    int mx = MARK.x;
+    int my = MARK.y;
+    int cx = CONFIG.cursorX;
+    int cy = CONFIG.cursorY;
+    clamp(&mx, &my);
+    clamp(&cx, &cy);
+
+    if (my < cy || (my == cy && mx <= cx)) {
+        *sx = mx; *sy = my; *ex = cx; *ey = cy;
+    }
+    else {
+        *sx = cx; *sy = cy; *ex = mx; *ey = my;
+    }
+    return *sx != *ex || *sy != *ey;
+}
+
+
+void selectionToggle() {
+    MARK.active = !MARK.active;
+    MARK.x = CONFIG.cursorX;
+    MARK.y = CONFIG.cursorY;
+}
+
+
+void selectionClear() {
+    MARK.active = 0;
+}
+
+
+void selectionCopy() {
+    int sx, sy, ex, ey;
+    if (!selectionRange(&sx, &sy, &ex, &ey)) { return; }
+    clipboardReserve(ey - sy + 1);
+
+    for (int j = sy; j <= ey; j++) {
+        editorRow *row = &CONFIG.row[j];
+        int from = (j == sy) ? sx : 0;
+        int to = (j == ey) ? ex : row->rowSize;
+
+        CLIPBOARD.lines[j - sy] = copyOf(&row->characters[from], to - from);
+        CLIPBOARD.lens[j - sy] = to - from;
+    }
+    MARK.active = 0;
+}
+
+
+/*
+* Removes the selection: the rows it covers whole and the last, partly
+* covered one go in a single splice of the row array, and the rest of the
+* last row is joined onto the first. If cut is set the removed text goes
+* to the clipboard.
+*/
+static void deleteSelection(int cut) {
+    int sx, sy, ex, ey;
+    if (!selectionRange(&sx, &sy, &ex, &ey)) { return; }
+    if (cut) { clipboardReserve(ey - sy + 1); }
+
+    editorBeginBatch();
+    editorRow *first = &CONFIG.row[sy];
+
+    if (sy == ey) {
+        if (cut) {
+            CLIPBOARD.lines[0] = copyOf(&first->characters[sx], ex - sx);
+            CLIPBOARD.lens[0] = ex - sx;
+        }
+        editorRowDelChars(first, sx, ex - sx);
+    }
+    else {
+        editorRow *last = &CONFIG.row[ey];
+        int tailLen = last->rowSize - ex;
+        char *tail = copyOf(&last->characters[ex], tailLen);
+
+        if (cut) {
+            CLIPBOARD.lines[0] = copyOf(&first->characters[sx], first->rowSize - sx);
+            CLIPBOARD.lens[0] = first->rowSize - sx;
+
+            // the last line keeps just the part that was selected
+            editorTakeRows(sy + 1, ey - sy, &CLIPBOARD.lines[1], &CLIPBOARD.lens[1]);
+            CLIPBOARD.lens[ey - sy] = ex;
+        }
+        else {
+            editorDelRows(sy + 1, ey - sy);
+        }
+
+        first = &CONFIG.row[sy];
+        editorRowDelChars(first, sx, first->rowSize - sx);
+        editorRowInsertChars(first, sx, tail, tailLen);
+        free(tail);
+    }
+    editorEndBatch();
+
+    CONFIG.cursorX = sx;
+    CONFIG.cursorY = sy;
+    MARK.active = 0;
+}
+
+
+void selectionCut() {
+    undoSeal();
+    deleteSelection(1);
+    undoSeal();
+}
+
+
+/*
+* Inserts the clipboard at the cursor, replacing any selection. Every line
+* after the first goes in as one splice of the row array.
+*/
+void selectionPaste() {
+    if (CLIPBOARD.count == 0) { return; }
+
+    undoSeal();
+    editorBeginBatch();
+    deleteSelection(0);
+
+    if (CONFIG.cursorY == CONFIG.numRows) {
+        editorInsertRow(CONFIG.numRows, "", 0);
+    }
+
+    int n = CLIPBOARD.count;
+    editorRow *row = &CONFIG.row[CONFIG.cursorY];
+    int x = CONFIG.cursorX;
+    if (x > row->rowSize) { x = row->rowSize; }
+
+    if (n == 1) {
+        editorRowInsertChars(row, x, CLIPBOARD.lines[0], CLIPBOARD.lens[0]);
+        CONFIG.cursorX = x + CLIPBOARD.lens[0];
+    }
+    else {
+        // the rest of the cursor's row ends up after the last line
+        int tailLen = row->rowSize - x;
+        size_t lastLen = CLIPBOARD.lens[n - 1];
+        char *last = malloc(lastLen + tailLen + 1);
+        if (last == NULL) { die("malloc"); }
+        memcpy(last, CLIPBOARD.lines[n - 1], lastLen);
+        memcpy(&last[lastLen], &row->characters[x], tailLen);
+
+        char **lines = malloc(sizeof(char *) * (n - 1));
+        size_t *lens = malloc(sizeof(size_t) * (n - 1));
+        if (lines == NULL || lens == NULL) { die("malloc"); }
+        memcpy(lines, &CLIPBOARD.lines[1], sizeof(char *) * (n - 2));
+        memcpy(lens, &CLIPBOARD.lens[1], sizeof(size_t) * (n - 2));
+        lines[n - 2] = last;
+        lens[n - 2] = lastLen + tailLen;
+
+        editorRowDelChars(row, x, tailLen);
+        editorRowInsertChars(row, x, CLIPBOARD.lines[0], CLIPBOARD.lens[0]);
+        editorInsertRows(CONFIG.cursorY + 1, lines, lens, n - 1);
+
+        free(lines);
+        free(lens);
+        free(last);
+
+        CONFIG.cursorY += n - 1;
+        CONFIG.cursorX = lastLen;
+    }
+    editorEndBatch();
+    undoSeal();
+}
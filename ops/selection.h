@@ -0,0 +1,14 @@
+/* Selection and clipboard headers. */
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+int selectionRange(int *, int *, int *, int *);
+void selectionToggle();
+void selectionClear();
+
+void selectionCopy();
+void selectionCut();
+void selectionPaste();
+
+#endif
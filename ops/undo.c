@@ -0,0 +1,474 @@
+/* Undo and redo over a log of row edits. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "rowops.h"
+#include "undo.h"
+
+
+enum undoKind {
+    UNDO_INSERT_CHARS,
+    UNDO_DELETE_CHARS,
+    UNDO_INSERT_ROWS,
+    UNDO_DELETE_ROWS
+};
+
+
+/*
+* An op is one edit as it was made. The text it inserted or removed lives
+* in a shared pool; row ops keep all their rows there back to back, each
+* prefixed with its length, so a run of rows inserted or deleted at the
+* same place is a single op however many rows it covers.
+*/
+struct undoOp {
+    unsigned char kind;
+    int row;
+    int at;     // column, for character ops
+    int count;  // rows, for row ops
+
+    size_t text;
+    size_t len;
+};
+
+
+/* The ops one keypress made, undone and redone together. */
+struct undoGroup {
+    size_t first;  // first op
+
+    int cursorX;  // where the cursor was before the edit
+    int cursorY;
+    int afterX;   // and after it
+    int afterY;
+};
+
+
+/*
+* Groups below done have been applied and can be undone, the ones from
+* done on were undone and can be redone. The log is trimmed from the
+* oldest group once it outgrows limit.
+*/
+static struct {
+    struct undoOp *ops;
+    size_t numOps;
+    size_t opsCapacity;
+
+    struct undoGroup *groups;
+    size_t numGroups;
+    size_t groupsCapacity;
+
+    char *text;
+    size_t textLen;
+    size_t textCapacity;
+
+    size_t done;
+    int open;        // the last group is still taking ops
+    int sealed;      // the last group takes no more typing
+    int suspended;
+    int discarding;  // the open group outgrew the limit and is dropped
+
+    size_t limit;
+} UNDO = {NULL, 0, 0, NULL, 0, 0, NULL, 0, 0, 0, 0, 0, 0, 0, 0};
+
+
+static size_t undoLimit() {
+    static int read = 0;
+    if (read) { return UNDO.limit; }
+
+    // MOOSE_UNDO_MB overrides the compiled in cap; 0 turns undo off
+    char *mb = getenv("MOOSE_UNDO_MB");
+    UNDO.limit = mb ? (size_t) atol(mb) << 20 : MOOSE_UNDO_LIMIT;
+    read = 1;
+    return UNDO.limit;
+}
+
+
+size_t undoMemory() {
+    return UNDO.textLen
+        + UNDO.numOps * sizeof(struct undoOp)
+        + UNDO.numGroups * sizeof(struct undoGroup);
+}
+
+
+static void *grow(void *p, size_t *capacity, size_t needed, size_t size) {
+    if (needed <= *capacity) { return p; }
+
+    size_t capacity_ = *capacity ? *capacity : 16;
+    while (capacity_ < needed) { capacity_ *= 2; }
+
+    p = realloc(p, capacity_ * size);
+    if (p == NULL) { die("realloc"); }
+    *capacity = capacity_;
+    return p;
+}
+
+
+static void textAppend(const char *s, size_t len) {
+    UNDO.text = grow(UNDO.text, &UNDO.textCapacity, UNDO.textLen + len, 1);
+    memcpy(&UNDO.text[UNDO.textLen], s, len);
+    UNDO.textLen += len;
+}
+
+
+/* Row lengths are stored seven bits at a time, low bits first. */
+static void textAppendLength(size_t len) {
+    char buf[10];
+    int n = 0;
+
+    do {
+        buf[n++] = (len & 0x7f) | (len > 0x7f ? 0x80 : 0);
+        len >>= 7;
+    } while (len);
+    textAppend(buf, n);
+}
+
+
+static size_t textLength(const char **p) {
+    size_t len = 0;
+    int shift = 0;
+
+    unsigned char c;
+    do {
+        c = *(*p)++;
+        len |= (size_t) (c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return len;
+}
+
+
+void undoReset() {
+    UNDO.numOps = 0;
+    UNDO.numGroups = 0;
+    UNDO.textLen = 0;
+    UNDO.done = 0;
+    UNDO.open = 0;
+    UNDO.sealed = 0;
+    UNDO.discarding = 0;
+}
+
+
+void undoSuspend() {
+    UNDO.suspended++;
+}
+
+
+void undoResume() {
+    UNDO.suspended--;
+}
+
+
+static size_t groupEnd(size_t g) {
+    return (g + 1 < UNDO.numGroups) ? UNDO.groups[g + 1].first : UNDO.numOps;
+}
+
+
+/*
+* Drops the oldest applied groups until the log is back under three
+* quarters of its limit. The open group is never dropped; if it alone is
+* over the limit the whole history is given up, since half an edit cannot
+* be undone.
+*/
+static void trim() {
+    size_t target = undoLimit() / 4 * 3;
+    size_t keep = UNDO.open ? 1 : 0;
+
+    size_t drop = 0;
+    size_t bytes = undoMemory();
+    while (bytes > target && drop + keep < UNDO.done) {
+        size_t end = groupEnd(drop);
+        size_t textEnd = (end < UNDO.numOps) ? UNDO.ops[end].text : UNDO.textLen;
+        size_t textStart = UNDO.ops[UNDO.groups[drop].first].text;
+
+        bytes -= (textEnd - textStart)
+            + (end - UNDO.groups[drop].first) * sizeof(struct undoOp)
+            + sizeof(struct undoGroup);
+        drop++;
+    }
+
+    if (drop) {
+        size_t ops = (drop < UNDO.numGroups) ? UNDO.groups[drop].first : UNDO.numOps;
+        size_t text = (ops < UNDO.numOps) ? UNDO.ops[ops].text : UNDO.textLen;
+
+        memmove(UNDO.ops, &UNDO.ops[ops], sizeof(struct undoOp) * (UNDO.numOps - ops));
+        UNDO.numOps -= ops;
+        for (size_t o = 0; o < UNDO.numOps; o++) { UNDO.ops[o].text -= text; }
+
+        memmove(UNDO.groups, &UNDO.groups[drop], sizeof(struct undoGroup) * (UNDO.numGroups - drop));
+        UNDO.numGroups -= drop;
+        for (size_t g = 0; g < UNDO.numGroups; g++) { UNDO.groups[g].first -= ops; }
+
+        memmove(UNDO.text, &UNDO.text[text], UNDO.textLen - text);
+        UNDO.textLen -= text;
+        UNDO.done -= drop;
+    }
+
+    if (UNDO.open && undoMemory() > undoLimit()) {
+        undoReset();
+        UNDO.open = 1;
+        UNDO.discarding = 1;
+    }
+}
+
+
+/* Starts a group for the ops of the current keypress, forgetting any redo. */
+static void openGroup() {
+    if (UNDO.open) { return; }
+
+    if (UNDO.done < UNDO.numGroups) {
+        UNDO.numOps = UNDO.groups[UNDO.done].first;
+        UNDO.textLen = UNDO.ops[UNDO.numOps].text;
+        UNDO.numGroups = UNDO.done;
+    }
+
+    UNDO.groups = grow(
+        UNDO.groups, &UNDO.groupsCapacity, UNDO.numGroups + 1, sizeof(struct undoGroup)
+    );
+    struct undoGroup *group = &UNDO.groups[UNDO.numGroups++];
+    group->first = UNDO.numOps;
+    group->cursorX = CONFIG.cursorX;
+    group->cursorY = CONFIG.cursorY;
+
+    UNDO.done = UNDO.numGroups;
+    UNDO.open = 1;
+    UNDO.sealed = 0;
+}
+
+
+static struct undoOp *pushOp(int kind, int row, int at) {
+    UNDO.ops = grow(UNDO.ops, &UNDO.opsCapacity, UNDO.numOps + 1, sizeof(struct undoOp));
+
+    struct undoOp *op = &UNDO.ops[UNDO.numOps++];
+    op->kind = kind;
+    op->row = row;
+    op->at = at;
+    op->count = 0;
+    op->text = UNDO.textLen;
+    op->len = 0;
+    return op;
+}
+
+
+/*
+* The op the next edit may be folded into: the last op of the open group,
+* or, for typing, the single op of the group the last keypress made.
+*/
+static struct undoOp *lastOp(int typing) {
+    if (UNDO.numOps == 0 || UNDO.done != UNDO.numGroups) { return NULL; }
+    if (UNDO.open) { return &UNDO.ops[UNDO.numOps - 1]; }
+
+    if (!typing || UNDO.sealed) { return NULL; }
+    if (UNDO.groups[UNDO.numGroups - 1].first != UNDO.numOps - 1) { return NULL; }
+    return &UNDO.ops[UNDO.numOps - 1];
+}
+
+
+static int recording() {
+    return !UNDO.suspended && !UNDO.discarding && undoLimit();
+}
+
+
+void undoRecordInsertChars(int row, int at, const char *s, size_t len) {
+    if (!recording() || len == 0) { return; }
+
+    struct undoOp *op = lastOp(len == 1);
+    if (
+        op == NULL || op->kind != UNDO_INSERT_CHARS
+        || op->row != row || op->at + op->len != (size_t) at
+    ) {
+        openGroup();
+        op = pushOp(UNDO_INSERT_CHARS, row, at);
+    }
+    UNDO.open = 1;  // typing folded into the last group reopens it
+
+    textAppend(s, len);
+    op->len += len;
+    if (undoMemory() > undoLimit()) { trim(); }
+}
+
+
+void undoRecordDeleteChars(int row, int at, const char *s, size_t len) {
+    if (!recording() || len == 0) { return; }
+
+    struct undoOp *op = lastOp(len == 1);
+    if (op != NULL && op->kind == UNDO_DELETE_CHARS && op->row == row) {
+        // deleting forwards from the same column
+        if (op->at == at) {
+            UNDO.open = 1;
+            textAppend(s, len);
+            op->len += len;
+            if (undoMemory() > undoLimit()) { trim(); }
+            return;
+        }
+
+        // or backwards into it
+        if ((size_t) at + len == (size_t) op->at) {
+            UNDO.open = 1;
+            textAppend(s, len);
+            memmove(&UNDO.text[op->text + len], &UNDO.text[op->text], op->len);
+            memcpy(&UNDO.text[op->text], s, len);
+            op->at = at;
+            op->len += len;
+            if (undoMemory() > undoLimit()) { trim(); }
+            return;
+        }
+    }
+
+    openGroup();
+    op = pushOp(UNDO_DELETE_CHARS, row, at);
+    textAppend(s, len);
+    op->len = len;
+    if (undoMemory() > undoLimit()) { trim(); }
+}
+
+
+static void recordRow(int kind, int row, const char *s, size_t len) {
+    struct undoOp *op = UNDO.open ? lastOp(0) : NULL;
+
+    int follows = (op != NULL && op->kind == kind) && (
+        (kind == UNDO_INSERT_ROWS && op->row + op->count == row)
+        || (kind == UNDO_DELETE_ROWS && op->row == row)
+    );
+    if (!follows) {
+        openGroup();
+        op = pushOp(kind, row, 0);
+    }
+
+    size_t before = UNDO.textLen;
+    textAppendLength(len);
+    textAppend(s, len);
+    op->len += UNDO.textLen - before;
+    op->count++;
+    if (undoMemory() > undoLimit()) { trim(); }
+}
+
+
+void undoRecordInsertRow(int row, const char *s, size_t len) {
+    if (recording()) { recordRow(UNDO_INSERT_ROWS, row, s, len); }
+}
+
+
+void undoRecordDeleteRow(int row, const char *s, size_t len) {
+    if (recording()) { recordRow(UNDO_DELETE_ROWS, row, s, len); }
+}
+
+
+/* Closes the group of the keypress just handled. */
+void undoCommit() {
+    if (UNDO.discarding) {
+        undoReset();
+        setStatusMessage("Edit too large to undo");
+        return;
+    }
+    if (!UNDO.open) { return; }
+
+    struct undoGroup *group = &UNDO.groups[UNDO.numGroups - 1];
+    group->afterX = CONFIG.cursorX;
+    group->afterY = CONFIG.cursorY;
+    UNDO.open = 0;
+}
+
+
+/*
+* Closes the open group and keeps typing out of it, so an edit made as a
+* whole, such as a cut or a paste, is undone on its own.
+*/
+void undoSeal() {
+    undoCommit();
+    UNDO.sealed = 1;
+}
+
+
+static void insertRows(struct undoOp *op) {
+    char **lines = malloc(sizeof(char *) * op->count);
+    size_t *lens = malloc(sizeof(size_t) * op->count);
+    if (lines == NULL || lens == NULL) { die("malloc"); }
+
+    const char *p = &UNDO.text[op->text];
+    for (int r = 0; r < op->count; r++) {
+        lens[r] = textLength(&p);
+        lines[r] = (char *) p;
+        p += lens[r];
+    }
+    editorInsertRows(op->row, lines, lens, op->count);
+
+    free(lines);
+    free(lens);
+}
+
+
+static void applyOp(struct undoOp *op, int reverse) {
+    int kind = op->kind;
+    if (reverse) {
+        static const int INVERSE[] = {
+            UNDO_DELETE_CHARS, UNDO_INSERT_CHARS, UNDO_DELETE_ROWS, UNDO_INSERT_ROWS
+        };
+        kind = INVERSE[kind];
+    }
+
+    if (kind == UNDO_INSERT_ROWS) { insertRows(op); }
+    else if (kind == UNDO_DELETE_ROWS) { editorDelRows(op->row, op->count); }
+    else if (op->row < CONFIG.numRows) {
+        editorRow *row = &CONFIG.row[op->row];
+        if (kind == UNDO_INSERT_CHARS) { editorRowInsertChars(row, op->at, &UNDO.text[op->text], op->len); }
+        else { editorRowDelChars(row, op->at, op->len); }
+    }
+}
+
+
+static void placeCursor(int x, int y) {
+    if (y > CONFIG.numRows) { y = CONFIG.numRows; }
+    if (y < 0) { y = 0; }
+
+    int size = (y < CONFIG.numRows) ? CONFIG.row[y].rowSize : 0;
+    if (x > size) { x = size; }
+    if (x < 0) { x = 0; }
+
+    CONFIG.cursorX = x;
+    CONFIG.cursorY = y;
+}
+
+
+/*
+* Undoes the last group. Its ops are reverted newest first inside one row
+* batch, so however many rows they touch are highlighted in a single pass.
+* Returns 0 if there was nothing to undo.
+*/
+int undo() {
+    undoCommit();
+    if (UNDO.done == 0) { return 0; }
+
+    struct undoGroup *group = &UNDO.groups[--UNDO.done];
+    size_t end = groupEnd(UNDO.done);
+
+    undoSuspend();
+    editorBeginBatch();
+    for (size_t o = end; o > group->first; o--) { applyOp(&UNDO.ops[o - 1], 1); }
+    editorEndBatch();
+    undoResume();
+
+    placeCursor(group->cursorX, group->cursorY);
+    UNDO.sealed = 1;
+    return 1;
+}
+
+
+/* Reapplies the last undone group. Returns 0 if there was nothing to redo. */
+int redo() {
+    undoCommit();
+    if (UNDO.done == UNDO.numGroups) { return 0; }
+
+    struct undoGroup *group = &UNDO.groups[UNDO.done];
+    size_t end = groupEnd(UNDO.done++);
+
+    undoSuspend();
+    editorBeginBatch();
+    for (size_t o = group->first; o < end; o++) { applyOp(&UNDO.ops[o], 0); }
+    editorEndBatch();
+    undoResume();
+
+    placeCursor(group->afterX, group->afterY);
+    UNDO.sealed = 1;
+    return 1;
+}
@@ -0,0 +1,23 @@
+/* Undo log headers. */
+
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <stddef.h>
+
+void undoRecordInsertChars(int, int, const char *, size_t);
+void undoRecordDeleteChars(int, int, const char *, size_t);
+void undoRecordInsertRow(int, const char *, size_t);
+void undoRecordDeleteRow(int, const char *, size_t);
+
+void undoCommit();
+void undoSeal();
+void undoReset();
+void undoSuspend();
+void undoResume();
+size_t undoMemory();
+
+int undo();
+int redo();
+
+#endif
@@ -0,0 +1,199 @@
+/* Performance counters for the hot paths, with a HUD and a dump on exit. */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core.h"
+#include "perf.h"
+
+#define PERF_FRAMES 256  // recent frames the latency percentiles are taken over
+#define PERF_TICK 1e-9  // seconds, as ticks are nanoseconds
+
+
+/*
+* editorUpdateRow, called once a row, is timed only one call in its
+* sample rate, as reading the clock costs about as much as it does; its
+* total is scaled up from the calls that were timed.
+*/
+struct perfTimer {
+    long long calls;
+    long long timed;
+    unsigned long long total;  // ticks over the timed calls
+    unsigned long long max;
+};
+
+
+static const char *TIMER_NAMES[PERF_TIMERS] = {
+    "refreshScreen", "drawRows", "updateSyntax", "editorUpdateRow",
+    "findCallback", "editorOpen", "editorSave"
+};
+
+static const int SAMPLE_EVERY[PERF_TIMERS] = {1, 1, 1, 16, 1, 1, 1};  // a power of 2
+
+static const char *COUNTER_NAMES[PERF_COUNTERS] = {
+    "bytes drawn", "bytes saved", "allocations", "rows highlighted"
+};
+
+
+/*
+* Totals since the editor started. Timers are only started and stopped on
+* the main thread, and counters too or by the background worker while the
+* main thread waits for it, so none of them needs a lock.
+*/
+static struct {
+    struct perfTimer timer[PERF_TIMERS];
+    long long counter[PERF_COUNTERS];
+
+    unsigned long long frame[PERF_FRAMES];  // refreshScreen times, as a ring
+    int frames;
+
+    int hud;
+} PERF;
+
+
+/* Reads the monotonic clock, in ticks. */
+static unsigned long long ticksNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+/* Counts a call to a timed function; returns 0 if this one isn't timed. */
+unsigned long long perfStart(int timer) {
+    struct perfTimer *t = &PERF.timer[timer];
+    if (t->calls++ & (SAMPLE_EVERY[timer] - 1)) { return 0; }
+    return ticksNow();
+}
+
+
+/* Adds the ticks since start to a timer; refreshes also count as frames. */
+void perfStop(int timer, unsigned long long start) {
+    if (start == 0) { return; }
+
+    unsigned long long ticks = ticksNow() - start;
+    struct perfTimer *t = &PERF.timer[timer];
+
+    t->timed++;
+    t->total += ticks;
+    if (ticks > t->max) { t->max = ticks; }
+
+    if (timer == PERF_REFRESH) { PERF.frame[PERF.frames++ % PERF_FRAMES] = ticks; }
+}
+
+
+void perfCount(int counter, long long n) {
+    PERF.counter[counter] += n;
+}
+
+
+int perfHudToggle() {
+    PERF.hud = !PERF.hud;
+    return PERF.hud;
+}
+
+
+/* Copies the recent frame times into frames, returning how many there are. */
+static int recentFrames(unsigned long long *frames) {
+    int n = PERF.frames < PERF_FRAMES ? PERF.frames : PERF_FRAMES;
+    memcpy(frames, PERF.frame, sizeof(unsigned long long) * n);
+    return n;
+}
+
+
+/*
+* Frame time, in seconds, that fraction p of n frames took at most. The
+* frames are partitioned around it rather than sorted, as the HUD does
+* this on every refresh.
+*/
+static double percentile(unsigned long long *frames, int n, double p) {
+    if (n == 0) { return 0; }
+
+    int k = p * n;
+    if (k >= n) { k = n - 1; }
+
+    int lo = 0;
+    int hi = n - 1;
+    while (lo < hi) {
+        unsigned long long pivot = frames[(lo + hi) / 2];
+        int i = lo;
+        int j = hi;
+        while (i <= j) {
+            while (frames[i] < pivot) { i++; }
+            while (frames[j] > pivot) { j--; }
+            if (i <= j) {
+                unsigned long long swap = frames[i];
+                frames[i++] = frames[j];
+                frames[j--] = swap;
+            }
+        }
+        if (k <= j) { hi = j; }
+        else if (k >= i) { lo = i; }
+        else { break; }
+    }
+    return frames[k] * PERF_TICK;
+}
+
+
+/* Frame time, in seconds, that fraction p of the recent frames took at most. */
+double perfFramePercentile(double p) {
+    unsigned long long frames[PERF_FRAMES];
+    int n = recentFrames(frames);
+    return percentile(frames, n, p);
+}
+
+
+/* Writes the HUD's text into buf, or nothing while it is off. */
+int perfHud(char *buf, int size) {
+    if (!PERF.hud) { return 0; }
+
+    unsigned long long frames[PERF_FRAMES];
+    int n = recentFrames(frames);
+
+    int len = snprintf(
+        buf, size, "frame p50 %.2fms p99 %.2fms",
+        percentile(frames, n, 0.5) * 1e3, percentile(frames, n, 0.99) * 1e3
+    );
+    return len < size ? len : size - 1;
+}
+
+
+/*
+* Writes the totals to MOOSE_PERF_FILE, if it is set. Registered to run
+* on exit.
+*/
+void perfDump() {
+    char *path = getenv("MOOSE_PERF_FILE");
+    if (path == NULL || path[0] == '\0') { return; }
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) { return; }
+
+    double tick = PERF_TICK;
+    fprintf(fp, "%-20s %10s %12s %12s %12s\n", "timer", "calls", "total ms", "mean us", "max ms");
+    for (int k = 0; k < PERF_TIMERS; k++) {
+        struct perfTimer *t = &PERF.timer[k];
+        double mean = t->timed ? t->total * tick / t->timed : 0;
+        fprintf(
+            fp, "%-20s %10lld %12.3f %12.3f %12.3f\n", TIMER_NAMES[k], t->calls,
+            mean * t->calls * 1e3, mean * 1e6, t->max * tick * 1e3
+        );
+    }
+
+    fprintf(fp, "\n%-20s %10s\n", "counter", "total");
+    for (int k = 0; k < PERF_COUNTERS; k++) {
+        fprintf(fp, "%-20s %10lld\n", COUNTER_NAMES[k], PERF.counter[k]);
+    }
+
+    unsigned long long frames[PERF_FRAMES];
+    int n = recentFrames(frames);
+    fprintf(
+        fp, "\nframe p50 %.3f ms, p99 %.3f ms over the last %d frames\n",
+        percentile(frames, n, 0.5) * 1e3, percentile(frames, n, 0.99) * 1e3, n
+    );
+    fclose(fp);
+}
@@ -0,0 +1,34 @@
+/* Performance counter headers. */
+
+#ifndef PERF_H
+#define PERF_H
+
+enum perfTimers {
+    PERF_REFRESH = 0,
+    PERF_DRAW_ROWS,
+    PERF_UPDATE_SYNTAX,
+    PERF_UPDATE_ROW,
+    PERF_FIND,
+    PERF_OPEN,
+    PERF_SAVE,
+    PERF_TIMERS
+};
+
+enum perfCounters {
+    PERF_BYTES_DRAWN = 0,
+    PERF_BYTES_SAVED,
+    PERF_ALLOCATIONS,
+    PERF_ROWS_HIGHLIGHTED,
+    PERF_COUNTERS
+};
+
+unsigned long long perfStart(int);
+void perfStop(int, unsigned long long);
+void perfCount(int, long long);
+
+int perfHudToggle();
+int perfHud(char *, int);
+double perfFramePercentile(double);
+void perfDump();
+
+#endif
@@ -1,73 +1,674 @@
 /* Handle search functionality. */
 
+#define _DEFAULT_SOURCE
+
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "ahocorasick.h"
 #include "core.h"
-#include "highlight.h"
+#include "dfa.h"
+#include "perf.h"
+#include "search.h"
+#include "threadpool.h"
+#include "words.h"
+#include "io/input.h"
 #include "io/output.h"
 #include "ops/rowops.h"
+#include "ops/undo.h"
+
+#define SEARCH_SLICE_ROWS 4096  // rows per pool job
+
+
+/*
+* Every match of the current query, sorted by position. Rows below
+* scannedRows have been indexed; the rest are picked up on the next pass
+* if the scan yielded to a pending keypress.
+*/
+struct matchIndex {
+    struct searchMatch *matches;
+    int count;
+    int capacity;
+
+    int scannedRows;
+    int current;  // match the cursor is sitting on, -1 if none
+    int active;
+    int replacing;  // index only the matches a replace would make
+
+    char *query;  // query the index was built for
+
+    int mode;
+    struct regex **re;  // one compiled copy per pool worker
+    const char *error;
+
+    struct acAutomaton *ac;
+    char **patterns;
+    int patternCount;
+};
+
+static struct matchIndex INDEX = {
+    NULL, 0, 0, 0, -1, 0, 0, NULL, SEARCH_LITERAL, NULL, NULL, NULL, NULL, 0
+};
+
+
+static void indexReset() {
+    free(INDEX.matches);
+    INDEX.matches = NULL;
+    INDEX.count = 0;
+    INDEX.capacity = 0;
+    INDEX.scannedRows = 0;
+    INDEX.current = -1;
+
+    free(INDEX.query);
+    INDEX.query = NULL;
+
+    if (INDEX.re) {
+        for (int i = 0; i < poolSize(); i++) { regexFree(INDEX.re[i]); }
+        free(INDEX.re);
+    }
+    INDEX.re = NULL;
+    INDEX.error = NULL;
+
+    acFree(INDEX.ac);
+    INDEX.ac = NULL;
+    for (int i = 0; i < INDEX.patternCount; i++) { free(INDEX.patterns[i]); }
+    free(INDEX.patterns);
+    INDEX.patterns = NULL;
+    INDEX.patternCount = 0;
+}
+
+
+static void indexCompileRegex(const char *query) {
+    struct regex *re = regexCompile(query, &INDEX.error);
+    if (re == NULL) { return; }
+
+    INDEX.re = malloc(sizeof(struct regex *) * poolSize());
+    if (INDEX.re == NULL) { die("malloc"); }
+
+    INDEX.re[0] = re;
+    for (int i = 1; i < poolSize(); i++) {
+        INDEX.re[i] = regexCompile(query, NULL);
+    }
+}
+
+
+static void addPattern(const char *pattern, int len) {
+    if (len == 0) { return; }
+
+    INDEX.patterns = realloc(
+        INDEX.patterns, sizeof(char *) * (INDEX.patternCount + 1)
+    );
+    if (INDEX.patterns == NULL) { die("realloc"); }
+
+    INDEX.patterns[INDEX.patternCount++] = strndup(pattern, len);
+}
+
+
+/*
+* A watch-list is either the path of a file with one pattern per line, or
+* the patterns themselves separated by '|'.
+*/
+static void indexCompilePatterns(const char *spec) {
+    FILE *fp = fopen(spec, "r");
+
+    if (fp) {
+        char *line = NULL;
+        size_t linecap = 0;
+        ssize_t linelen;
+
+        while ((linelen = getline(&line, &linecap, fp)) != -1) {
+            while (
+                linelen > 0
+                && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r')
+            ) {
+                linelen--;
+            }
+            addPattern(line, linelen);
+        }
+        free(line);
+        fclose(fp);
+    }
+
+    else {
+        const char *p = spec;
+        const char *bar;
+
+        while ((bar = strchr(p, '|')) != NULL) {
+            addPattern(p, bar - p);
+            p = bar + 1;
+        }
+        addPattern(p, strlen(p));
+    }
+
+    if (INDEX.patternCount == 0) {
+        INDEX.error = "empty watch-list";
+        return;
+    }
+    INDEX.ac = acBuild(INDEX.patterns, INDEX.patternCount);
+}
+
+
+/*
+* Move the index over to a new query. When the new query extends the old
+* one, every match of it starts at a position the old query matched, so
+* the existing candidates are filtered in place and only rows that were
+* never scanned still need a full pass. Anything else starts from scratch.
+*/
+static void indexSetQuery(const char *query) {
+    int qlen = strlen(query);
+
+    if (INDEX.mode != SEARCH_LITERAL) {
+        // a longer pattern can match text the shorter one did not
+        if (INDEX.query && !strcmp(query, INDEX.query)) { return; }
+
+        indexReset();
+        if (qlen && INDEX.mode == SEARCH_REGEX) { indexCompileRegex(query); }
+        if (qlen && INDEX.mode == SEARCH_MULTI) { indexCompilePatterns(query); }
+    }
+
+    // nothing was indexed for an empty query, so there is nothing to narrow;
+    // and a replace's matches don't overlap, so they are no superset either
+    else if (
+        INDEX.query == NULL || INDEX.query[0] == '\0' || qlen == 0 || INDEX.replacing
+        || strncmp(query, INDEX.query, strlen(INDEX.query)) != 0
+    ) {
+        indexReset();
+    }
+
+    else if (strcmp(query, INDEX.query) != 0) {
+        int kept = 0;
+
+        for (int m = 0; m < INDEX.count; m++) {
+            struct searchMatch *match = &INDEX.matches[m];
+            editorRow *row = &CONFIG.row[match->row];
+
+            if (
+                match->rx + qlen <= row->renderSize
+                && !memcmp(&row->render[match->rx], query, qlen)
+            ) {
+                match->len = qlen;
+                INDEX.matches[kept++] = *match;
+            }
+        }
+        INDEX.count = kept;
+        INDEX.current = -1;
+        free(INDEX.query);
+    }
+
+    else {
+        return;
+    }
+
+    INDEX.query = strdup(query);
+}
+
 
-static void findCallback(char *query, int key) {
-    static int last_match = -1;
-    static int direction = 1;
+/* Matches found by one worker in one slice of rows. */
+struct matchList {
+    struct searchMatch *matches;
+    int count;
+    int capacity;
+    int done;
+};
 
-    static int save_hl_line;
-    static char *saved_hl = NULL;
 
-    if (saved_hl) {
-        memcpy(
-            CONFIG.row[save_hl_line].highlight, saved_hl,
-            CONFIG.row[save_hl_line].renderSize
+/* A scan of the rows [first, numRows), split into slices for the pool. */
+struct scanJob {
+    const char *query;
+    int qlen;
+    int first;
+    struct matchList *slices;
+};
+
+
+static void listAdd(struct matchList *list, int row, int rx, int len, int pattern) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->matches = realloc(
+            list->matches, sizeof(struct searchMatch) * list->capacity
         );
-        free(saved_hl);
-        saved_hl = NULL;
+        if (list->matches == NULL) { die("realloc"); }
+    }
+
+    struct searchMatch *m = &list->matches[list->count++];
+    m->row = row;
+    m->rx = rx;
+    m->len = len;
+    m->pattern = pattern;
+}
+
+
+static void scanRow(struct matchList *list, int filerow, const char *query, int qlen) {
+    editorRow *row = &CONFIG.row[filerow];
+    char *match = row->render;
+
+    // overlapping matches are kept so the count reflects every position
+    while ((match = strstr(match, query)) != NULL) {
+        listAdd(list, filerow, match - row->render, qlen, 0);
+        match++;
+    }
+}
+
+
+struct rowScan {
+    struct matchList *list;
+    int row;
+};
+
+
+static void scanAddRegex(int start, int len, void *arg) {
+    struct rowScan *scan = arg;
+    listAdd(scan->list, scan->row, start, len, 0);
+}
+
+
+static void scanAddHit(int start, int len, int pattern, void *arg) {
+    struct rowScan *scan = arg;
+    listAdd(scan->list, scan->row, start, len, pattern);
+}
+
+
+/*
+* Adds every non-overlapping match of the query in a row to found, left to
+* right, in character columns. Replacing walks the characters rather than
+* the render so tabs are replaced as they are stored.
+*/
+static void findReplaceable(struct matchList *found, editorRow *row, const char *query,
+    struct regex *re) {
+
+    if (re) {
+        struct rowScan scan = {found, row->index};
+        regexFindAll(re, row->characters, row->rowSize, scanAddRegex, &scan);
+        return;
+    }
+
+    int qlen = strlen(query);
+    char *match = row->characters;
+    while ((match = strstr(match, query)) != NULL) {
+        listAdd(found, row->index, match - row->characters, qlen, 0);
+        match += qlen;
+    }
+}
+
+
+/* Indexes the matches a replace would make in a row, in render columns. */
+static void scanReplaceable(struct matchList *list, int filerow, const char *query,
+    struct regex *re) {
+
+    editorRow *row = &CONFIG.row[filerow];
+    int before = list->count;
+    findReplaceable(list, row, query, re);
+
+    for (int m = before; m < list->count; m++) {
+        struct searchMatch *match = &list->matches[m];
+        int end = editorRowCxToRx(row, match->rx + match->len);
+        match->rx = editorRowCxToRx(row, match->rx);
+        match->len = end - match->rx;
+    }
+}
+
+
+static int hitCompare(const void *a, const void *b) {
+    const struct searchMatch *x = a;
+    const struct searchMatch *y = b;
+
+    if (x->rx != y->rx) { return (x->rx > y->rx) - (x->rx < y->rx); }
+    return (x->pattern > y->pattern) - (x->pattern < y->pattern);
+}
+
+
+static void scanSlice(int slice, int worker, void *arg) {
+    struct scanJob *job = arg;
+    struct matchList *list = &job->slices[slice];
+
+    int first = job->first + slice * SEARCH_SLICE_ROWS;
+    int end = first + SEARCH_SLICE_ROWS;
+    if (end > CONFIG.numRows) { end = CONFIG.numRows; }
+
+    for (int filerow = first; filerow < end; filerow++) {
+        // rows hidden in a fold have no render, and are not searched
+        if (CONFIG.row[filerow].render == NULL) { continue; }
+
+        if (INDEX.replacing) {
+            struct regex *re = (INDEX.mode == SEARCH_REGEX) ? INDEX.re[worker] : NULL;
+            scanReplaceable(list, filerow, job->query, re);
+        }
+
+        else if (INDEX.mode == SEARCH_MULTI) {
+            struct rowScan scan = {list, filerow};
+            editorRow *row = &CONFIG.row[filerow];
+            int before = list->count;
+
+            // hits come out by end position; the index wants them by start
+            int hits = acScan(
+                INDEX.ac, row->render, row->renderSize, scanAddHit, &scan
+            );
+            if (hits > 1) {
+                qsort(
+                    &list->matches[before], hits, sizeof(struct searchMatch),
+                    hitCompare
+                );
+            }
+        }
+
+        else if (INDEX.mode == SEARCH_REGEX) {
+            // the lazy DFA caches as it goes, so each worker has its own
+            struct rowScan scan = {list, filerow};
+            editorRow *row = &CONFIG.row[filerow];
+
+            regexFindAll(
+                INDEX.re[worker], row->render, row->renderSize,
+                scanAddRegex, &scan
+            );
+        }
+
+        else {
+            scanRow(list, filerow, job->query, job->qlen);
+        }
+    }
+    list->done = 1;
+}
+
+
+/*
+* Scan the rows that are not yet indexed, a slice per pool job. When
+* yielding, the scan is cancelled as soon as a key is waiting and only the
+* unbroken run of finished slices is merged, which keeps the index sorted.
+* Returns 1 once the whole buffer has been scanned.
+*/
+static int indexBuild(const char *query, int yield) {
+    int qlen = strlen(query);
+    if (qlen == 0) { return 1; }
+    if (
+        (INDEX.mode == SEARCH_REGEX && INDEX.re == NULL)
+        || (INDEX.mode == SEARCH_MULTI && INDEX.ac == NULL)
+    ) {
+        INDEX.scannedRows = CONFIG.numRows;
+        return 1;
+    }
+    if (INDEX.scannedRows >= CONFIG.numRows) { return 1; }
+
+    int remaining = CONFIG.numRows - INDEX.scannedRows;
+    int slices = (remaining + SEARCH_SLICE_ROWS - 1) / SEARCH_SLICE_ROWS;
+
+    struct scanJob job = {query, qlen, INDEX.scannedRows, NULL};
+    job.slices = calloc(slices, sizeof(struct matchList));
+    if (job.slices == NULL) { die("calloc"); }
+
+    if (slices == 1) { scanSlice(0, 0, &job); }
+    else { poolRun(slices, scanSlice, &job, yield ? keyPending : NULL); }
+
+    int merging = 1;
+    for (int i = 0; i < slices; i++) {
+        struct matchList *list = &job.slices[i];
+
+        // anything after an unfinished slice is dropped and rescanned later
+        if (!list->done) { merging = 0; }
+
+        if (merging) {
+            if (INDEX.count + list->count > INDEX.capacity) {
+                while (INDEX.count + list->count > INDEX.capacity) {
+                    INDEX.capacity = INDEX.capacity ? INDEX.capacity * 2 : 64;
+                }
+                INDEX.matches = realloc(
+                    INDEX.matches, sizeof(struct searchMatch) * INDEX.capacity
+                );
+                if (INDEX.matches == NULL) { die("realloc"); }
+            }
+
+            memcpy(
+                &INDEX.matches[INDEX.count], list->matches,
+                sizeof(struct searchMatch) * list->count
+            );
+            INDEX.count += list->count;
+
+            INDEX.scannedRows += SEARCH_SLICE_ROWS;
+            if (INDEX.scannedRows > CONFIG.numRows) {
+                INDEX.scannedRows = CONFIG.numRows;
+            }
+        }
+        free(list->matches);
+    }
+    free(job.slices);
+
+    return INDEX.scannedRows == CONFIG.numRows;
+}
+
+
+/* Index of the first match at or after (row, rx). */
+static int indexLowerBound(int row, int rx) {
+    int lo = 0;
+    int hi = INDEX.count;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        struct searchMatch *m = &INDEX.matches[mid];
+
+        if (m->row < row || (m->row == row && m->rx < rx)) { lo = mid + 1; }
+        else { hi = mid; }
     }
+    return lo;
+}
+
+
+static void jumpToMatch(int m) {
+    struct searchMatch *match = &INDEX.matches[m];
+
+    INDEX.current = m;
+    CONFIG.cursorY = match->row;
+    CONFIG.cursorX = editorRowRxToCx(&CONFIG.row[match->row], match->rx);
+    CONFIG.rowOffset = CONFIG.numRows;
+    CONFIG.wrapOffset = INT_MAX;
+}
+
+
+static void jumpFromCursor(int direction) {
+    if (INDEX.count == 0) { return; }
+
+    int rx = 0;
+    if (CONFIG.cursorY < CONFIG.numRows) {
+        rx = editorRowCxToRx(&CONFIG.row[CONFIG.cursorY], CONFIG.cursorX);
+    }
+
+    // hits at the same position, of different watch-list patterns, are
+    // stepped through one at a time from the one the cursor is on
+    struct searchMatch *current = INDEX.current >= 0 ? &INDEX.matches[INDEX.current] : NULL;
+    int onCurrent = current && current->row == CONFIG.cursorY && current->rx == rx;
+
+    int m;
+    if (direction == 1) {
+        m = onCurrent ? INDEX.current + 1 : indexLowerBound(CONFIG.cursorY, rx + 1);
+        // only wrap once every row has been looked at
+        if (m == INDEX.count) {
+            if (INDEX.scannedRows < CONFIG.numRows) { return; }
+            m = 0;
+        }
+    }
+
+    else {
+        m = onCurrent ? INDEX.current - 1 : indexLowerBound(CONFIG.cursorY, rx) - 1;
+        // the last match may be in rows not scanned yet, so finish first
+        if (m < 0) {
+            indexBuild(INDEX.query, 0);
+            m = INDEX.count - 1;
+        }
+    }
+
+    jumpToMatch(m);
+}
+
 
+/* Follows the find prompt: each key either changes the query or moves between matches. */
+void findCallback(char *query, int key) {
     if (key == '\r' || key == '\x1b') {
-        last_match = -1;
-        direction = 1;
+        indexReset();
+        INDEX.active = 0;
         return;
     }
 
-    else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
-        direction = 1;
+    unsigned long long start = perfStart(PERF_FIND);
+    if (key == ARROW_RIGHT || key == ARROW_DOWN) {
+        indexBuild(query, 1);
+        jumpFromCursor(1);
     }
 
     else if (key == ARROW_LEFT || key == ARROW_UP) {
-        direction = -1;
+        indexBuild(query, 1);
+        jumpFromCursor(-1);
     }
 
     else {
-        last_match = -1;
-        direction = 1;
+        if (key == CTRL_KEY('r')) {
+            INDEX.mode = (INDEX.mode == SEARCH_REGEX) ? SEARCH_LITERAL : SEARCH_REGEX;
+            indexReset();
+        }
+
+        // the query changed; jump to its first match from the top
+        indexSetQuery(query);
+        indexBuild(query, 1);
+        if (INDEX.count) { jumpToMatch(0); }
     }
+    perfStop(PERF_FIND, start);
+}
+
 
-    if (last_match == -1) { direction = 1; }
+/*
+* Rewrites one row with every non-overlapping match of the query replaced,
+* in a single allocation.
+*/
+static int replaceRow(editorRow *row, const char *query, struct regex *re,
+    const char *with, struct matchList *found) {
 
-    int current = last_match;
-    int i;
-    for (i = 0; i < CONFIG.numRows; i++) {
-        current += direction;
-        if (current == -1) { current = CONFIG.numRows - 1; }
-        else if (current == CONFIG.numRows) { current = 0; }
+    found->count = 0;
+    findReplaceable(found, row, query, re);
+    if (found->count == 0) { return 0; }
 
-        editorRow *row = &CONFIG.row[current];
-        char *match = strstr(row->render, query);
+    int withLen = strlen(with);
+    int size = row->rowSize;
+    for (int m = 0; m < found->count; m++) {
+        size += withLen - found->matches[m].len;
+    }
 
-        if (match) {
-            last_match = current;
-            CONFIG.cursorY = current;
-            CONFIG.cursorX = editorRowRxToCx(row, match - row->render);
-            CONFIG.rowOffset = CONFIG.numRows;
+    char *chars = malloc(size + 1);
+    if (chars == NULL) { die("malloc"); }
 
-            save_hl_line = current;
-            saved_hl = malloc(row->renderSize);
-            memcpy(saved_hl, row->highlight, row->renderSize);
-            memset(&row->highlight[match - row->render], HL_MATCH, strlen(query));
-            break;
-        }
+    char *p = chars;
+    int from = 0;
+    for (int m = 0; m < found->count; m++) {
+        struct searchMatch *match = &found->matches[m];
+
+        memcpy(p, &row->characters[from], match->rx - from);
+        p += match->rx - from;
+        memcpy(p, with, withLen);
+        p += withLen;
+        from = match->rx + match->len;
+    }
+    memcpy(p, &row->characters[from], row->rowSize - from);
+    chars[size] = '\0';
+
+    undoRecordDeleteChars(row->index, 0, row->characters, row->rowSize);
+    undoRecordInsertChars(row->index, 0, chars, size);
+    wordsForget(row, 0, row->rowSize);
+    free(row->characters);
+    row->characters = chars;
+    row->rowSize = size;
+    wordsLearn(row, 0, row->rowSize);
+    editorUpdateRow(row);
+    CONFIG.dirty++;
+
+    return found->count;
+}
+
+
+/*
+* Replaces every match of query in the rows shown. Each affected row is
+* rewritten once and the batch is highlighted in one pass at the end.
+* Returns the number of replacements, or -1 if the regex is invalid.
+*/
+int searchReplaceAll(const char *query, int regex, const char *with) {
+    if (*query == '\0') { return 0; }
+
+    struct regex *re = NULL;
+    if (regex) {
+        re = regexCompile(query, NULL);
+        if (re == NULL) { return -1; }
+    }
+
+    struct matchList found = {NULL, 0, 0, 0};
+    int replaced = 0;
+
+    editorBeginBatch();
+    for (int filerow = 0; filerow < CONFIG.numRows; filerow++) {
+        // rows hidden in a fold are not searched, so nothing in them is replaced
+        if (CONFIG.row[filerow].render == NULL) { continue; }
+        replaced += replaceRow(&CONFIG.row[filerow], query, re, with, &found);
     }
+    editorEndBatch();
+
+    free(found.matches);
+    regexFree(re);
+    return replaced;
+}
+
+
+/* Counts the matches of query in the whole buffer, without yielding. */
+int searchBuffer(const char *query, int mode) {
+    indexReset();
+    INDEX.mode = mode;
+    indexSetQuery(query);
+    indexBuild(query, 0);
+
+    int count = INDEX.count;
+    indexReset();
+    return count;
+}
+
+
+int searchRowMatches(int row, struct searchMatch **first) {
+    if (!INDEX.active || INDEX.count == 0) { return 0; }
+
+    int m = indexLowerBound(row, 0);
+    int n = m;
+    while (n < INDEX.count && INDEX.matches[n].row == row) { n++; }
+
+    *first = &INDEX.matches[m];
+    return n - m;
+}
+
+
+int searchStatus(char *buf, int size) {
+    if (!INDEX.active) { return 0; }
+
+    // an empty query has no rows left to scan
+    int partial = INDEX.scannedRows < CONFIG.numRows && INDEX.query && INDEX.query[0];
+
+    int len;
+    if (INDEX.error) {
+        len = snprintf(buf, size, "regex: %s", INDEX.error);
+    }
+
+    else if (INDEX.mode == SEARCH_MULTI) {
+        int m = INDEX.current;
+        len = snprintf(
+            buf, size, "hit %d of %d%s%s%.16s",
+            m + 1, INDEX.count, partial ? "+" : "",
+            m >= 0 ? " " : "", m >= 0 ? INDEX.patterns[INDEX.matches[m].pattern] : ""
+        );
+    }
+
+    else {
+        len = snprintf(
+            buf, size, "%smatch %d of %d%s",
+            INDEX.mode == SEARCH_REGEX ? "regex " : "", INDEX.current + 1, INDEX.count,
+            partial ? "+" : ""
+        );
+    }
+
+    if (len >= size) { len = size - 1; }
+    return len;
 }
 
 
@@ -76,8 +677,18 @@ void find() {
     int saved_cy = CONFIG.cursorY;
     int saved_colOff = CONFIG.colOffset;
     int saved_rowOff = CONFIG.rowOffset;
+    int saved_wrapOff = CONFIG.wrapOffset;
+
+    indexReset();
+    INDEX.active = 1;
+    INDEX.mode = SEARCH_LITERAL;
 
-    char *query = prompt("Search: %s (Use ESC/Arrows/Enter)", findCallback);
+    char *query = prompt(
+        "Search: %s (Use ESC/Arrows/Enter, Ctrl-R regex)", findCallback
+    );
+
+    indexReset();
+    INDEX.active = 0;
 
     if (query) {
         free(query);
@@ -88,5 +699,119 @@ void find() {
         CONFIG.cursorY = saved_cy;
         CONFIG.colOffset = saved_colOff;
         CONFIG.rowOffset = saved_rowOff;
+        CONFIG.wrapOffset = saved_wrapOff;
+    }
+}
+
+
+void replace() {
+    int saved_cx = CONFIG.cursorX;
+    int saved_cy = CONFIG.cursorY;
+    int saved_colOff = CONFIG.colOffset;
+    int saved_rowOff = CONFIG.rowOffset;
+    int saved_wrapOff = CONFIG.wrapOffset;
+
+    // pick the pattern with the usual incremental search feedback, counting
+    // and painting just the matches that will be replaced
+    indexReset();
+    INDEX.active = 1;
+    INDEX.replacing = 1;
+    INDEX.mode = SEARCH_LITERAL;
+
+    char *query = prompt(
+        "Replace: %s (Use ESC/Arrows/Enter, Ctrl-R regex)", findCallback
+    );
+    int regex = (INDEX.mode == SEARCH_REGEX);
+
+    indexReset();
+    INDEX.active = 0;
+    INDEX.replacing = 0;
+
+    CONFIG.cursorX = saved_cx;
+    CONFIG.cursorY = saved_cy;
+    CONFIG.colOffset = saved_colOff;
+    CONFIG.rowOffset = saved_rowOff;
+    CONFIG.wrapOffset = saved_wrapOff;
+
+    if (query == NULL) { return; }
+
+    char *with = promptAllowEmpty("Replace with: %s (Use ESC/Enter)", NULL);
+    if (with == NULL) {
+        free(query);
+        return;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int replaced = searchReplaceAll(query, regex, with);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double ms = (end.tv_sec - start.tv_sec) * 1e3
+        + (end.tv_nsec - start.tv_nsec) / 1e6;
+
+    if (replaced < 0) { setStatusMessage("Invalid regex: %s", query); }
+    else { setStatusMessage("%d replacements in %.1f ms", replaced, ms); }
+
+    if (CONFIG.cursorY < CONFIG.numRows) {
+        editorRow *row = &CONFIG.row[CONFIG.cursorY];
+        if (CONFIG.cursorX > row->rowSize) { CONFIG.cursorX = row->rowSize; }
+    }
+
+    free(query);
+    free(with);
+}
+
+
+static void watchCallback(char *buf, int key) {
+    (void) buf;
+
+    if (key == '\r' || key == '\x1b') { return; }
+
+    indexBuild(INDEX.query, 1);
+    if (key == ARROW_RIGHT || key == ARROW_DOWN) { jumpFromCursor(1); }
+    else if (key == ARROW_LEFT || key == ARROW_UP) { jumpFromCursor(-1); }
+}
+
+
+/*
+* Searches for a whole list of patterns at once, then lets the user step
+* through the hits of all of them together.
+*/
+void watchList() {
+    int saved_cx = CONFIG.cursorX;
+    int saved_cy = CONFIG.cursorY;
+    int saved_colOff = CONFIG.colOffset;
+    int saved_rowOff = CONFIG.rowOffset;
+    int saved_wrapOff = CONFIG.wrapOffset;
+
+    char *spec = prompt("Watch-list: %s (pattern file, or pat|pat|...)", NULL);
+    if (spec == NULL) { return; }
+
+    indexReset();
+    INDEX.active = 1;
+    INDEX.mode = SEARCH_MULTI;
+    indexSetQuery(spec);
+    indexBuild(spec, 1);
+    if (INDEX.count) { jumpToMatch(0); }
+    free(spec);
+
+    char *done = promptAllowEmpty(
+        "Watch-list (Use ESC/Arrows/Enter) %s", watchCallback
+    );
+
+    indexReset();
+    INDEX.active = 0;
+    INDEX.mode = SEARCH_LITERAL;
+
+    if (done) {
+        free(done);
+    }
+
+    else {
+        CONFIG.cursorX = saved_cx;
+        CONFIG.cursorY = saved_cy;
+        CONFIG.colOffset = saved_colOff;
+        CONFIG.rowOffset = saved_rowOff;
+        CONFIG.wrapOffset = saved_wrapOff;
     }
 }
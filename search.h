@@ -3,6 +3,32 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+/*
+* A single match, in render coordinates. The match index keeps these
+* sorted by (row, rx) so lookups by row or position are binary searches.
+*/
+struct searchMatch {
+    int row;
+    int rx;
+    int len;
+    int pattern;  // which watch-list pattern matched, 0 otherwise
+};
+
+
+enum SEARCH_MODES {
+    SEARCH_LITERAL = 0,
+    SEARCH_REGEX,
+    SEARCH_MULTI,
+};
+
+
 void find();
+void replace();
+void watchList();
+void findCallback(char *, int);
+int searchBuffer(const char *, int);
+int searchReplaceAll(const char *, int, const char *);
+int searchRowMatches(int, struct searchMatch **);
+int searchStatus(char *, int);
 
 #endif
@@ -0,0 +1,530 @@
+/* Syntax definitions loaded from a directory, with a precompiled cache. */
+
+#define _DEFAULT_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "highlight.h"
+#include "syntax.h"
+
+#define SYNTAX_SUFFIX ".syntax"
+#define SYNTAX_CACHE_NAME ".cache"
+#define SYNTAX_CACHE_MAGIC "MOOSESYN"
+#define SYNTAX_CACHE_VERSION 1
+
+
+/*
+* The cache is one file: a header, a record per syntax, then the strings
+* and tables the records point at. Offsets are from the start of the file,
+* so the whole thing is used straight from an mmap; 0 means "none".
+*/
+struct cacheHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int slotSize;  // catches a keywordSlot layout change between builds
+    unsigned long long stamp;
+    unsigned int count;
+    unsigned int size;
+};
+
+
+struct cacheRecord {
+    unsigned int filetype;
+    unsigned int scs;
+    unsigned int mcs;
+    unsigned int mce;
+    unsigned int filematch;  // array of string offsets
+    unsigned int filematchCount;
+    unsigned int keywords;   // array of string offsets
+    unsigned int keywordCount;
+    unsigned int flags;
+
+    unsigned int classes;
+    unsigned int slots;
+    unsigned int mask;
+    unsigned int words;
+    unsigned int wordsLen;
+    int minLen;
+    int maxLen;
+    int scsLen;
+    int mcsLen;
+    int mceLen;
+};
+
+
+/*
+* MOOSE_SYNTAX_DIR if set, otherwise ~/.config/mooseText/syntax. Returns
+* NULL if there is nowhere to look.
+*/
+const char *syntaxDirectory() {
+    static char path[512];
+
+    char *dir = getenv("MOOSE_SYNTAX_DIR");
+    if (dir) { return dir; }
+
+    char *home = getenv("HOME");
+    if (home == NULL) { return NULL; }
+
+    snprintf(path, sizeof(path), "%s/.config/mooseText/syntax", home);
+    return path;
+}
+
+
+static int compareNames(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+
+static unsigned long long stampAdd(unsigned long long h, const void *p, size_t len) {
+    const unsigned char *b = p;
+
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ b[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+
+/*
+* Lists the definition files of a directory in name order, along with a
+* stamp of their names, sizes and modification times that the cache must
+* match. Returns the number of files.
+*/
+static int listDefinitions(const char *dir, char ***names, unsigned long long *stamp) {
+    DIR *d = opendir(dir);
+    if (d == NULL) { return 0; }
+
+    int count = 0;
+    int capacity = 0;
+    *names = NULL;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        int len = strlen(entry->d_name);
+        int suffix = strlen(SYNTAX_SUFFIX);
+        if (len <= suffix || strcmp(&entry->d_name[len - suffix], SYNTAX_SUFFIX)) { continue; }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            *names = realloc(*names, sizeof(char *) * capacity);
+            if (*names == NULL) { die("realloc"); }
+        }
+        (*names)[count++] = strdup(entry->d_name);
+    }
+    closedir(d);
+
+    qsort(*names, count, sizeof(char *), compareNames);
+
+    unsigned long long h = 14695981039346656037ull;
+    for (int j = 0; j < count; j++) {
+        char path[1024];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, (*names)[j]);
+        if (stat(path, &st) == -1) { continue; }
+
+        long long facts[3] = {st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec};
+        h = stampAdd(h, (*names)[j], strlen((*names)[j]) + 1);
+        h = stampAdd(h, facts, sizeof(facts));
+    }
+    *stamp = h;
+
+    return count;
+}
+
+
+/* Appends to a NULL terminated list of strings. */
+static void listAppend(char ***list, int *count, const char *word) {
+    *list = realloc(*list, sizeof(char *) * (*count + 2));
+    if (*list == NULL) { die("realloc"); }
+
+    (*list)[(*count)++] = strdup(word);
+    (*list)[*count] = NULL;
+}
+
+
+static void freeDefinition(struct editorSyntax *s) {
+    free(s->filetype);
+    free(s->singleline_comment_start);
+    free(s->multiline_comment_start);
+    free(s->multiline_comment_end);
+
+    for (int j = 0; s->filematch && s->filematch[j]; j++) { free(s->filematch[j]); }
+    for (int j = 0; s->keywords && s->keywords[j]; j++) { free(s->keywords[j]); }
+    free(s->filematch);
+    free(s->keywords);
+}
+
+
+/*
+* Reads one definition. Each line is a key followed by its words:
+*
+*   filetype python
+*   match .py .pyw SConstruct
+*   comment #
+*   multiline """ """
+*   keywords if elif else while for
+*   types int float str
+*   highlight numbers strings
+*
+* Keys may repeat, unknown keys are ignored and lines starting with # are
+* comments. Returns 0 unless it found at least a filetype and a match.
+*/
+static int parseDefinition(const char *path, struct editorSyntax *s) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) { return 0; }
+
+    memset(s, 0, sizeof(*s));
+    int matches = 0;
+    int keywords = 0;
+
+    char *line = NULL;
+    size_t linecap = 0;
+    while (getline(&line, &linecap, fp) != -1) {
+        char *save;
+        char *key = strtok_r(line, " \t\r\n", &save);
+        if (key == NULL || key[0] == '#') { continue; }
+
+        char *word;
+        if (!strcmp(key, "filetype") && (word = strtok_r(NULL, " \t\r\n", &save))) {
+            free(s->filetype);
+            s->filetype = strdup(word);
+        }
+        else if (!strcmp(key, "match")) {
+            while ((word = strtok_r(NULL, " \t\r\n", &save))) {
+                listAppend(&s->filematch, &matches, word);
+            }
+        }
+        else if (!strcmp(key, "comment") && (word = strtok_r(NULL, " \t\r\n", &save))) {
+            free(s->singleline_comment_start);
+            s->singleline_comment_start = strdup(word);
+        }
+        else if (!strcmp(key, "multiline")) {
+            char *start = strtok_r(NULL, " \t\r\n", &save);
+            char *end = strtok_r(NULL, " \t\r\n", &save);
+            if (start && end) {
+                free(s->multiline_comment_start);
+                free(s->multiline_comment_end);
+                s->multiline_comment_start = strdup(start);
+                s->multiline_comment_end = strdup(end);
+            }
+        }
+        else if (!strcmp(key, "keywords") || !strcmp(key, "types")) {
+            int types = (key[0] == 't');
+            while ((word = strtok_r(NULL, " \t\r\n", &save))) {
+                char spelled[256];
+                snprintf(spelled, sizeof(spelled), "%s%s", word, types ? "|" : "");
+                listAppend(&s->keywords, &keywords, spelled);
+            }
+        }
+        else if (!strcmp(key, "highlight")) {
+            while ((word = strtok_r(NULL, " \t\r\n", &save))) {
+                if (!strcmp(word, "numbers")) { s->flags |= HL_HIGHLIGHT_NUMBERS; }
+                else if (!strcmp(word, "strings")) { s->flags |= HL_HIGHLIGHT_STRINGS; }
+            }
+        }
+    }
+    free(line);
+    fclose(fp);
+
+    if (keywords == 0) { listAppend(&s->keywords, &keywords, ""); }
+
+    if (s->filetype == NULL || matches == 0) {
+        freeDefinition(s);
+        return 0;
+    }
+    return 1;
+}
+
+
+static unsigned int cacheAppend(struct appendString *as, const void *p, int len, int align) {
+    static const char zeros[8] = {0};
+
+    if (as->len % align) { append(as, zeros, align - as->len % align); }
+    unsigned int at = as->len;
+    append(as, p, len);
+    return at;
+}
+
+
+static unsigned int cacheString(struct appendString *as, const char *s) {
+    return s ? cacheAppend(as, s, strlen(s) + 1, 1) : 0;
+}
+
+
+static unsigned int cacheStrings(struct appendString *as, char **list, unsigned int *count) {
+    *count = 0;
+    while (list && list[*count]) { (*count)++; }
+
+    unsigned int *offsets = malloc(sizeof(unsigned int) * (*count + 1));
+    if (offsets == NULL) { die("malloc"); }
+    for (unsigned int j = 0; j < *count; j++) { offsets[j] = cacheString(as, list[j]); }
+
+    unsigned int at = cacheAppend(as, (char *) offsets, sizeof(unsigned int) * *count, 8);
+    free(offsets);
+    return at;
+}
+
+
+/*
+* Writes the compiled syntaxes out under a temporary name and renames it
+* into place, so a concurrent launch never maps half a cache. Failing to
+* write it only costs the next launch a reparse.
+*/
+static void writeCache(const char *path, struct editorSyntax *syntaxes, int count,
+    unsigned long long stamp) {
+
+    struct appendString as = APPENDSTRING_INIT;
+    struct cacheHeader header;
+    struct cacheRecord *records = calloc(count ? count : 1, sizeof(struct cacheRecord));
+    if (records == NULL) { die("calloc"); }
+
+    cacheAppend(&as, (char *) &header, sizeof(header), 8);
+    unsigned int recordsAt = cacheAppend(&as, (char *) records, sizeof(struct cacheRecord) * count, 8);
+
+    for (int j = 0; j < count; j++) {
+        struct editorSyntax *s = &syntaxes[j];
+        struct compiledSyntax *cs = s->compiled;
+        struct cacheRecord *r = &records[j];
+
+        r->filetype = cacheString(&as, s->filetype);
+        r->scs = cacheString(&as, s->singleline_comment_start);
+        r->mcs = cacheString(&as, s->multiline_comment_start);
+        r->mce = cacheString(&as, s->multiline_comment_end);
+        r->filematch = cacheStrings(&as, s->filematch, &r->filematchCount);
+        r->keywords = cacheStrings(&as, s->keywords, &r->keywordCount);
+        r->flags = s->flags;
+
+        r->classes = cacheAppend(&as, (char *) cs->classes, 256, 8);
+        r->slots = cacheAppend(&as, (char *) cs->slots, sizeof(struct keywordSlot) * (cs->mask + 1), 8);
+        r->mask = cs->mask;
+        r->words = cacheAppend(&as, cs->words, cs->wordsLen + 1, 1);
+        r->wordsLen = cs->wordsLen;
+        r->minLen = cs->minLen;
+        r->maxLen = cs->maxLen;
+        r->scsLen = cs->scsLen;
+        r->mcsLen = cs->mcsLen;
+        r->mceLen = cs->mceLen;
+    }
+    // strings are NUL terminated, and so is the file, so none runs off the end
+    cacheAppend(&as, "", 1, 1);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SYNTAX_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SYNTAX_CACHE_VERSION;
+    header.slotSize = sizeof(struct keywordSlot);
+    header.stamp = stamp;
+    header.count = count;
+    header.size = as.len;
+
+    if (as.s != NULL) {
+        memcpy(as.s, &header, sizeof(header));
+        memcpy(&as.s[recordsAt], records, sizeof(struct cacheRecord) * count);
+
+        char temp[1040];
+        snprintf(temp, sizeof(temp), "%s.%d", path, (int) getpid());
+
+        int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd != -1) {
+            int ok = (write(fd, as.s, as.len) == as.len);
+            close(fd);
+            if (!ok || rename(temp, path) == -1) { unlink(temp); }
+        }
+    }
+
+    free(records);
+    stringFree(&as);
+}
+
+
+static int cacheRange(unsigned int at, size_t len, size_t size) {
+    return at < size && len <= size - at;
+}
+
+
+/* Rebuilds a NULL terminated list of strings pointing into the cache. */
+static char **cachedStrings(const char *base, size_t size, unsigned int at, unsigned int count) {
+    if (!cacheRange(at, sizeof(unsigned int) * (size_t) count, size)) { return NULL; }
+
+    char **list = malloc(sizeof(char *) * (count + 1));
+    if (list == NULL) { die("malloc"); }
+
+    const unsigned int *offsets = (const unsigned int *) &base[at];
+    for (unsigned int j = 0; j < count; j++) {
+        if (offsets[j] == 0 || offsets[j] >= size) {
+            free(list);
+            return NULL;
+        }
+        list[j] = (char *) &base[offsets[j]];
+    }
+    list[count] = NULL;
+    return list;
+}
+
+
+static int markerLength(const char *marker) {
+    return marker ? (int) strlen(marker) : 0;
+}
+
+
+/*
+* The lexer trusts a compiled syntax completely, so a mapped one is checked
+* against its own strings and keyword text before it is used.
+*/
+static int cachedSyntaxValid(struct editorSyntax *s, struct compiledSyntax *cs) {
+    if (
+        cs->scsLen != markerLength(s->singleline_comment_start)
+        || (cs->mcsLen && cs->mcsLen != markerLength(s->multiline_comment_start))
+        || (cs->mceLen && cs->mceLen != markerLength(s->multiline_comment_end))
+        || cs->minLen < 0 || cs->maxLen < cs->minLen
+    ) {
+        return 0;
+    }
+
+    for (unsigned int i = 0; i <= cs->mask; i++) {
+        unsigned long long end = (unsigned long long) cs->slots[i].word + cs->slots[i].len;
+        if (end > (unsigned long long) cs->wordsLen) { return 0; }
+    }
+    return 1;
+}
+
+
+/*
+* Maps the cache if it matches the directory's stamp. Only the records'
+* pointers are rebuilt; the strings, class tables and keyword hashes are
+* used in place.
+*/
+static struct editorSyntax *mapCache(const char *path, unsigned long long stamp, int *count) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) { return NULL; }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(struct cacheHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = st.st_size;
+    char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) { return NULL; }
+
+    const struct cacheHeader *header = (const struct cacheHeader *) base;
+    if (
+        memcmp(header->magic, SYNTAX_CACHE_MAGIC, sizeof(header->magic))
+        || header->version != SYNTAX_CACHE_VERSION
+        || header->slotSize != sizeof(struct keywordSlot)
+        || header->stamp != stamp
+        || header->size != size
+        || base[size - 1] != '\0'
+        || !cacheRange(sizeof(*header), sizeof(struct cacheRecord) * (size_t) header->count, size)
+    ) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    int n = header->count;
+    const struct cacheRecord *records = (const struct cacheRecord *) &base[(sizeof(*header) + 7) / 8 * 8];
+    struct editorSyntax *syntaxes = calloc(n ? n : 1, sizeof(struct editorSyntax));
+    struct compiledSyntax *compiled = calloc(n ? n : 1, sizeof(struct compiledSyntax));
+    if (syntaxes == NULL || compiled == NULL) { die("calloc"); }
+
+    for (int j = 0; j < n; j++) {
+        const struct cacheRecord *r = &records[j];
+        struct editorSyntax *s = &syntaxes[j];
+        struct compiledSyntax *cs = &compiled[j];
+
+        s->filetype = &base[r->filetype];
+        s->singleline_comment_start = r->scs ? &base[r->scs] : NULL;
+        s->multiline_comment_start = r->mcs ? &base[r->mcs] : NULL;
+        s->multiline_comment_end = r->mce ? &base[r->mce] : NULL;
+        s->filematch = cachedStrings(base, size, r->filematch, r->filematchCount);
+        s->keywords = cachedStrings(base, size, r->keywords, r->keywordCount);
+        s->flags = r->flags;
+
+        cs->classes = (const unsigned char *) &base[r->classes];
+        cs->slots = (const struct keywordSlot *) &base[r->slots];
+        cs->mask = r->mask;
+        cs->words = &base[r->words];
+        cs->wordsLen = r->wordsLen;
+        cs->minLen = r->minLen;
+        cs->maxLen = r->maxLen;
+        cs->scsLen = r->scsLen;
+        cs->mcsLen = r->mcsLen;
+        cs->mceLen = r->mceLen;
+        s->compiled = cs;
+
+        if (
+            r->filetype >= size || r->scs >= size || r->mcs >= size || r->mce >= size
+            || s->filematch == NULL || s->keywords == NULL
+            || !cacheRange(r->classes, 256, size)
+            || ((r->mask + 1) & r->mask)
+            || !cacheRange(r->slots, sizeof(struct keywordSlot) * ((size_t) r->mask + 1), size)
+            || !cacheRange(r->words, r->wordsLen, size)
+            || !cachedSyntaxValid(s, cs)
+        ) {
+            // a damaged cache is simply rebuilt
+            for (int k = 0; k <= j; k++) {
+                free(syntaxes[k].filematch);
+                free(syntaxes[k].keywords);
+            }
+            free(syntaxes);
+            free(compiled);
+            munmap(base, size);
+            return NULL;
+        }
+    }
+
+    *count = n;
+    return syntaxes;
+}
+
+
+/*
+* Loads every *.syntax file in dir, from the cache when the files haven't
+* changed since it was written, and hands them to the highlighter.
+*/
+void loadSyntaxDefinitions(const char *dir) {
+    if (dir == NULL) { return; }
+
+    char **names;
+    unsigned long long stamp;
+    int files = listDefinitions(dir, &names, &stamp);
+    if (files == 0) { return; }
+
+    char cache[1024];
+    snprintf(cache, sizeof(cache), "%s/%s", dir, SYNTAX_CACHE_NAME);
+
+    int count = 0;
+    struct editorSyntax *syntaxes = mapCache(cache, stamp, &count);
+
+    // the cache holds compiled tables, so a cold start compiles every
+    // definition up front; only the built-ins wait until they are selected
+    if (syntaxes == NULL) {
+        syntaxes = calloc(files, sizeof(struct editorSyntax));
+        if (syntaxes == NULL) { die("calloc"); }
+
+        for (int j = 0; j < files; j++) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", dir, names[j]);
+
+            if (parseDefinition(path, &syntaxes[count])) {
+                syntaxes[count].compiled = compileSyntax(&syntaxes[count]);
+                count++;
+            }
+        }
+        writeCache(cache, syntaxes, count, stamp);
+    }
+
+    for (int j = 0; j < files; j++) { free(names[j]); }
+    free(names);
+
+    setLoadedSyntaxes(syntaxes, count);
+}
@@ -0,0 +1,9 @@
+/* Syntax definition loading headers. */
+
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+const char *syntaxDirectory();
+void loadSyntaxDefinitions(const char *);
+
+#endif
@@ -0,0 +1,132 @@
+/* A fixed pool of worker threads for splitting work over the cores. */
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "core.h"
+#include "threadpool.h"
+
+#define POOL_MAX_WORKERS 64
+#define POOL_POLL_NS 2000000  // how often a waiting caller checks interrupt
+
+
+/*
+* The job currently being handed out. Items are claimed in increasing
+* order, so when a job is cancelled the finished items are (almost always)
+* a prefix of the range.
+*/
+struct poolJob {
+    void (*work)(int, int, void *);
+    void *arg;
+
+    int items;
+    int next;
+    int running;
+    int cancel;
+
+    long generation;
+};
+
+static pthread_mutex_t LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t WAKE = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t DONE = PTHREAD_COND_INITIALIZER;
+
+static struct poolJob JOB;
+static int WORKERS = 0;
+
+
+static void *workerLoop(void *arg) {
+    int id = (int) (intptr_t) arg;
+    long seen = 0;
+
+    pthread_mutex_lock(&LOCK);
+    while (1) {
+        while (JOB.generation == seen) { pthread_cond_wait(&WAKE, &LOCK); }
+        seen = JOB.generation;
+
+        while (!JOB.cancel && JOB.next < JOB.items) {
+            int item = JOB.next++;
+            JOB.running++;
+
+            pthread_mutex_unlock(&LOCK);
+            JOB.work(item, id, JOB.arg);
+            pthread_mutex_lock(&LOCK);
+
+            JOB.running--;
+        }
+        pthread_cond_signal(&DONE);
+    }
+    return NULL;
+}
+
+
+int poolSize() {
+    if (WORKERS) { return WORKERS; }
+
+    // MOOSE_THREADS overrides the core count, mostly for benchmarking
+    char *threads = getenv("MOOSE_THREADS");
+    long cores = threads ? atol(threads) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) { cores = 1; }
+    if (cores > POOL_MAX_WORKERS) { cores = POOL_MAX_WORKERS; }
+
+    for (int i = 0; i < cores; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, workerLoop, (void *) (intptr_t) i) != 0) {
+            die("pthread_create");
+        }
+        pthread_detach(thread);
+    }
+
+    WORKERS = cores;
+    return WORKERS;
+}
+
+
+/*
+* Runs work(item, worker, arg) for every item in [0, items) on the pool
+* and waits for it. While waiting the caller polls interrupt (if given);
+* once it fires no further items are started. Returns 1 if every item ran.
+*/
+int poolRun(int items, void (*work)(int, int, void *), void *arg, int (*interrupt)()) {
+    poolSize();
+
+    pthread_mutex_lock(&LOCK);
+    JOB.work = work;
+    JOB.arg = arg;
+    JOB.items = items;
+    JOB.next = 0;
+    JOB.running = 0;
+    JOB.cancel = 0;
+    JOB.generation++;
+    pthread_cond_broadcast(&WAKE);
+
+    while ((JOB.next < JOB.items && !JOB.cancel) || JOB.running) {
+        if (interrupt == NULL) {
+            pthread_cond_wait(&DONE, &LOCK);
+            continue;
+        }
+
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += POOL_POLL_NS;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&DONE, &LOCK, &until);
+
+        if (!JOB.cancel && interrupt()) { JOB.cancel = 1; }
+    }
+
+    int complete = (JOB.next == JOB.items);
+    // stop late wakers from picking up items of a job that has returned
+    JOB.items = 0;
+    pthread_mutex_unlock(&LOCK);
+
+    return complete;
+}
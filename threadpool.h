@@ -0,0 +1,9 @@
+/* Worker pool headers. */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+int poolSize();
+int poolRun(int, void (*work)(int, int, void *), void *, int (*interrupt)());
+
+#endif
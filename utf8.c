@@ -0,0 +1,149 @@
+/* UTF-8 decoding and display width. */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "utf8.h"
+
+
+/*
+* Whether a run of bytes is plain ASCII, so it can be rendered a byte to
+* a column. Sixteen bytes at a time with SSE2, whose movemask gathers the
+* top bit of each byte, otherwise eight at a time in a machine word.
+*/
+int utf8IsAscii(const char *s, size_t len) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) &s[i]);
+        if (_mm_movemask_epi8(chunk)) { return 0; }
+    }
+#endif
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, &s[i], 8);
+        if (word & 0x8080808080808080ull) { return 0; }
+    }
+
+    for (; i < len; i++) {
+        if ((unsigned char) s[i] & 0x80) { return 0; }
+    }
+    return 1;
+}
+
+
+/*
+* Decodes the character at the start of s, at most len bytes, into *cp.
+* Returns how many bytes it takes; a byte that does not start a valid,
+* shortest form sequence takes one and gives -1.
+*/
+int utf8Decode(const char *s, int len, int *cp) {
+    const unsigned char *u = (const unsigned char *) s;
+    *cp = -1;
+    if (len <= 0) { return 0; }
+
+    if (u[0] < 0x80) {
+        *cp = u[0];
+        return 1;
+    }
+
+    int n;
+    int c;
+    int min;
+    if ((u[0] & 0xe0) == 0xc0) { n = 2; c = u[0] & 0x1f; min = 0x80; }
+    else if ((u[0] & 0xf0) == 0xe0) { n = 3; c = u[0] & 0x0f; min = 0x800; }
+    else if ((u[0] & 0xf8) == 0xf0) { n = 4; c = u[0] & 0x07; min = 0x10000; }
+    else { return 1; }
+
+    if (n > len) { return 1; }
+    for (int k = 1; k < n; k++) {
+        if ((u[k] & 0xc0) != 0x80) { return 1; }
+        c = (c << 6) | (u[k] & 0x3f);
+    }
+
+    if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) { return 1; }
+    *cp = c;
+    return n;
+}
+
+
+struct range {
+    int first;
+    int last;
+};
+
+
+// combining marks and other characters drawn over the one before them
+static const struct range ZERO_WIDTH[] = {
+    {0x0300, 0x036f}, {0x0483, 0x0489}, {0x0591, 0x05bd}, {0x0610, 0x061a},
+    {0x064b, 0x065f}, {0x0670, 0x0670}, {0x06d6, 0x06dc}, {0x06df, 0x06e4},
+    {0x0900, 0x0902}, {0x093c, 0x093c}, {0x0941, 0x0948}, {0x094d, 0x094d},
+    {0x0e31, 0x0e31}, {0x0e34, 0x0e3a}, {0x0e47, 0x0e4e}, {0x1ab0, 0x1aff},
+    {0x1dc0, 0x1dff}, {0x200b, 0x200f}, {0x202a, 0x202e}, {0x2060, 0x2064},
+    {0x20d0, 0x20ff}, {0xfe00, 0xfe0f}, {0xfe20, 0xfe2f}, {0xfeff, 0xfeff},
+    {0xe0100, 0xe01ef},
+};
+
+
+// east asian wide and fullwidth characters, and emoji
+static const struct range DOUBLE_WIDTH[] = {
+    {0x1100, 0x115f}, {0x231a, 0x231b}, {0x2329, 0x232a}, {0x23e9, 0x23ec},
+    {0x25fd, 0x25fe}, {0x2614, 0x2615}, {0x2648, 0x2653}, {0x26a1, 0x26a1},
+    {0x26aa, 0x26ab}, {0x26bd, 0x26be}, {0x26c4, 0x26c5}, {0x26d4, 0x26d4},
+    {0x26ea, 0x26ea}, {0x26f5, 0x26f5}, {0x26fa, 0x26fa}, {0x26fd, 0x26fd},
+    {0x2705, 0x2705}, {0x270a, 0x270b}, {0x2728, 0x2728}, {0x274c, 0x274c},
+    {0x2753, 0x2755}, {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27b0, 0x27b0},
+    {0x2b1b, 0x2b1c}, {0x2b50, 0x2b50}, {0x2b55, 0x2b55}, {0x2e80, 0x303e},
+    {0x3041, 0x33ff}, {0x3400, 0x4dbf}, {0x4e00, 0x9fff}, {0xa000, 0xa4cf},
+    {0xa960, 0xa97f}, {0xac00, 0xd7a3}, {0xf900, 0xfaff}, {0xfe10, 0xfe19},
+    {0xfe30, 0xfe6f}, {0xff00, 0xff60}, {0xffe0, 0xffe6}, {0x16fe0, 0x16fe4},
+    {0x17000, 0x18cff}, {0x1b000, 0x1b2ff}, {0x1f004, 0x1f004}, {0x1f0cf, 0x1f0cf},
+    {0x1f18e, 0x1f18e}, {0x1f191, 0x1f19a}, {0x1f200, 0x1f251}, {0x1f300, 0x1f64f},
+    {0x1f680, 0x1f6ff}, {0x1f7e0, 0x1f7eb}, {0x1f90c, 0x1f9ff}, {0x1fa70, 0x1faff},
+    {0x20000, 0x2fffd}, {0x30000, 0x3fffd},
+};
+
+
+static int inRanges(int cp, const struct range *ranges, int count) {
+    int lo = 0;
+    int hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (ranges[mid].last < cp) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    return lo < count && ranges[lo].first <= cp;
+}
+
+
+/* Columns a character takes on screen; invalid bytes are drawn in one. */
+int utf8Width(int cp) {
+    if (cp < 0x300) { return 1; }
+
+    int zero = sizeof(ZERO_WIDTH) / sizeof(ZERO_WIDTH[0]);
+    int wide = sizeof(DOUBLE_WIDTH) / sizeof(DOUBLE_WIDTH[0]);
+    if (inRanges(cp, ZERO_WIDTH, zero)) { return 0; }
+    if (inRanges(cp, DOUBLE_WIDTH, wide)) { return 2; }
+    return 1;
+}
+
+
+/* Start of the character that ends at byte at, decoded as utf8Decode does. */
+int utf8Prev(const char *s, int at) {
+    if (at <= 0) { return 0; }
+
+    int start = at - 1;
+    while (start > 0 && at - start < 4 && ((unsigned char) s[start] & 0xc0) == 0x80) {
+        start--;
+    }
+
+    int cp;
+    if (utf8Decode(&s[start], at - start, &cp) == at - start) { return start; }
+    return at - 1;
+}
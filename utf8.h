@@ -0,0 +1,13 @@
+/* UTF-8 decoding and display width headers. */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+
+int utf8IsAscii(const char *, size_t);
+int utf8Decode(const char *, int, int *);
+int utf8Width(int);
+int utf8Prev(const char *, int);
+
+#endif
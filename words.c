@@ -0,0 +1,385 @@
+/* Completion of the words already in the buffer. */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "words.h"
+#include "ops/rowops.h"
+
+#define WORDS_SLICE_ROWS 4096  // rows the background worker indexes between checks
+#define WORDS_SHOWN 8          // candidates offered for one completion
+
+
+/*
+* A trie of every word in the rows indexed so far. Each node counts how
+* often the word it ends is in the buffer, and keeps the highest count
+* anywhere below it, so the most frequent words after a prefix are found
+* best first without looking at the rest. Children are a linked list, as
+* only the first few characters of a word branch much, and each one found
+* moves to the front so the common ones are found first.
+*/
+struct wordNode {
+    int count;
+    int best;
+    int parent;
+    int child;
+    int sibling;
+    unsigned char c;
+};
+
+
+/*
+* Rows are indexed in file order, by the background worker while the
+* editor is idle, and every row above indexed is in the trie. Edits to
+* those rows take the words they touch out of the trie and put the new
+* ones in; rows below it are read as they are once the index gets there.
+* Nodes are never freed, only their counts drop to zero.
+*/
+static struct {
+    struct wordNode *node;  // node 0 is the root
+    int nodes;
+    int capacity;
+    int indexed;
+} WORDS = {NULL, 0, 0, 0};
+
+
+/* One step of a best first search down the trie. */
+struct wordStep {
+    int priority;
+    int node;
+    int word;  // whether it is the node's own word rather than those below it
+};
+
+
+static int isWordChar(int c) {
+    return isalnum(c) || c == '_';
+}
+
+
+static int newNode(int parent, unsigned char c) {
+    if (WORDS.nodes == WORDS.capacity) {
+        WORDS.capacity = WORDS.capacity ? WORDS.capacity * 2 : 1024;
+        WORDS.node = realloc(WORDS.node, sizeof(struct wordNode) * WORDS.capacity);
+        if (WORDS.node == NULL) { die("realloc"); }
+    }
+
+    struct wordNode *n = &WORDS.node[WORDS.nodes];
+    n->count = 0;
+    n->best = 0;
+    n->parent = parent;
+    n->child = -1;
+    n->sibling = -1;
+    n->c = c;
+    return WORDS.nodes++;
+}
+
+
+/* Child of a node for character c, moved to the front of the list for next time. */
+static int childOf(int at, unsigned char c) {
+    int prev = -1;
+    for (int k = WORDS.node[at].child; k >= 0; k = WORDS.node[k].sibling) {
+        if (WORDS.node[k].c == c) {
+            if (prev >= 0) {
+                WORDS.node[prev].sibling = WORDS.node[k].sibling;
+                WORDS.node[k].sibling = WORDS.node[at].child;
+                WORDS.node[at].child = k;
+            }
+            return k;
+        }
+        prev = k;
+    }
+    return -1;
+}
+
+
+/* Node of a word or prefix, made if create is set, else -1 if absent. */
+static int findNode(const char *s, int len, int create) {
+    if (WORDS.nodes == 0) {
+        if (!create) { return -1; }
+        newNode(-1, 0);
+    }
+
+    int at = 0;
+    for (int i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        int next = childOf(at, c);
+
+        if (next < 0) {
+            if (!create) { return -1; }
+            next = newNode(at, c);
+            WORDS.node[next].sibling = WORDS.node[at].child;
+            WORDS.node[at].child = next;
+        }
+        at = next;
+    }
+    return at;
+}
+
+
+/* Brings the best counts up the trie in line after a node's count changed. */
+static void updateBest(int at) {
+    while (at >= 0) {
+        struct wordNode *n = &WORDS.node[at];
+
+        int best = n->count;
+        for (int k = n->child; k >= 0; k = WORDS.node[k].sibling) {
+            if (WORDS.node[k].best > best) { best = WORDS.node[k].best; }
+        }
+        if (best == n->best) { return; }
+
+        n->best = best;
+        at = n->parent;
+    }
+}
+
+
+static void countWord(const char *s, int len, int delta) {
+    if (len > WORDS_MAX_LEN || isdigit((unsigned char) s[0])) { return; }
+
+    int at = findNode(s, len, 1);
+    WORDS.node[at].count += delta;
+    updateBest(at);
+}
+
+
+/*
+* Counts every word with a character in [from, to) of a row, by delta.
+* The range is widened to whole words first, so a word the range only
+* touches is counted whole.
+*/
+static void countRange(editorRow *row, int from, int to, int delta) {
+    const char *s = row->characters;
+    while (from > 0 && isWordChar((unsigned char) s[from - 1])) { from--; }
+    while (to < row->rowSize && isWordChar((unsigned char) s[to])) { to++; }
+
+    int i = from;
+    while (i < to) {
+        while (i < to && !isWordChar((unsigned char) s[i])) { i++; }
+
+        int start = i;
+        while (i < to && isWordChar((unsigned char) s[i])) { i++; }
+        if (i > start) { countWord(&s[start], i - start, delta); }
+    }
+}
+
+
+/*
+* Takes the words around bytes [at, at + len) of a row out of the index,
+* before they change.
+*/
+void wordsForget(editorRow *row, int at, int len) {
+    if (row->index < WORDS.indexed) { countRange(row, at, at + len, -1); }
+}
+
+
+/* Puts the words around bytes [at, at + len) of a row back, once they have. */
+void wordsLearn(editorRow *row, int at, int len) {
+    if (row->index < WORDS.indexed) { countRange(row, at, at + len, 1); }
+}
+
+
+/* Indexes count rows new at at, if the index has already got past them. */
+void wordsRowsInserted(int at, int count) {
+    if (at >= WORDS.indexed) { return; }
+
+    WORDS.indexed += count;
+    for (int j = at; j < at + count; j++) {
+        editorRow *row = &CONFIG.row[j];
+        countRange(row, 0, row->rowSize, 1);
+    }
+}
+
+
+/* Forgets the words of count rows at at, before they are removed. */
+void wordsRowsRemoved(int at, int count) {
+    int indexed = WORDS.indexed - at;
+    if (indexed <= 0) { return; }
+    if (indexed > count) { indexed = count; }
+
+    for (int j = at; j < at + indexed; j++) {
+        editorRow *row = &CONFIG.row[j];
+        countRange(row, 0, row->rowSize, -1);
+    }
+    WORDS.indexed -= indexed;
+}
+
+
+int wordsPending() {
+    return WORDS.indexed < CONFIG.numRows;
+}
+
+
+/* Indexes the next few rows; the background worker calls this while idle. */
+void wordsIndexSlice() {
+    int last = WORDS.indexed + WORDS_SLICE_ROWS;
+    if (last > CONFIG.numRows) { last = CONFIG.numRows; }
+
+    for (int j = WORDS.indexed; j < last; j++) {
+        editorRow *row = &CONFIG.row[j];
+        countRange(row, 0, row->rowSize, 1);
+    }
+    WORDS.indexed = last;
+}
+
+
+static int stepBefore(const struct wordStep *a, const struct wordStep *b) {
+    if (a->priority != b->priority) { return a->priority > b->priority; }
+    return a->node < b->node;
+}
+
+
+static void heapPush(struct wordStep **heap, int *size, int *capacity, struct wordStep step) {
+    if (*size == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *heap = realloc(*heap, sizeof(struct wordStep) * *capacity);
+        if (*heap == NULL) { die("realloc"); }
+    }
+
+    int i = (*size)++;
+    while (i > 0 && stepBefore(&step, &(*heap)[(i - 1) / 2])) {
+        (*heap)[i] = (*heap)[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    (*heap)[i] = step;
+}
+
+
+static struct wordStep heapPop(struct wordStep *heap, int *size) {
+    struct wordStep top = heap[0];
+    struct wordStep last = heap[--(*size)];
+
+    int i = 0;
+    while (2 * i + 1 < *size) {
+        int k = 2 * i + 1;
+        if (k + 1 < *size && stepBefore(&heap[k + 1], &heap[k])) { k++; }
+        if (!stepBefore(&heap[k], &last)) { break; }
+        heap[i] = heap[k];
+        i = k;
+    }
+    heap[i] = last;
+    return top;
+}
+
+
+/* Spells out the word a node ends. */
+static void wordOf(int at, char *out) {
+    int len = 0;
+    for (int k = at; WORDS.node[k].parent >= 0; k = WORDS.node[k].parent) { len++; }
+
+    out[len] = '\0';
+    for (int k = at; WORDS.node[k].parent >= 0; k = WORDS.node[k].parent) {
+        out[--len] = WORDS.node[k].c;
+    }
+}
+
+
+/*
+* Fills out with up to max of the words in the buffer that start with
+* prefix, most frequent first, leaving out the prefix itself. Rows not yet
+* indexed are indexed first. Returns how many were found.
+*/
+int wordsComplete(const char *prefix, int len, char (*out)[WORDS_MAX_LEN + 1], int max) {
+    while (wordsPending()) { wordsIndexSlice(); }
+
+    int from = findNode(prefix, len, 0);
+    if (from < 0 || WORDS.node[from].best == 0) { return 0; }
+
+    static struct wordStep *heap = NULL;
+    static int capacity = 0;
+    int size = 0;
+    int found = 0;
+
+    heapPush(&heap, &size, &capacity, (struct wordStep) {WORDS.node[from].best, from, 0});
+    while (size > 0 && found < max) {
+        struct wordStep step = heapPop(heap, &size);
+        struct wordNode *n = &WORDS.node[step.node];
+
+        if (step.word) {
+            wordOf(step.node, out[found++]);
+            continue;
+        }
+
+        if (n->count > 0 && step.node != from) {
+            heapPush(&heap, &size, &capacity, (struct wordStep) {n->count, step.node, 1});
+        }
+        for (int k = n->child; k >= 0; k = WORDS.node[k].sibling) {
+            if (WORDS.node[k].best > 0) {
+                heapPush(&heap, &size, &capacity, (struct wordStep) {WORDS.node[k].best, k, 0});
+            }
+        }
+    }
+    return found;
+}
+
+
+/*
+* The completion last offered: the word typed on row y from start, what
+* replaced it up to end, and the candidates. Completing again straight
+* after, with nothing else changed, moves on to the next one and past
+* the last back to what was typed.
+*/
+static struct {
+    int y;
+    int start;
+    int typed;
+    int end;
+    int dirty;
+    int next;
+    int count;
+    char typedWord[WORDS_MAX_LEN + 1];
+    char found[WORDS_SHOWN][WORDS_MAX_LEN + 1];
+} COMPLETION;
+
+
+/*
+* Completes the word before the cursor with the most frequent word in the
+* buffer it starts, or the next candidate if called again. Returns how
+* many there are.
+*/
+int wordComplete() {
+    if (CONFIG.cursorY >= CONFIG.numRows) { return 0; }
+    editorRow *row = &CONFIG.row[CONFIG.cursorY];
+
+    int again = COMPLETION.count && COMPLETION.dirty == CONFIG.dirty
+        && COMPLETION.y == CONFIG.cursorY && COMPLETION.end == CONFIG.cursorX;
+
+    if (!again) {
+        int start = CONFIG.cursorX;
+        while (start > 0 && isWordChar((unsigned char) row->characters[start - 1])) { start--; }
+
+        int typed = CONFIG.cursorX - start;
+        if (typed == 0 || typed > WORDS_MAX_LEN) { return 0; }
+
+        COMPLETION.count = wordsComplete(&row->characters[start], typed, COMPLETION.found, WORDS_SHOWN);
+        if (COMPLETION.count == 0) { return 0; }
+
+        COMPLETION.y = CONFIG.cursorY;
+        COMPLETION.start = start;
+        COMPLETION.typed = typed;
+        memcpy(COMPLETION.typedWord, &row->characters[start], typed);
+        COMPLETION.typedWord[typed] = '\0';
+        COMPLETION.next = 0;
+    }
+
+    // replace whatever follows the typed prefix with the next candidate
+    int from = COMPLETION.start + COMPLETION.typed;
+    editorRowDelChars(row, from, CONFIG.cursorX - from);
+
+    int shown = COMPLETION.next;
+    const char *word = (shown < COMPLETION.count) ? COMPLETION.found[shown] : COMPLETION.typedWord;
+    int len = strlen(word) - COMPLETION.typed;
+    if (len > 0) { editorRowInsertChars(row, from, &word[COMPLETION.typed], len); }
+
+    CONFIG.cursorX = from + len;
+    COMPLETION.end = CONFIG.cursorX;
+    COMPLETION.dirty = CONFIG.dirty;
+    COMPLETION.next = (shown + 1) % (COMPLETION.count + 1);
+
+    if (shown < COMPLETION.count) {
+        setStatusMessage("%s (%d of %d) | Ctrl-O = next", word, shown + 1, COMPLETION.count);
+    }
+    else { setStatusMessage("No more completions of %s", word); }
+    return COMPLETION.count;
+}
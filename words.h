@@ -0,0 +1,21 @@
+/* Word completion headers. */
+
+#ifndef WORDS_H
+#define WORDS_H
+
+#include "core.h"
+
+#define WORDS_MAX_LEN 64  // longer words are left out of the index
+
+void wordsForget(editorRow *, int, int);
+void wordsLearn(editorRow *, int, int);
+void wordsRowsInserted(int, int);
+void wordsRowsRemoved(int, int);
+
+int wordsPending();
+void wordsIndexSlice();
+
+int wordsComplete(const char *, int, char (*)[WORDS_MAX_LEN + 1], int);
+int wordComplete();
+
+#endif
@@ -0,0 +1,247 @@
+/* Soft wrap: long rows laid out over several screen lines. */
+
+#include <stdlib.h>
+
+#include "core.h"
+#include "utf8.h"
+#include "wrap.h"
+#include "ops/rowops.h"
+
+
+/*
+* While wrapping is on, every row keeps where it breaks into screen lines
+* no wider than width, breaking after a space where there is one. A
+* Fenwick tree over the number of screen lines each row takes maps between
+* screen lines and rows in O(log n). An edit within a row updates it in
+* place; inserting or removing rows shifts every row after them, just as
+* it moves them in the row array, so the tree is then rebuilt, in linear
+* time, the next time it is needed. So does folding, as a hidden row takes
+* no lines at all, and mapping a line to a row skips it.
+*/
+static struct {
+    int width;
+
+    int *tree;  // 1-based
+    int size;
+    int capacity;
+    int valid;
+} WRAP = {0, NULL, 0, 0, 0};
+
+
+static void addWrap(editorRow *row, int *capacity, int at) {
+    if (row->numWraps == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 4;
+        row->wraps = realloc(row->wraps, sizeof(int) * *capacity);
+        if (row->wraps == NULL) { die("realloc"); }
+    }
+    row->wraps[row->numWraps++] = at;
+}
+
+
+/*
+* Walks the row a character at a time, the column stops giving the ones
+* that are not one byte in one column, and starts a new line where the
+* next character would not fit.
+*/
+static void layoutRow(editorRow *row) {
+    free(row->wraps);
+    row->wraps = NULL;
+    row->numWraps = 0;
+    if (!CONFIG.softWrap) { return; }
+
+    int capacity = 0;
+    int lineRx = 0;
+    int lineCol = 0;
+    int spaceRx = 0;  // just past the last space, where a line breaks best
+    int spaceCol = 0;
+
+    int k = 0;
+    int rx = 0;
+    int col = 0;
+    while (rx < row->renderSize) {
+        int bytes = 1;
+        int width = 1;
+        int space = 0;
+        if (k < row->numStops && row->stops[k].rx == rx) {
+            bytes = row->stops[k].renderBytes;
+            width = row->stops[k].width;
+            k++;
+        }
+        else { space = (row->render[rx] == ' '); }
+
+        while (col + width - lineCol > WRAP.width && col > lineCol) {
+            if (spaceRx > lineRx) {
+                lineRx = spaceRx;
+                lineCol = spaceCol;
+            }
+            else {
+                lineRx = rx;
+                lineCol = col;
+            }
+            addWrap(row, &capacity, lineRx);
+        }
+
+        rx += bytes;
+        col += width;
+        if (space) {
+            spaceRx = rx;
+            spaceCol = col;
+        }
+    }
+}
+
+
+static void rebuild() {
+    int n = CONFIG.numRows;
+    if (n + 1 > WRAP.capacity) {
+        WRAP.capacity = n + 1;
+        WRAP.tree = realloc(WRAP.tree, sizeof(int) * WRAP.capacity);
+        if (WRAP.tree == NULL) { die("realloc"); }
+    }
+    WRAP.size = n;
+
+    // a row hidden in a fold, which has no render, takes no lines
+    for (int i = 1; i <= n; i++) {
+        editorRow *row = &CONFIG.row[i - 1];
+        WRAP.tree[i] = row->render ? row->numWraps + 1 : 0;
+    }
+    for (int i = 1; i <= n; i++) {
+        int parent = i + (i & -i);
+        if (parent <= n) { WRAP.tree[parent] += WRAP.tree[i]; }
+    }
+    WRAP.valid = 1;
+}
+
+
+void wrapToggle() {
+    CONFIG.softWrap = !CONFIG.softWrap;
+    WRAP.width = CONFIG.screenCols;
+
+    for (int j = 0; j < CONFIG.numRows; j++) { layoutRow(&CONFIG.row[j]); }
+    WRAP.valid = 0;
+
+    if (CONFIG.softWrap) {
+        CONFIG.colOffset = 0;
+        CONFIG.wrapOffset = wrapLinesBefore(CONFIG.rowOffset);
+    }
+}
+
+
+/* Lays a row out again after it was re-rendered. */
+void wrapUpdateRow(editorRow *row) {
+    if (!CONFIG.softWrap) { return; }
+
+    int before = row->numWraps;
+    layoutRow(row);
+    if (!WRAP.valid || row->index >= WRAP.size) {
+        WRAP.valid = 0;
+        return;
+    }
+
+    int delta = row->numWraps - before;
+    if (delta == 0) { return; }
+    for (int i = row->index + 1; i <= WRAP.size; i += i & -i) { WRAP.tree[i] += delta; }
+}
+
+
+void wrapRowsMoved() {
+    WRAP.valid = 0;
+}
+
+
+/* Screen lines taken by the rows above row at. */
+int wrapLinesBefore(int at) {
+    if (!WRAP.valid) { rebuild(); }
+    if (at > WRAP.size) { at = WRAP.size; }
+
+    int lines = 0;
+    for (int i = at; i > 0; i -= i & -i) { lines += WRAP.tree[i]; }
+    return lines;
+}
+
+
+/*
+* The row screen line falls in, with which of its own lines that is in
+* sub. Lines past the last row give numRows.
+*/
+int wrapRowAt(int line, int *sub) {
+    if (!WRAP.valid) { rebuild(); }
+
+    int step = 1;
+    while (step * 2 <= WRAP.size) { step *= 2; }
+
+    int at = 0;
+    for (; step > 0 && WRAP.size > 0; step /= 2) {
+        if (at + step <= WRAP.size && WRAP.tree[at + step] <= line) {
+            at += step;
+            line -= WRAP.tree[at];
+        }
+    }
+    *sub = line;
+    return at;
+}
+
+
+/* Which of a row's screen lines render column rx is on. */
+int wrapLineOf(editorRow *row, int rx) {
+    int lo = 0;
+    int hi = row->numWraps;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (row->wraps[mid] <= rx) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    return lo;
+}
+
+
+int wrapLineStart(editorRow *row, int line) {
+    return line ? row->wraps[line - 1] : 0;
+}
+
+
+int wrapLineEnd(editorRow *row, int line) {
+    return line < row->numWraps ? row->wraps[line] : row->renderSize;
+}
+
+
+/* The screen line the cursor is on, and its column on that line in x. */
+int wrapCursorLine(int *x) {
+    int line = wrapLinesBefore(CONFIG.cursorY);
+    *x = 0;
+    if (CONFIG.cursorY >= CONFIG.numRows) { return line; }
+
+    editorRow *row = &CONFIG.row[CONFIG.cursorY];
+    int rx = editorRowCxToRx(row, CONFIG.cursorX);
+    int sub = wrapLineOf(row, rx);
+
+    *x = editorRowRxToCol(row, rx) - editorRowRxToCol(row, wrapLineStart(row, sub));
+    return line + sub;
+}
+
+
+/* Moves the cursor up or down by screen lines, keeping its column. */
+void wrapMoveLines(int lines) {
+    int x;
+    int line = wrapCursorLine(&x) + lines;
+    if (line < 0) { line = 0; }
+
+    int sub;
+    CONFIG.cursorY = wrapRowAt(line, &sub);
+    if (CONFIG.cursorY >= CONFIG.numRows) {
+        CONFIG.cursorY = CONFIG.numRows;
+        CONFIG.cursorX = 0;
+        return;
+    }
+
+    editorRow *row = &CONFIG.row[CONFIG.cursorY];
+    int col = editorRowRxToCol(row, wrapLineStart(row, sub)) + x;
+    int cx = editorRowRxToCx(row, editorRowColToRx(row, col));
+
+    // the character a line breaks at belongs to the line below
+    if (sub < row->numWraps) {
+        int end = editorRowRxToCx(row, wrapLineEnd(row, sub));
+        if (cx >= end) { cx = utf8Prev(row->characters, end); }
+    }
+    CONFIG.cursorX = cx;
+}
@@ -0,0 +1,20 @@
+/* Soft wrap headers. */
+
+#ifndef WRAP_H
+#define WRAP_H
+
+#include "core.h"
+
+void wrapToggle();
+void wrapUpdateRow(editorRow *);
+void wrapRowsMoved();
+
+int wrapLinesBefore(int);
+int wrapRowAt(int, int *);
+int wrapLineOf(editorRow *, int);
+int wrapLineStart(editorRow *, int);
+int wrapLineEnd(editorRow *, int);
+int wrapCursorLine(int *);
+void wrapMoveLines(int);
+
+#endif